@@ -44,6 +44,8 @@ plan_exec.c
 
 plan_line.c
 
+plan_math.c
+
 plan_zoid.c
 
 pwm.c
@@ -84,6 +84,9 @@
  *		Take careful note that the callback executes under an interrupt, so beware of
  *		variables that may need to be volatile.
  *
+ *	  - Spindle speed and coolant use mp_queue_sync_command() instead, which rides the
+ *		command on the next line block so motion doesn't stop for it (see planner.c).
+ *
  *	Note:
  *	  - The synchronous command execution mechanism uses 2 vectors in the bf buffer to store
  *		and return values for the callback. It's obvious, but impractical to pass the entire
@@ -117,7 +120,7 @@ extern "C"{
  **** STRUCTURE ALLOCATIONS ********************************************************
  ***********************************************************************************/
 
-cmSingleton_t cm;		// 一个核心结构体。保存了当前运行的状态，包括坐标平面的选择。每个坐标轴的设置，
+THREAD_LOCAL cmSingleton_t cm;		// 一个核心结构体。保存了当前运行的状态，包括坐标平面的选择。每个坐标轴的设置，
 //系统设置（拐角速度，软限位开关）。还有当前G代码解析状态。
 //canonical machine controller 单例模式
 
@@ -128,7 +131,6 @@ cmSingleton_t cm;		// 一个核心结构体。保存了当前运行的状态，
 // 从planner队列中执行回调。
 static void _exec_offset(float *value, float *flag);
 static void _exec_change_tool(float *value, float *flag);
-static void _exec_select_tool(float *value, float *flag);
 static void _exec_mist_coolant_control(float *value, float *flag);
 static void _exec_flood_coolant_control(float *value, float *flag);
 static void _exec_absolute_origin(float *value, float *flag);
@@ -193,7 +195,6 @@ void cm_set_motion_state(uint8_t motion_state)
 
 /*	These getters and setters will work on any gm model with inputs:
  *		MODEL 		(GCodeState_t *)&cm.gm		// absolute pointer from canonical machine gm model
- *		PLANNER		(GCodeState_t *)&bf->gm		// relative to buffer *bf is currently pointing to
  *		RUNTIME		(GCodeState_t *)&mr.gm		// absolute pointer from runtime mm struct
  *		ACTIVE_MODEL cm.am						// active model pointer is maintained by state management
  */
@@ -275,7 +276,6 @@ float cm_get_active_coord_offset(uint8_t axis)
  *
  *	This function accepts as input:
  *		MODEL 		(GCodeState_t *)&cm.gm		// absolute pointer from canonical machine gm model
- *		PLANNER		(GCodeState_t *)&bf->gm		// relative to buffer *bf is currently pointing to
  *		RUNTIME		(GCodeState_t *)&mr.gm		// absolute pointer from runtime mm struct
  *		ACTIVE_MODEL cm.am						// active model pointer is maintained by state management
  */
@@ -290,7 +290,6 @@ float cm_get_work_offset(GCodeState_t *gcode_state, uint8_t axis)
  *
  *	This function accepts as input:
  *		MODEL 		(GCodeState_t *)&cm.gm		// absolute pointer from canonical machine gm model
- *		PLANNER		(GCodeState_t *)&bf->gm		// relative to buffer *bf is currently pointing to
  *		RUNTIME		(GCodeState_t *)&mr.gm		// absolute pointer from runtime mm struct
  *		ACTIVE_MODEL cm.am						// active model pointer is maintained by state management
  */
@@ -526,6 +525,11 @@ void canonical_machine_init()
 	cm_set_coord_system(cm.coord_system);
 	cm_select_plane(cm.select_plane);
 	cm_set_path_control(cm.path_control);
+	cm_set_path_tolerance(0);					// no line merging until a G64 P
+	cm.gmx.feed_rate_override_factor = 1;		// overrides enabled at 100% (M48)
+	cm.gmx.traverse_override_factor = 1;
+	cm.gmx.spindle_override_factor = 1;
+	cm_override_enables(true);
 	cm_set_distance_mode(cm.distance_mode);
 	cm_set_feed_rate_mode(UNITS_PER_MINUTE_MODE);// always the default
 
@@ -924,6 +928,19 @@ stat_t cm_set_path_control(uint8_t mode)
 	return (STAT_OK);
 }
 
+/*
+ * cm_set_path_tolerance() - G64 P (affects MODEL only)
+ *
+ *	Tolerance for merging nearly collinear G1 lines in the planner. Modal: a G64 without
+ *	a P keeps the last value, G61 and G61.1 suspend merging, and G64 P0 turns it off.
+ */
+
+stat_t cm_set_path_tolerance(float tolerance)
+{
+	cm.gmx.path_tolerance = max(_to_millimeters(tolerance), 0);
+	return (STAT_OK);
+}
+
 /*******************************
  * Machining Functions (4.3.6) *
  *******************************/
@@ -975,27 +992,21 @@ stat_t cm_straight_feed(float target[], float flags[])
  **************************/
 /*
  * cm_select_tool()		- T 参数
- * _exec_select_tool()	- 执行回调
  *
  * cm_change_tool()		- M6 (This might become a complete tool change cycle)
  * _exec_change_tool()	- 执行回调 
  *
- * 注意： 这些函数还未实际能做什么东西，并且还有bug————在T和M在不同的block时，不能正确工作
- * Note: These functions don't actually do anything for now, and there's a bug
- *		 where T and M in different blocks don;t work correctly
+ * 注意： 这些函数还未实际能做什么东西
+ * Note: These functions don't actually do anything for now. T sets the selection in the
+ *		 model right away, so an M6 in the same or a later block queues the tool selected.
+ *		 cm.gm.tool changes when the M6 runs.
  */
 stat_t cm_select_tool(uint8_t tool_select)
 {
-	float value[AXES] = { (float)tool_select,0,0,0,0,0 };
-	mp_queue_command(_exec_select_tool, value, value);
+	cm.gm.tool_select = tool_select;
 	return (STAT_OK);
 }
 
-static void _exec_select_tool(float *value, float *flag)
-{
-	cm.gm.tool_select = (uint8_t)value[0];
-}
-
 stat_t cm_change_tool(uint8_t tool_change)
 {
 	float value[AXES] = { (float)cm.gm.tool_select,0,0,0,0,0 };
@@ -1018,13 +1029,13 @@ static void _exec_change_tool(float *value, float *flag)
 
 stat_t cm_mist_coolant_control(uint8_t mist_coolant)
 {
-	float value[AXES] = { (float)mist_coolant,0,0,0,0,0 };
-	mp_queue_command(_exec_mist_coolant_control, value, value);
+	mp_queue_sync_command(_exec_mist_coolant_control, (float)mist_coolant);
 	return (STAT_OK);
 }
 static void _exec_mist_coolant_control(float *value, float *flag)
 {
 	cm.gm.mist_coolant = (uint8_t)value[0];
+	if (st_sim.enable == true) return;		// dry run: model only, coolant stays off
 
 #ifdef __AVR
 	if (cm.gm.mist_coolant == true)
@@ -1041,13 +1052,13 @@ static void _exec_mist_coolant_control(float *value, float *flag)
 
 stat_t cm_flood_coolant_control(uint8_t flood_coolant)
 {
-	float value[AXES] = { (float)flood_coolant,0,0,0,0,0 };
-	mp_queue_command(_exec_flood_coolant_control, value, value);
+	mp_queue_sync_command(_exec_flood_coolant_control, (float)flood_coolant);
 	return (STAT_OK);
 }
 static void _exec_flood_coolant_control(float *value, float *flag)
 {
 	cm.gm.flood_coolant = (uint8_t)value[0];
+	if (st_sim.enable == true) return;		// dry run
 
 #ifdef __AVR
 	if (cm.gm.flood_coolant == true) {
@@ -1081,13 +1092,29 @@ static void _exec_flood_coolant_control(float *value, float *flag)
  *
  *	修调使能（Override enables）在G代码中有一些混乱。这里尝试将它们归类。 
  *	查看 http://www.linuxcnc.org/docs/2.4/html/gcode_main.html#sec:M50:-Feed-Override
+ *
+ *	Feed and traverse overrides take effect on queued and running motion right away
+ *	(see mp_feed_rate_override()). The factors are clamped to FEED_OVERRIDE_MIN..MAX.
  */
 
+static void _apply_feed_overrides()
+{
+	mp_feed_rate_override(
+		(cm.gmx.feed_rate_override_enable == true) ? cm.gmx.feed_rate_override_factor : 1,
+		(cm.gmx.traverse_override_enable == true) ? cm.gmx.traverse_override_factor : 1);
+}
+
+static float _clamp_override(float factor)
+{
+	return (min(max(factor, FEED_OVERRIDE_MIN), FEED_OVERRIDE_MAX));
+}
+
 stat_t cm_override_enables(uint8_t flag)			// M48, M49
 {
 	cm.gmx.feed_rate_override_enable = flag;
 	cm.gmx.traverse_override_enable = flag;
 	cm.gmx.spindle_override_enable = flag;
+	_apply_feed_overrides();
 	return (STAT_OK);
 }
 
@@ -1098,14 +1125,15 @@ stat_t cm_feed_rate_override_enable(uint8_t flag)	// M50
 	} else {
 		cm.gmx.feed_rate_override_enable = true;
 	}
+	_apply_feed_overrides();
 	return (STAT_OK);
 }
 
 stat_t cm_feed_rate_override_factor(uint8_t flag)	// M50.1
 {
 	cm.gmx.feed_rate_override_enable = flag;
-	cm.gmx.feed_rate_override_factor = cm.gn.parameter;
-//	mp_feed_rate_override(flag, cm.gn.parameter);	// replan the queue for new feed rate
+	cm.gmx.feed_rate_override_factor = _clamp_override(cm.gn.parameter);
+	_apply_feed_overrides();						// replan the queue for new feed rate
 	return (STAT_OK);
 }
 
@@ -1116,14 +1144,15 @@ stat_t cm_traverse_override_enable(uint8_t flag)	// M50.2
 	} else {
 		cm.gmx.traverse_override_enable = true;
 	}
+	_apply_feed_overrides();
 	return (STAT_OK);
 }
 
 stat_t cm_traverse_override_factor(uint8_t flag)	// M51
 {
 	cm.gmx.traverse_override_enable = flag;
-	cm.gmx.traverse_override_factor = cm.gn.parameter;
-//	mp_feed_rate_override(flag, cm.gn.parameter);	// replan the queue for new feed rate
+	cm.gmx.traverse_override_factor = _clamp_override(cm.gn.parameter);
+	_apply_feed_overrides();						// replan the queue for new traverse rate
 	return (STAT_OK);
 }
 
@@ -1210,7 +1239,11 @@ void cm_message(char_t *message)
  *		should start to run anything in the planner queue
  */
 
-void cm_request_feedhold(void) { cm.feedhold_requested = true; }
+void cm_request_feedhold(void)
+{
+	if (cm.feedhold_requested == false) { mp_start_hold_timer();}	// latency runs from the first '!'
+	cm.feedhold_requested = true;
+}
 void cm_request_queue_flush(void) { cm.queue_flush_requested = true; }
 void cm_request_cycle_start(void) { cm.cycle_start_requested = true; }
 
@@ -1326,6 +1359,9 @@ static void _exec_program_finalize(float *value, float *flag)
 		cm_set_feed_rate_mode(UNITS_PER_MINUTE_MODE);	// G94
 	//	cm_set_motion_mode(MOTION_MODE_STRAIGHT_FEED);	// NIST specifies G1, but we cancel motion mode. Safer.
 		cm_set_motion_mode(MODEL, MOTION_MODE_CANCEL_MOTION_MODE);
+		if (st_sim.enable == true) {
+			st_sim.report_requested = true;				// dry run finished - send the sim report
+		}
 	}
 	sr_request_status_report(SR_IMMEDIATE_REQUEST);		// request a final status report (not unfiltered)
 }
@@ -1665,6 +1701,7 @@ stat_t cm_get_ofs(nvObj_t *nv)
  *
  * cm_get_am()	- get axis mode w/enumeration string
  * cm_set_am()	- set axis mode w/exception handling for axis type
+ *				  (axes past MOTION_AXES are not built in and only take AXIS_DISABLED)
  * cm_set_sw()	- run this any time you change a switch setting
  */
 
@@ -1681,6 +1718,9 @@ stat_t cm_set_am(nvObj_t *nv)		// axis mode
 	} else {
 		if (nv->value > AXIS_MODE_MAX_ROTARY) { return (STAT_INPUT_EXCEEDS_MAX_VALUE);}
 	}
+	if ((_get_axis(nv->index) >= MOTION_AXES) && (nv->value != AXIS_DISABLED)) {
+		return (STAT_INPUT_VALUE_RANGE_ERROR);
+	}
 	set_ui8(nv);
 	return(STAT_OK);
 }
@@ -1726,6 +1766,58 @@ stat_t cm_set_xjh(nvObj_t *nv)
 	return(STAT_OK);
 }
 
+/*
+ * cm_set_axis_accel() - set the acceleration limit for an axis, including the reciprocal
+ * cm_set_xac()		   - set acceleration max
+ *
+ *	Acceleration is stored in mm/min^2 divided by 1000, so 1800 is 500 mm/s^2.
+ *	0 turns the limit off for the axis - its moves are then limited by jerk alone.
+ *	The planner caps the S-curves of every move the axis takes part in so that the
+ *	axis never exceeds this value (see mp_get_target_length()).
+ *
+ *	The computed jerk exec (__JERK_EXEC) has no 7-segment head and tail, so those
+ *	builds reject any limit but 0.
+ */
+void cm_set_axis_accel(uint8_t axis, float accel)
+{
+	cm.a[axis].accel_max = accel;
+	cm.a[axis].recip_accel = (accel > 0) ? 1/(accel * ACCEL_MULTIPLIER) : 0;
+}
+
+stat_t cm_set_xac(nvObj_t *nv)
+{
+	if (nv->value < 0) { return (STAT_INPUT_LESS_THAN_MIN_VALUE);}
+#ifdef __JERK_EXEC
+	if (nv->value > 0) { return (STAT_INPUT_VALUE_RANGE_ERROR);}
+#endif
+	set_flu(nv);
+	cm_set_axis_accel(_get_axis(nv->index), nv->value);
+	return(STAT_OK);
+}
+
+/*
+ * cm_set_mfo() - set feed rate override factor
+ * cm_set_mto() - set traverse override factor
+ *
+ *	These are the operator's live override controls. They apply to motion already in
+ *	the planner queue, if the override is enabled (M48 or M50).
+ */
+stat_t cm_set_mfo(nvObj_t *nv)
+{
+	nv->value = _clamp_override(nv->value);
+	cm.gmx.feed_rate_override_factor = nv->value;
+	_apply_feed_overrides();
+	return(STAT_OK);
+}
+
+stat_t cm_set_mto(nvObj_t *nv)
+{
+	nv->value = _clamp_override(nv->value);
+	cm.gmx.traverse_override_factor = nv->value;
+	_apply_feed_overrides();
+	return(STAT_OK);
+}
+
 /*
  * 命令 
  *
@@ -1823,6 +1915,8 @@ stat_t cm_run_joga(nvObj_t *nv)
 
 const char fmt_vel[]  PROGMEM = "Velocity:%17.3f%s/min\n";
 const char fmt_feed[] PROGMEM = "Feed rate:%16.3f%s/min\n";
+const char fmt_mfo[]  PROGMEM = "Feed override:%12.3f\n";
+const char fmt_mto[]  PROGMEM = "Traverse override:%8.3f\n";
 const char fmt_line[] PROGMEM = "Line number:%10.0f\n";
 const char fmt_stat[] PROGMEM = "Machine state:       %s\n"; // combined machine state
 const char fmt_macs[] PROGMEM = "Raw machine state:   %s\n"; // raw machine state
@@ -1852,6 +1946,8 @@ const char fmt_gdi[] PROGMEM = "[gdi] default gcode distance mode%2d [0=G90,1=G9
 
 void cm_print_vel(nvObj_t *nv) { text_print_flt_units(nv, fmt_vel, GET_UNITS(ACTIVE_MODEL));}
 void cm_print_feed(nvObj_t *nv) { text_print_flt_units(nv, fmt_feed, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_mfo(nvObj_t *nv) { text_print_flt(nv, fmt_mfo);}
+void cm_print_mto(nvObj_t *nv) { text_print_flt(nv, fmt_mto);}
 void cm_print_line(nvObj_t *nv) { text_print_int(nv, fmt_line);}
 void cm_print_stat(nvObj_t *nv) { text_print_str(nv, fmt_stat);}
 void cm_print_macs(nvObj_t *nv) { text_print_str(nv, fmt_macs);}
@@ -1904,6 +2000,7 @@ void cm_print_ms(nvObj_t *nv) { text_print_flt_units(nv, fmt_ms, GET_UNITS(ACTIV
  *	cm_print_tn()
  *	cm_print_jm()
  *	cm_print_jh()
+ *	cm_print_ac()
  *	cm_print_jd()
  *	cm_print_ra()
  *	cm_print_sn()
@@ -1923,6 +2020,7 @@ static const char fmt_Xtm[] PROGMEM = "[%s%s] %s travel maximum%17.3f%s\n";
 static const char fmt_Xtn[] PROGMEM = "[%s%s] %s travel minimum%17.3f%s\n";
 static const char fmt_Xjm[] PROGMEM = "[%s%s] %s jerk maximum%15.0f%s/min^3 * 1 million\n";
 static const char fmt_Xjh[] PROGMEM = "[%s%s] %s jerk homing%16.0f%s/min^3 * 1 million\n";
+static const char fmt_Xac[] PROGMEM = "[%s%s] %s acceleration maximum%7.0f%s/min^2 * 1 thousand\n";
 static const char fmt_Xjd[] PROGMEM = "[%s%s] %s junction deviation%14.4f%s (larger is faster)\n";
 static const char fmt_Xra[] PROGMEM = "[%s%s] %s radius value%20.4f%s\n";
 static const char fmt_Xsn[] PROGMEM = "[%s%s] %s switch min%17d [0=off,1=homing,2=limit,3=limit+homing]\n";
@@ -1981,6 +2079,7 @@ void cm_print_tm(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xtm);}
 void cm_print_tn(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xtn);}
 void cm_print_jm(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xjm);}
 void cm_print_jh(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xjh);}
+void cm_print_ac(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xac);}
 void cm_print_jd(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xjd);}
 void cm_print_ra(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xra);}
 void cm_print_sn(nvObj_t *nv) { _print_axis_ui8(nv, fmt_Xsn);}
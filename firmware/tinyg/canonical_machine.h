@@ -40,13 +40,14 @@ extern "C"{
 /* 定义，宏，和各种参数*/
 
 #define MODEL 	(GCodeState_t *)&cm.gm		// absolute pointer from canonical machine gm model
-#define PLANNER (GCodeState_t *)&bf->gm		// relative to buffer *bf is currently pointing to
 #define RUNTIME (GCodeState_t *)&mr.gm		// absolute pointer from runtime mm struct
 #define ACTIVE_MODEL cm.am					// active model pointer is maintained by state management
 
 #define _to_millimeters(a) ((cm.gm.units_mode == INCHES) ? (a * MM_PER_INCH) : a)
 
 #define JOGGING_START_VELOCITY ((float)10.0)
+#define FEED_OVERRIDE_MIN ((float)0.05)		// range of the feed and traverse override factors
+#define FEED_OVERRIDE_MAX ((float)2.0)
 #define DISABLE_SOFT_LIMIT (-1000000)
 
 /*****************************************************************************
@@ -95,6 +96,7 @@ typedef struct GCodeState {				// Gcode model state - used by model, planning an
 	float move_time;					// optimal time for move given axis constraints
 	float minimum_time;					// minimum time possible for move given axis constraints
 	float feed_rate; 					// F - normalized to millimeters/minute or in inverse time mode
+	float arc_radius;					// radius of the arc for the chords cm_arc_callback() plans (0 otherwise)
 
 	float spindle_speed;				// in RPM
 	float parameter;					// P - parameter used for dwell time in seconds, G10 coord select...
@@ -130,6 +132,7 @@ typedef struct GCodeStateExtended {		// Gcode dynamic state extensions - used by
 	uint8_t	feed_rate_override_enable;	// TRUE = overrides enabled (M48), F=(M49)
 	uint8_t	traverse_override_enable;	// TRUE = traverse override enabled
 	uint8_t l_word;						// L word - used by G10s
+	float path_tolerance;				// G64 P - line merging tolerance in mm (0 = off)
 
 	uint8_t origin_offset_enable;		// G92 offsets enabled/disabled.  0=disabled, 1=enabled
 	uint8_t block_delete_switch;		// set true to enable block deletes (true is default)
@@ -207,6 +210,8 @@ typedef struct cmAxis {
 	float jerk_max;						// 最大加加速度(Jm)，单位为mm/min^3 除以1000000
 	float jerk_homing;					// 归位过程最大加加速度(Jm)，单位为mm/min^3 除以1000000
 	float recip_jerk;					// stored reciprocal of current jerk value - has the million in it
+	float accel_max;					// 最大加速度，单位为mm/min^2 除以1000 (0 = 只由加加速度限制)
+	float recip_accel;					// stored reciprocal of accel_max - has the thousand in it (0 = not limited)
 	float junction_dev;					// 也就是转角delta
 	float radius;						// radius in mm for rotary axis modes
 	float search_velocity;				// homing search velocity
@@ -276,7 +281,7 @@ typedef struct cmSingleton {			// struct to manage cm globals and cycles
 
 /**** Externs - See canonical_machine.c for allocation ****/
 
-extern cmSingleton_t cm;				// canonical machine controller singleton
+extern THREAD_LOCAL cmSingleton_t cm;				// canonical machine controller singleton
 
 /*****************************************************************************
  * 机器状态模型 
@@ -530,6 +535,7 @@ uint8_t cm_get_jogging_state(void);
 void cm_set_motion_state(uint8_t motion_state);
 float cm_get_axis_jerk(uint8_t axis);
 void cm_set_axis_jerk(uint8_t axis, float jerk);
+void cm_set_axis_accel(uint8_t axis, float accel);
 
 uint32_t cm_get_linenum(GCodeState_t *gcode_state);
 uint8_t cm_get_motion_mode(GCodeState_t *gcode_state);
@@ -604,6 +610,7 @@ stat_t cm_goto_g30_position(float target[], float flags[]);		// G30
 stat_t cm_set_feed_rate(float feed_rate);						// F parameter
 stat_t cm_set_feed_rate_mode(uint8_t mode);						// G93, G94, (G95 unimplemented)
 stat_t cm_set_path_control(uint8_t mode);						// G61, G61.1, G64
+stat_t cm_set_path_tolerance(float tolerance);					// G64 P
 
 // 机器功能 (4.3.6)
 stat_t cm_straight_feed(float target[], float flags[]);		    // G1
@@ -706,6 +713,9 @@ stat_t cm_get_am(nvObj_t *nv);			// get axis mode
 stat_t cm_set_am(nvObj_t *nv);			// set axis mode
 stat_t cm_set_xjm(nvObj_t *nv);			// set jerk max with 1,000,000 correction
 stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
+stat_t cm_set_xac(nvObj_t *nv);			// set acceleration max (in thousands)
+stat_t cm_set_mfo(nvObj_t *nv);			// set feed rate override factor - applies to queued moves
+stat_t cm_set_mto(nvObj_t *nv);			// set traverse override factor - applies to queued moves
 
 /*--- text_mode support functions ---*/
 
@@ -713,6 +723,8 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 
 	void cm_print_vel(nvObj_t *nv);		// model state reporting
 	void cm_print_feed(nvObj_t *nv);
+	void cm_print_mfo(nvObj_t *nv);
+	void cm_print_mto(nvObj_t *nv);
 	void cm_print_line(nvObj_t *nv);
 	void cm_print_stat(nvObj_t *nv);
 	void cm_print_macs(nvObj_t *nv);
@@ -755,6 +767,7 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 	void cm_print_tn(nvObj_t *nv);
 	void cm_print_jm(nvObj_t *nv);
 	void cm_print_jh(nvObj_t *nv);
+	void cm_print_ac(nvObj_t *nv);
 	void cm_print_jd(nvObj_t *nv);
 	void cm_print_ra(nvObj_t *nv);
 	void cm_print_sn(nvObj_t *nv);
@@ -770,6 +783,8 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 
 	#define cm_print_vel tx_print_stub		// model state reporting
 	#define cm_print_feed tx_print_stub
+	#define cm_print_mfo tx_print_stub
+	#define cm_print_mto tx_print_stub
 	#define cm_print_line tx_print_stub
 	#define cm_print_stat tx_print_stub
 	#define cm_print_macs tx_print_stub
@@ -812,6 +827,7 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 	#define cm_print_tn tx_print_stub
 	#define cm_print_jm tx_print_stub
 	#define cm_print_jh tx_print_stub
+	#define cm_print_ac tx_print_stub
 	#define cm_print_jd tx_print_stub
 	#define cm_print_ra tx_print_stub
 	#define cm_print_sn tx_print_stub
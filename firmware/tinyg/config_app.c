@@ -53,6 +53,14 @@ extern "C"{
 
 cfgParameters_t cfg; 				// application specific configuration parameters
 
+// st_set_ma() refuses a motor map past MOTION_AXES, so a profile default there would leave
+// the motor mapped to X after a reset. Axis modes past MOTION_AXES fall back to disabled.
+#if (M1_MOTOR_MAP >= MOTION_AXES) || (M2_MOTOR_MAP >= MOTION_AXES) || \
+	((MOTORS >= 3) && (M3_MOTOR_MAP >= MOTION_AXES)) || ((MOTORS >= 4) && (M4_MOTOR_MAP >= MOTION_AXES)) || \
+	((MOTORS >= 5) && (M5_MOTOR_MAP >= MOTION_AXES)) || ((MOTORS >= 6) && (M6_MOTOR_MAP >= MOTION_AXES))
+#error The machine profile maps a motor to an axis past MOTION_AXES
+#endif
+
 /***********************************************************************************
  **** application-specific internal functions **************************************
  ***********************************************************************************/
@@ -113,6 +121,8 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "",   "line",_fi, 0, cm_print_line, cm_get_line, set_int,(float *)&cm.gm.linenum,0 },		// Active line number - model or runtime line number
 	{ "",   "vel", _f0, 2, cm_print_vel,  cm_get_vel,  set_nul,(float *)&cs.null, 0 },			// current velocity
 	{ "",   "feed",_f0, 2, cm_print_feed, cm_get_feed, set_nul,(float *)&cs.null, 0 },			// feed rate
+	{ "",   "mfo", _f0, 3, cm_print_mfo,  get_flt,     cm_set_mfo,(float *)&cm.gmx.feed_rate_override_factor, 1 },	// feed rate override
+	{ "",   "mto", _f0, 3, cm_print_mto,  get_flt,     cm_set_mto,(float *)&cm.gmx.traverse_override_factor, 1 },	// traverse override
 	{ "",   "stat",_f0, 0, cm_print_stat, cm_get_stat, set_nul,(float *)&cs.null, 0 },			// combined machine state
 	{ "",   "macs",_f0, 0, cm_print_macs, cm_get_macs, set_nul,(float *)&cs.null, 0 },			// raw machine state
 	{ "",   "cycs",_f0, 0, cm_print_cycs, cm_get_cycs, set_nul,(float *)&cs.null, 0 },			// cycle state
@@ -188,11 +198,64 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "", "qr",  _f0, 0, qr_print_qr,  qr_get,  set_nul,  (float *)&cs.null, 0 },	// queue report - planner buffers available
 	{ "", "qi",  _f0, 0, qr_print_qi,  qi_get,  set_nul,  (float *)&cs.null, 0 },	// queue report - buffers added to queue
 	{ "", "qo",  _f0, 0, qr_print_qo,  qo_get,  set_nul,  (float *)&cs.null, 0 },	// queue report - buffers removed from queue
+
+	{ "pl","plf",  _f0, 0, tx_print_int, get_int,   set_nul,(float *)&mps.zoid[ZOID_F], 0 },		// planner report - trapezoid cases
+	{ "pl","plb2", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&mps.zoid[ZOID_B2], 0 },
+	{ "pl","plb",  _f0, 0, tx_print_int, get_int,   set_nul,(float *)&mps.zoid[ZOID_B], 0 },
+	{ "pl","plt2", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&mps.zoid[ZOID_T2], 0 },
+	{ "pl","plt",  _f0, 0, tx_print_int, get_int,   set_nul,(float *)&mps.zoid[ZOID_T], 0 },
+	{ "pl","plh2", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&mps.zoid[ZOID_H2], 0 },
+	{ "pl","plh",  _f0, 0, tx_print_int, get_int,   set_nul,(float *)&mps.zoid[ZOID_H], 0 },
+	{ "pl","plht", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&mps.zoid[ZOID_HT], 0 },
+	{ "pl","plhta",_f0, 0, tx_print_int, get_int,   set_nul,(float *)&mps.zoid[ZOID_HT_ASYM], 0 },
+	{ "pl","plhbt",_f0, 0, tx_print_int, get_int,   set_nul,(float *)&mps.zoid[ZOID_HBT], 0 },
+	{ "pl","plbk", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&mps.blocks, 0 },			// planner report - blocks planned
+	{ "pl","plrp", _f0, 0, tx_print_flt, pl_get_rp, set_nul,(float *)&cs.null, 0 },				// planner report - trapezoids per block
+	{ "pl","plnr", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&mps.optimal, 0 },			// planner report - blocks made non-replannable
+	{ "pl","plmt", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&mps.min_time_moves, 0 },	// planner report - minimum time moves rejected
+	{ "pl","plst", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&mps.starved, 0 },			// planner report - queue starved in cycle
+	{ "pl","plmin",_f0, 0, tx_print_int, pl_get_min,set_nul,(float *)&cs.null, 0 },				// planner report - planning time per block (us)
+	{ "pl","plavg",_f0, 0, tx_print_flt, pl_get_avg,set_nul,(float *)&cs.null, 0 },
+	{ "pl","plmax",_f0, 0, tx_print_int, pl_get_max,set_nul,(float *)&cs.null, 0 },
+	{ "pl","plhd", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&mps.holds, 0 },			// planner report - feedholds planned
+	{ "pl","plhp", _f0, 0, tx_print_int, pl_get_hp, set_nul,(float *)&cs.null, 0 },				// planner report - longest feedhold plan (us)
+	{ "pl","plhl", _f0, 0, tx_print_int, pl_get_hl, set_nul,(float *)&cs.null, 0 },				// planner report - longest '!' to first decel segment (us)
+	{ "pl","plpr", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&mps.primes, 0 },			// planner report - starts held for priming
+	{ "pl","plsc", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&mps.sync_commands, 0 },	// planner report - commands run inside motion
+	{ "pl","plli", _f0, 0, tx_print_flt, get_flt,   set_nul,(float *)&mb.line_interval, 0 },		// planner report - time between received lines (ms)
+
+	{ "sim","sime", _f0, 0, tx_print_int, get_ui8,    set_nul,(float *)&st_sim.enable, 0 },		// dry run report - {sim:1} in effect
+	{ "sim","simt", _f0, 0, tx_print_flt, st_get_simt,set_nul,(float *)&cs.null, 0 },			// dry run report - motion and dwell time (s)
+	{ "sim","simsg",_f0, 0, tx_print_int, get_int,    set_nul,(float *)&st_sim.segments, 0 },	// dry run report - segments executed
+	{ "sim","simpk",_f0, 0, tx_print_int, pl_get_max, set_nul,(float *)&cs.null, 0 },			// dry run report - peak block planning time (us)
+
+	{ "et","etemn",_f0, 0, tx_print_int, st_get_et, set_nul,(float *)&st_tm.exec_min, 0 },		// exec timing - exec and prep of a segment (us)
+	{ "et","etemx",_f0, 0, tx_print_int, st_get_et, set_nul,(float *)&st_tm.exec_max, 0 },
+	{ "et","etpmn",_f0, 0, tx_print_int, st_get_et, set_nul,(float *)&st_tm.prep_min, 0 },		// exec timing - st_prep_line() alone (us)
+	{ "et","etpmx",_f0, 0, tx_print_int, st_get_et, set_nul,(float *)&st_tm.prep_max, 0 },
+	{ "et","etlmn",_f0, 0, tx_print_int, st_get_et, set_nul,(float *)&st_tm.load_min, 0 },		// exec timing - line segment load (us)
+	{ "et","etlmx",_f0, 0, tx_print_int, st_get_et, set_nul,(float *)&st_tm.load_max, 0 },
+	{ "et","ete0", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&st_tm.exec_bucket[0], 0 },	// exec timing - exec passes by quarter of the budget
+	{ "et","ete1", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&st_tm.exec_bucket[1], 0 },
+	{ "et","ete2", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&st_tm.exec_bucket[2], 0 },
+	{ "et","ete3", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&st_tm.exec_bucket[3], 0 },
+	{ "et","ete4", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&st_tm.exec_bucket[4], 0 },
+	{ "et","ete5", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&st_tm.exec_bucket[5], 0 },
+	{ "et","etl0", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&st_tm.load_bucket[0], 0 },	// exec timing - loads by quarter of the budget
+	{ "et","etl1", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&st_tm.load_bucket[1], 0 },
+	{ "et","etl2", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&st_tm.load_bucket[2], 0 },
+	{ "et","etl3", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&st_tm.load_bucket[3], 0 },
+	{ "et","etl4", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&st_tm.load_bucket[4], 0 },
+	{ "et","etl5", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&st_tm.load_bucket[5], 0 },
+	{ "et","eteo", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&st_tm.exec_overruns, 0 },	// exec timing - exec passes over budget
+	{ "et","etlo", _f0, 0, tx_print_int, get_int,   set_nul,(float *)&st_tm.load_overruns, 0 },	// exec timing - loads over budget
 	{ "", "er",  _f0, 0, tx_print_nul, rpt_er,  set_nul,  (float *)&cs.null, 0 },	// invoke bogus exception report for testing
 	{ "", "qf",  _f0, 0, tx_print_nul, get_nul, cm_run_qf,(float *)&cs.null, 0 },	// queue flush
 	{ "", "rx",  _f0, 0, tx_print_int, get_rx,  set_nul,  (float *)&cs.null, 0 },	// space in RX buffer
 	{ "", "msg", _f0, 0, tx_print_str, get_nul, set_nul,  (float *)&cs.null, 0 },	// string for generic messages
 //	{ "", "clc", _f0, 0, tx_print_nul, st_clc,  st_clc,   (float *)&cs.null, 0 },	// clear diagnostic step counters
+	{ "", "clp", _f0, 0, tx_print_nul, pl_clear,pl_clear, (float *)&cs.null, 0 },	// clear planner report counters
+	{ "", "clt", _f0, 0, tx_print_nul, st_clt,  st_clt,   (float *)&cs.null, 0 },	// clear exec timing report
 	{ "", "clear",_f0,0, tx_print_nul, cm_clear,cm_clear, (float *)&cs.null, 0 },	// GET a clear to clear soft alarm
 //	{ "", "sx",  _f0, 0, tx_print_nul, run_sx,  run_sx ,  (float *)&cs.null, 0 },	// send XOFF, XON test
 
@@ -206,7 +269,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 #endif
 
 	// Motor parameters
-	{ "1","1ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_1].motor_map,	M1_MOTOR_MAP },
+	{ "1","1ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_1].motor_map,	M1_MOTOR_MAP },
 	{ "1","1sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_1].step_angle,	M1_STEP_ANGLE },
 	{ "1","1tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_1].travel_rev,	M1_TRAVEL_PER_REV },
 	{ "1","1mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_1].microsteps,	M1_MICROSTEPS },
@@ -216,7 +279,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "1","1pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_1].power_level,M1_POWER_LEVEL },
 #endif
 #if (MOTORS >= 2)
-	{ "2","2ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_2].motor_map,	M2_MOTOR_MAP },
+	{ "2","2ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_2].motor_map,	M2_MOTOR_MAP },
 	{ "2","2sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_2].step_angle,	M2_STEP_ANGLE },
 	{ "2","2tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_2].travel_rev,	M2_TRAVEL_PER_REV },
 	{ "2","2mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_2].microsteps,	M2_MICROSTEPS },
@@ -227,7 +290,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 #endif
 #endif
 #if (MOTORS >= 3)
-	{ "3","3ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_3].motor_map,	M3_MOTOR_MAP },
+	{ "3","3ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_3].motor_map,	M3_MOTOR_MAP },
 	{ "3","3sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_3].step_angle,	M3_STEP_ANGLE },
 	{ "3","3tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_3].travel_rev,	M3_TRAVEL_PER_REV },
 	{ "3","3mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_3].microsteps,	M3_MICROSTEPS },
@@ -238,7 +301,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 #endif
 #endif
 #if (MOTORS >= 4)
-	{ "4","4ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_4].motor_map,	M4_MOTOR_MAP },
+	{ "4","4ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_4].motor_map,	M4_MOTOR_MAP },
 	{ "4","4sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_4].step_angle,	M4_STEP_ANGLE },
 	{ "4","4tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_4].travel_rev,	M4_TRAVEL_PER_REV },
 	{ "4","4mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_4].microsteps,	M4_MICROSTEPS },
@@ -249,7 +312,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 #endif
 #endif
 #if (MOTORS >= 5)
-	{ "5","5ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_5].motor_map,	M5_MOTOR_MAP },
+	{ "5","5ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_5].motor_map,	M5_MOTOR_MAP },
 	{ "5","5sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_5].step_angle,	M5_STEP_ANGLE },
 	{ "5","5tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_5].travel_rev,	M5_TRAVEL_PER_REV },
 	{ "5","5mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_5].microsteps,	M5_MICROSTEPS },
@@ -260,7 +323,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 #endif
 #endif
 #if (MOTORS >= 6)
-	{ "6","6ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_6].motor_map,	M6_MOTOR_MAP },
+	{ "6","6ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_6].motor_map,	M6_MOTOR_MAP },
 	{ "6","6sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_6].step_angle,	M6_STEP_ANGLE },
 	{ "6","6tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_6].travel_rev,	M6_TRAVEL_PER_REV },
 	{ "6","6mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_6].microsteps,	M6_MICROSTEPS },
@@ -277,6 +340,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "x","xtn",_fipc, 3, cm_print_tn, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].travel_min,		X_TRAVEL_MIN },
 	{ "x","xtm",_fipc, 3, cm_print_tm, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].travel_max,		X_TRAVEL_MAX },
 	{ "x","xjm",_fipc, 0, cm_print_jm, get_flt,   cm_set_xjm,(float *)&cm.a[AXIS_X].jerk_max,		X_JERK_MAX },
+	{ "x","xac",_fipc, 0, cm_print_ac, get_flt,   cm_set_xac,(float *)&cm.a[AXIS_X].accel_max,		X_ACCEL_MAX },
 	{ "x","xjh",_fipc, 0, cm_print_jh, get_flt,	  cm_set_xjh,(float *)&cm.a[AXIS_X].jerk_homing,	X_JERK_HOMING },
 	{ "x","xjd",_fipc, 4, cm_print_jd, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].junction_dev,	X_JUNCTION_DEVIATION },
 	{ "x","xsn",_fip,  0, cm_print_sn, get_ui8,   sw_set_sw, (float *)&sw.mode[0],					X_SWITCH_MODE_MIN },
@@ -294,6 +358,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "y","ytn",_fipc, 3, cm_print_tn, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].travel_min,		Y_TRAVEL_MIN },
 	{ "y","ytm",_fipc, 3, cm_print_tm, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].travel_max,		Y_TRAVEL_MAX },
 	{ "y","yjm",_fipc, 0, cm_print_jm, get_flt,	  cm_set_xjm,(float *)&cm.a[AXIS_Y].jerk_max,		Y_JERK_MAX },
+	{ "y","yac",_fipc, 0, cm_print_ac, get_flt,   cm_set_xac,(float *)&cm.a[AXIS_Y].accel_max,		Y_ACCEL_MAX },
 	{ "y","yjh",_fipc, 0, cm_print_jh, get_flt,	  cm_set_xjh,(float *)&cm.a[AXIS_Y].jerk_homing,	Y_JERK_HOMING },
 	{ "y","yjd",_fipc, 4, cm_print_jd, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].junction_dev,	Y_JUNCTION_DEVIATION },
 	{ "y","ysn",_fip,  0, cm_print_sn, get_ui8,   sw_set_sw, (float *)&sw.mode[2],					Y_SWITCH_MODE_MIN },
@@ -311,6 +376,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "z","ztn",_fipc, 3, cm_print_tn, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].travel_min,		Z_TRAVEL_MIN },
 	{ "z","ztm",_fipc, 3, cm_print_tm, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].travel_max,		Z_TRAVEL_MAX },
 	{ "z","zjm",_fipc, 0, cm_print_jm, get_flt,	  cm_set_xjm,(float *)&cm.a[AXIS_Z].jerk_max,		Z_JERK_MAX },
+	{ "z","zac",_fipc, 0, cm_print_ac, get_flt,   cm_set_xac,(float *)&cm.a[AXIS_Z].accel_max,		Z_ACCEL_MAX },
 	{ "z","zjh",_fipc, 0, cm_print_jh, get_flt,	  cm_set_xjh,(float *)&cm.a[AXIS_Z].jerk_homing, 	Z_JERK_HOMING },
 	{ "z","zjd",_fipc, 4, cm_print_jd, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].junction_dev,	Z_JUNCTION_DEVIATION },
 	{ "z","zsn",_fip,  0, cm_print_sn, get_ui8,   sw_set_sw, (float *)&sw.mode[4],					Z_SWITCH_MODE_MIN },
@@ -328,6 +394,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "a","atn",_fip,  3, cm_print_tn, get_flt,   set_flu,   (float *)&cm.a[AXIS_A].travel_min,		A_TRAVEL_MIN },
 	{ "a","atm",_fip,  3, cm_print_tm, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].travel_max,		A_TRAVEL_MAX },
 	{ "a","ajm",_fip,  0, cm_print_jm, get_flt,	  cm_set_xjm,(float *)&cm.a[AXIS_A].jerk_max,		A_JERK_MAX },
+	{ "a","aac",_fip,  0, cm_print_ac, get_flt,   cm_set_xac,(float *)&cm.a[AXIS_A].accel_max,		A_ACCEL_MAX },
 	{ "a","ajh",_fip,  0, cm_print_jh, get_flt,	  cm_set_xjh,(float *)&cm.a[AXIS_A].jerk_homing, 	A_JERK_HOMING },
 	{ "a","ajd",_fip,  4, cm_print_jd, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].junction_dev,	A_JUNCTION_DEVIATION },
 	{ "a","ara",_fipc, 3, cm_print_ra, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].radius,			A_RADIUS},
@@ -346,6 +413,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "b","btn",_fip,  3, cm_print_tn, get_flt,   set_flu,   (float *)&cm.a[AXIS_B].travel_min,		B_TRAVEL_MIN },
 	{ "b","btm",_fip,  3, cm_print_tm, get_flt,   set_flt,   (float *)&cm.a[AXIS_B].travel_max,		B_TRAVEL_MAX },
 	{ "b","bjm",_fip,  0, cm_print_jm, get_flt,	  cm_set_xjm,(float *)&cm.a[AXIS_B].jerk_max,		B_JERK_MAX },
+	{ "b","bac",_fip,  0, cm_print_ac, get_flt,   cm_set_xac,(float *)&cm.a[AXIS_B].accel_max,		B_ACCEL_MAX },
 	{ "b","bjd",_fip,  0, cm_print_jd, get_flt,   set_flt,   (float *)&cm.a[AXIS_B].junction_dev,	B_JUNCTION_DEVIATION },
 	{ "b","bra",_fipc, 3, cm_print_ra, get_flt,   set_flt,   (float *)&cm.a[AXIS_B].radius,			B_RADIUS },
 #ifdef __ARM	// B axis extended parameters
@@ -364,6 +432,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "c","ctn",_fip,  3, cm_print_tn, get_flt,   set_flu,   (float *)&cm.a[AXIS_C].travel_min,		C_TRAVEL_MIN },
 	{ "c","ctm",_fip,  3, cm_print_tm, get_flt,   set_flt,   (float *)&cm.a[AXIS_C].travel_max,		C_TRAVEL_MAX },
 	{ "c","cjm",_fip,  0, cm_print_jm, get_flt,	  cm_set_xjm,(float *)&cm.a[AXIS_C].jerk_max,		C_JERK_MAX },
+	{ "c","cac",_fip,  0, cm_print_ac, get_flt,   cm_set_xac,(float *)&cm.a[AXIS_C].accel_max,		C_ACCEL_MAX },
 	{ "c","cjd",_fip,  0, cm_print_jd, get_flt,   set_flt,   (float *)&cm.a[AXIS_C].junction_dev,	C_JUNCTION_DEVIATION },
 	{ "c","cra",_fipc, 3, cm_print_ra, get_flt,   set_flt,   (float *)&cm.a[AXIS_C].radius,			C_RADIUS },
 #ifdef __ARM	// C axis extended parameters
@@ -482,6 +551,9 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "sys","ex",  _fipn, 0, cfg_print_ex,  get_ui8,   set_ex,     (float *)&cfg.enable_flow_control,COM_ENABLE_FLOW_CONTROL },
 	{ "sys","baud",_fn,   0, cfg_print_baud,get_ui8,   set_baud,   (float *)&cfg.usb_baud_rate,		XIO_BAUD_115200 },
 	{ "sys","net", _fipn, 0, cfg_print_net, get_ui8,   set_ui8,    (float *)&cs.network_mode,		NETWORK_MODE },
+#ifdef PLANNER_HEAP_POOL
+	{ "sys","pool",_fipn, 0, cfg_print_pool,get_ui8,   set_ui8,    (float *)&cfg.planner_pool_size,	PLANNER_BUFFER_POOL_SIZE },
+#endif
 
 	// switch state readouts
 /*
@@ -673,6 +745,9 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "","pwr",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// motor power enagled group
 	{ "","jog",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// axis jogging state group
 	{ "","jid",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// job ID group
+	{ "","pl", _f0, 0, tx_print_nul, get_grp, set_nul,(float *)&cs.null,0 },	// planner report group
+	{ "","sim",_f0, 0, tx_print_nul, get_grp, st_set_sim,(float *)&cs.null,0 },	// dry run report group - {sim:1} enters dry run
+	{ "","et", _f0, 0, tx_print_nul, get_grp, set_nul,(float *)&cs.null,0 },	// exec timing report group
 
 	{ "","uda", _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// user data group
 	{ "","udb", _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// user data group
@@ -701,7 +776,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 /***** Make sure these defines line up with any changes in the above table *****/
 
 #define NV_COUNT_UBER_GROUPS 	4 		// count of uber-groups, above
-#define STANDARD_GROUPS 		33		// count of standard groups, excluding diagnostic parameter groups
+#define STANDARD_GROUPS 		36		// count of standard groups, excluding diagnostic parameter groups
 
 #if (MOTORS >= 5)
 #define MOTOR_GROUP_5			1
@@ -979,6 +1054,7 @@ static const char fmt_ex[] PROGMEM = "[ex]  enable flow control%10d [0=off,1=XON
 static const char fmt_baud[] PROGMEM = "[baud] USB baud rate%15d [1=9600,2=19200,3=38400,4=57600,5=115200,6=230400]\n";
 static const char fmt_net[] PROGMEM = "[net] network mode%17d [0=master]\n";
 static const char fmt_rx[] PROGMEM = "rx:%d\n";
+static const char fmt_pool[] PROGMEM = "[pool] planner buffers%12d [at reset]\n";
 
 void cfg_print_ec(nvObj_t *nv) { text_print_ui8(nv, fmt_ec);}
 void cfg_print_ee(nvObj_t *nv) { text_print_ui8(nv, fmt_ee);}
@@ -986,6 +1062,7 @@ void cfg_print_ex(nvObj_t *nv) { text_print_ui8(nv, fmt_ex);}
 void cfg_print_baud(nvObj_t *nv) { text_print_ui8(nv, fmt_baud);}
 void cfg_print_net(nvObj_t *nv) { text_print_ui8(nv, fmt_net);}
 void cfg_print_rx(nvObj_t *nv) { text_print_ui8(nv, fmt_rx);}
+void cfg_print_pool(nvObj_t *nv) { text_print_ui8(nv, fmt_pool);}
 
 #endif // __TEXT_MODE
 
@@ -55,6 +55,9 @@ typedef struct cfgParameters {		// mostly communications variables at this point
 	uint8_t usb_baud_rate;			// see xio_usart.h for XIO_BAUD values
 	uint8_t usb_baud_flag;			// technically this belongs in the controller singleton
 
+	// planner settings
+	uint8_t planner_pool_size;		// planner buffers allocated at reset (PLANNER_HEAP_POOL builds)
+
 	// user-defined data groups
 	uint32_t user_data_a[4];
 	uint32_t user_data_b[4];
@@ -91,6 +94,7 @@ uint8_t job_report_callback();
 	void cfg_print_baud(nvObj_t *nv);
 	void cfg_print_net(nvObj_t *nv);
 	void cfg_print_rx(nvObj_t *nv);
+	void cfg_print_pool(nvObj_t *nv);
 
 #else
 
@@ -100,6 +104,7 @@ uint8_t job_report_callback();
 	#define cfg_print_baud tx_print_stub
 	#define cfg_print_net tx_print_stub
 	#define cfg_print_rx tx_print_stub
+	#define cfg_print_pool tx_print_stub
 
 #endif // __TEXT_MODE
 
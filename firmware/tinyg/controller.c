@@ -54,7 +54,7 @@
  **** 结构体分配 ********************************************************************
  ***********************************************************************************/
 
-controller_t cs;		// 控制器状态结构体 
+THREAD_LOCAL controller_t cs;		// 控制器状态结构体 
 
 /***********************************************************************************
  **** 静态和本地函数 ****************************************************************
@@ -160,6 +160,7 @@ static void _controller_HSM()
 
 	DISPATCH(cm_feedhold_sequencing_callback());// 6a. feedhold state machine runner
 	DISPATCH(mp_plan_hold_callback());			// 6b. plan a feedhold from line runtime
+	DISPATCH(mp_feed_override_callback());		// 6c. apply a feed rate override to queued and running moves
 	DISPATCH(_system_assertions());				// 7. system integrity assertions
 
 //----- G代码和循环的规划器结构 ---------------------------------------//
@@ -169,7 +170,12 @@ static void _controller_HSM()
 	DISPATCH(sr_status_report_callback());		// conditionally send status report
 	DISPATCH(qr_queue_report_callback());		// conditionally send queue report
 	DISPATCH(rx_report_callback());             // conditionally send rx report
+	DISPATCH(st_sim_report_callback());			// send the dry run report at program end
+	DISPATCH(st_sim_callback());				// run the held dry run exec once the queue is full or input ends
+	DISPATCH(st_timing_callback());				// report the first exec or load over its time budget
 	DISPATCH(cm_arc_callback());				// arc generation runs behind lines
+	DISPATCH(mp_merge_callback());				// release a held G64 P line before the queue runs dry
+	DISPATCH(mp_prime_callback());				// start a line from standstill once the queue is primed
 	DISPATCH(cm_homing_callback());				// G28.2 continuation
 	DISPATCH(cm_jogging_callback());			// jog function
 	DISPATCH(cm_probe_callback());				// G38.2 continuation
@@ -205,6 +211,7 @@ static stat_t _command_dispatch()
 	while (true) {
 		if ((status = xio_gets(cs.primary_src, cs.in_buf, sizeof(cs.in_buf))) == STAT_OK) {
 			cs.bufp = cs.in_buf;
+			mp_record_line_arrival();					// line rate for start-up priming and dry run pacing
 			break;
 		}
 		// 从file devices中处理 end-of-line
@@ -388,6 +395,9 @@ static stat_t _sync_to_planner()
 	if (mp_get_planner_buffers_available() < PLANNER_BUFFER_HEADROOM) { // allow up to N planner buffers for this line
 		return (STAT_EAGAIN);
 	}
+	if (mp_get_planner_queue_time() >= PLANNER_LOOKAHEAD_TIME) { // enough motion is already planned
+		return (STAT_EAGAIN);
+	}
 	return (STAT_OK);
 }
 
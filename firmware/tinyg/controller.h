@@ -79,7 +79,7 @@ typedef struct controllerSingleton {	// main TG controller struct
 	magic_t magic_end;
 } controller_t;
 
-extern controller_t cs;					// controller state structure
+extern THREAD_LOCAL controller_t cs;					// controller state structure
 
 enum cmControllerState {				// manages startup lines
 	CONTROLLER_INITIALIZING = 0,		// controller is initializing - not ready for use
@@ -35,7 +35,7 @@ extern "C"{
 
 /**** Allocate Structures ****/
 
-enEncoders_t en;
+THREAD_LOCAL enEncoders_t en;
 
 /************************************************************************************
  **** CODE **************************************************************************
@@ -115,7 +115,7 @@ typedef struct enEncoders {
 	magic_t magic_end;
 } enEncoders_t;
 
-extern enEncoders_t en;
+extern THREAD_LOCAL enEncoders_t en;
 
 
 /**** FUNCTION PROTOTYPES ****/
@@ -31,7 +31,7 @@ extern "C"{
 
 struct gcodeParserSingleton {	 	  // struct to manage globals
 	uint8_t modals[MODAL_GROUP_COUNT];// collects modal groups in a block
-}; struct gcodeParserSingleton gp;
+}; THREAD_LOCAL struct gcodeParserSingleton gp;
 
 // local helper functions and macros
 static void _normalize_gcode_block(char_t *str, char_t **com, char_t **msg, uint8_t *block_delete_flag);
@@ -469,6 +469,9 @@ static stat_t _execute_gcode_block()
 	//--> cutter length compensation goes here
 	EXEC_FUNC(cm_set_coord_system, coord_system);
 	EXEC_FUNC(cm_set_path_control, path_control);
+	if ((cm.gf.path_control == true) && (cm.gn.path_control == PATH_CONTINUOUS) && fp_TRUE(cm.gf.parameter)) {
+		status = cm_set_path_tolerance(cm.gn.parameter);	// G64 P
+	}
 	EXEC_FUNC(cm_set_distance_mode, distance_mode);
 	//--> set retract mode goes here
 
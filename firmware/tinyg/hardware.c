@@ -82,6 +82,19 @@ void hardware_init()
 	xmega_init();							// 设置系统时钟 
 	_port_bindings(TINYG_HARDWARE_VERSION);
 	rtc_init();								// 实时时钟计数器 
+	TIMER_PLAN.CTRLA = PLAN_TIMER_ENABLE;	// 规划耗时统计定时器
+#endif
+}
+
+/*
+ * hw_get_plan_timer() - 自由运行的时间戳，单位为PLAN_TIMER_USEC，用于规划耗时统计
+ */
+uint16_t hw_get_plan_timer()
+{
+#ifdef __AVR
+	return (TIMER_PLAN.CNT);
+#else
+	return (0);
 #endif
 }
 
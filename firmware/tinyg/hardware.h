@@ -200,7 +200,7 @@ enum cfgPortBits {			// 电机控制端口位位置
 #define TIMER_DWELL	 		TCD0		// Dwell 定时器	(see stepper.h)
 #define TIMER_LOAD			TCE0		// Loader 定时器(see stepper.h)
 #define TIMER_EXEC			TCF0		// Exec 定时器	(see stepper.h)
-#define TIMER_5				TCC1		// 未使用定时器 
+#define TIMER_PLAN			TCC1		// 规划耗时统计，自由运行 (see planner.c)
 #define TIMER_PWM1			TCD1		// PWM 定时器 #1 (see pwm.c)
 #define TIMER_PWM2			TCE1		// PWM 定时器 #2 (see pwm.c)
 
@@ -225,6 +225,9 @@ enum cfgPortBits {			// 电机控制端口位位置
 #define EXEC_TIMER_ENABLE	1				// turn exec timer clock on (F_CPU = 32 Mhz)
 #define EXEC_TIMER_WGMODE	0				// normal mode (count to TOP and rollover)
 
+#define PLAN_TIMER_ENABLE	TC_CLKSEL_DIV64_gc	// F_CPU/64 = 500 kHz, free running over 16 bits
+#define PLAN_TIMER_USEC		2				// microseconds per plan timer tick
+
 #define TIMER_DDA_ISR_vect	TCC0_OVF_vect	// must agree with assignment in system.h
 #define TIMER_DWELL_ISR_vect TCD0_OVF_vect	// must agree with assignment in system.h
 #define TIMER_LOAD_ISR_vect	TCE0_OVF_vect	// must agree with assignment in system.h
@@ -264,6 +267,7 @@ hwSingleton_t hw;
 /*** 函数原型 ***/
 
 void hardware_init(void);			// 主硬件初始化
+uint16_t hw_get_plan_timer(void);	// 规划耗时统计用的时间戳
 void hw_request_hard_reset();
 void hw_hard_reset(void);
 stat_t hw_hard_reset_handler(void);
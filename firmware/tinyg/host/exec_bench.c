@@ -0,0 +1,285 @@
+/*
+ * exec_bench.c - cost and drift of the aline exec's velocity generators, from the firmware exec
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ * Usage: exec_bench [-r repeats]
+ *
+ *	Runs every trapezoid shape through mp_exec_move() as a single block queued by hand,
+ *	at three scales: a short move, a feed and a long traverse whose heads and tails run
+ *	to about a thousand segments. The head, body and tail lengths are the planner's
+ *	(mp_get_target_length()), and the "7-seg" shape has an acceleration limit of half
+ *	the S-curve's peak so that its head and tail are stretched (see _init_accel_section()).
+ *
+ *	make execbench builds and runs it three times, with all sources compiled for one
+ *	of the exec's velocity generators (see tinyg.h):
+ *	  exec_bench		- 5th order forward differences (the default)
+ *	  exec_bench_kahan	- the same with Kahan summation (__KAHAN)
+ *	  exec_bench_jerk	- velocity computed from the jerk at each segment (__JERK_EXEC)
+ *
+ *	Reported per shape and scale:
+ *	  segments	- segments in the block
+ *	  ns/seg	- wall time per mp_exec_move() pass that prepared a segment (best of N)
+ *	  cyc/seg	- the same in CPU timestamp counter cycles
+ *	  vel err	- largest difference between the velocity of the last segment of a head
+ *				  or tail and the same velocity worked out in double precision from the
+ *				  variant's own curve (mm/min). This is the drift of the float math
+ *	  corr		- largest waypoint correction _exec_aline_segment() applied at the end of
+ *				  a section: the distance between the waypoint and where the segments
+ *				  would have put the section end (um)
+ */
+#include "tinyg.h"
+#include "config.h"
+#include "canonical_machine.h"
+#include "planner.h"
+#include "stepper.h"
+#include "hardware.h"
+#include "util.h"
+#include "host.h"
+
+#define EXEC_REPEATS	20
+
+#if defined(__JERK_EXEC)
+#define EXEC_VARIANT	"computed jerk (__JERK_EXEC)"
+#elif defined(__KAHAN)
+#define EXEC_VARIANT	"forward differencing, Kahan summation (__KAHAN)"
+#else
+#define EXEC_VARIANT	"forward differencing"
+#endif
+
+typedef struct execShape {			// velocities as a fraction of the scale's cruise velocity
+	const char *name;
+	float entry;
+	float cruise;
+	float exit;
+	float body;						// seconds at the cruise velocity
+	uint8_t accel_limited;			// true for a 7-segment head and tail
+} execShape_t;
+
+typedef struct execScale {
+	const char *name;
+	float velocity;					// mm/min
+	float jerk;						// mm/min^3
+} execScale_t;
+
+static const execShape_t shapes[] = {
+	{ "H",		0,    1, 1,   0,   false },
+	{ "T",		1,    1, 0,   0,   false },
+	{ "B",		1,    1, 1,   0.2, false },
+	{ "HB",		0,    1, 1,   0.2, false },
+	{ "BT",		1,    1, 0,   0.2, false },
+	{ "HT",		0,    1, 0,   0,   false },
+	{ "HT'",	0.25, 1, 0.6, 0,   false },
+	{ "HBT",	0,    1, 0,   0.2, false },
+	{ "HBT 7-seg", 0, 1, 0,   0.2, true },
+};
+
+static const execScale_t scales[] = {
+	{ "short",		200,  50000000 },
+	{ "feed",		800,  20000000 },
+	{ "traverse",	8000, 5000000 },
+};
+
+static const float unit[AXES] = { 0.6, 0.8, 0, 0, 0, 0 };
+
+typedef struct execRun {			// what one block came to
+	uint32_t segments;
+	double usec;					// in passes that prepared a segment
+	uint64_t cycles;
+	double velocity_error;			// mm/min
+	double correction;				// mm
+	uint32_t hold;					// hold segments of the section running (forward differences)
+} execRun_t;
+
+static execRun_t er;
+
+stat_t __real_st_prep_line(float travel_steps[], float following_error[], float segment_time);
+
+/*
+ * _smooth() - the quintic the forward differences run over a section, 0..1 over u = 0..1
+ */
+
+static double _smooth(double u)
+{
+	return (u*u*u * (10 - 15*u + 6*u*u));
+}
+
+/*
+ * _get_last_velocity() - velocity of a head or tail's last segment, in double precision
+ */
+
+static double _get_last_velocity(double Vi, double Vt)
+{
+#ifdef __JERK_EXEC
+	double delta_v = fabs(Vt - Vi);
+	double accel_time = 2 * sqrt(delta_v / mr.jerk);
+	double midpoint_acceleration = 2 * delta_v / accel_time;
+	double t = accel_time/2 - accel_time / (4 * mr.segments);	// midpoint of the last segment
+	double rise = t * midpoint_acceleration - mr.jerk/2 * t*t;	// from the midpoint velocity
+
+	return ((Vi + Vt)/2 + ((Vt > Vi) ? rise : -rise));
+#else
+	double n = mr.segments;
+	double curve = Vt - Vi;
+
+	if (er.hold != 0) {										// 7-segment: the curve runs over fewer
+		double half = (n - er.hold) / 2;					// segments with a smaller dV
+		double step = _smooth((half + 0.5) / (2*half)) - _smooth((half - 0.5) / (2*half));
+		curve /= 1 + er.hold * step;
+		n -= er.hold;
+	}
+	return (Vt - curve * (1 - _smooth(1 - 1/(2*n))));
+#endif
+}
+
+/*
+ * __wrap_st_prep_line() - look at the segment the exec prepares
+ *
+ *	At the last segment of a section the exec has already moved the target onto the
+ *	waypoint. Where the segment would have ended is mr.position plus its own length.
+ */
+stat_t __wrap_st_prep_line(float travel_steps[], float following_error[], float segment_time)
+{
+	stat_t status = __real_st_prep_line(travel_steps, following_error, segment_time);
+
+	if (status != STAT_OK) { return (status); }
+	er.segments++;
+#ifndef __JERK_EXEC
+	if (mr.section_state == SECTION_1st_HALF) {				// first segment of the section
+		er.hold = mr.accel_segments;
+	}
+#endif
+	if ((mr.segment_count != 0) || (mr.section_state != SECTION_2nd_HALF)) {
+		return (status);
+	}
+	double correction = 0;
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		double end = mr.position[axis] + mr.unit[axis] * mr.segment_velocity * segment_time;
+		correction += square(mr.gm.target[axis] - end);
+	}
+	er.correction = max(er.correction, sqrt(correction));
+
+	double error = 0;
+	if (mr.section == SECTION_HEAD) {
+		error = mr.segment_velocity - _get_last_velocity(mr.entry_velocity, mr.cruise_velocity);
+	} else if (mr.section == SECTION_TAIL) {
+		error = mr.segment_velocity - _get_last_velocity(mr.cruise_velocity, mr.exit_velocity);
+	}
+	er.velocity_error = max(er.velocity_error, fabs(error));
+	return (status);
+}
+
+/*
+ * _queue_block() - commit one line block of the given shape, as _plan_line() would leave it
+ */
+
+static void _queue_block(const execShape_t *shape, const execScale_t *scale)
+{
+	mpBuf_t *bf = mp_get_write_buffer();
+	GCodeState_t gm = cm.gm;
+	float velocity = scale->velocity;
+
+	bf->bf_func = mp_exec_aline;
+	bf->jerk = scale->jerk;
+	bf->recip_jerk = 1 / scale->jerk;
+	bf->cbrt_jerk = cbrt(scale->jerk);
+	if (shape->accel_limited == true) {						// half the peak of the S-curve from 0
+		bf->accel = ACCEL_PEAK_FACTOR * velocity / (2 * sqrt(velocity / scale->jerk)) / 2;
+	}
+	bf->entry_velocity = shape->entry * velocity;
+	bf->cruise_velocity = shape->cruise * velocity;
+	bf->exit_velocity = shape->exit * velocity;
+	bf->head_length = mp_get_target_length(bf->entry_velocity, bf->cruise_velocity, bf);
+	bf->body_length = shape->body * bf->cruise_velocity / 60;
+	bf->tail_length = mp_get_target_length(bf->exit_velocity, bf->cruise_velocity, bf);
+	bf->length = bf->head_length + bf->body_length + bf->tail_length;
+	bf->move_time = 2 * bf->head_length / (bf->entry_velocity + bf->cruise_velocity) +
+					bf->body_length / bf->cruise_velocity +
+					2 * bf->tail_length / (bf->cruise_velocity + bf->exit_velocity);
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		bf->unit[axis] = unit[axis];
+		gm.target[axis] = mr.position[axis] + unit[axis] * bf->length;
+	}
+	gm.move_time = bf->move_time;
+	mp_save_gcode_state(bf->gm, &gm);
+	mp_commit_write_buffer(MOVE_TYPE_ALINE);
+}
+
+/*
+ * _run_block() - run one block through the exec, timing the passes that prepare a segment
+ */
+
+static void _run_block(const execShape_t *shape, const execScale_t *scale)
+{
+	host_init(PLANNER_BUFFER_POOL_SIZE);
+	while (host_exec_move() != STAT_NOOP);						// commands queued by the init
+	memset(&er, 0, sizeof(er));
+	cm_cycle_start();
+	_queue_block(shape, scale);
+
+	for (;;) {
+		uint32_t segments = er.segments;
+		double start = host_usec();
+		uint64_t cycles = host_cycles();
+		stat_t status = mp_exec_move();
+		cycles = host_cycles() - cycles;
+		double usec = host_usec() - start;
+		host_load_move();										// keep the prep queue from filling
+
+		if (er.segments != segments) {
+			er.cycles += cycles;
+			er.usec += usec;
+		} else if ((status == STAT_NOOP) && (mb.priming == true)) {
+			rtc.sys_ticks++;									// held to prime the queue
+		} else if (status == STAT_NOOP) {
+			break;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int repeats = EXEC_REPEATS;
+
+	if ((argc == 3) && (strcmp(argv[1], "-r") == 0)) {
+		repeats = max(atoi(argv[2]), 1);
+	} else if (argc != 1) {
+		fprintf(stderr, "usage: %s [-r repeats]\n", argv[0]);
+		return (1);
+	}
+	printf("exec: %s, segments %d us (bodies %d us)\n", EXEC_VARIANT,
+		   (int)NOM_SEGMENT_USEC, (int)BODY_SEGMENT_USEC);
+	printf("%-10s %-9s %9s %8s %8s %10s %10s\n", "shape", "scale", "segments", "ns/seg",
+		   "cyc/seg", "vel err", "corr (um)");
+
+	for (uint8_t s = 0; s < sizeof(shapes)/sizeof(shapes[0]); s++) {
+		for (uint8_t k = 0; k < sizeof(scales)/sizeof(scales[0]); k++) {
+			double best_usec = INFINITY;
+			double best_cycles = INFINITY;
+
+			for (int r = 0; r < repeats; r++) {
+				_run_block(&shapes[s], &scales[k]);
+				best_usec = min(best_usec, er.usec / max(er.segments, 1));
+				best_cycles = min(best_cycles, (double)er.cycles / max(er.segments, 1));
+			}
+			printf("%-10s %-9s %9lu %8.1f %8.0f %10.2e %10.3f\n", shapes[s].name, scales[k].name,
+				   (unsigned long)er.segments, best_usec * 1000, best_cycles,
+				   er.velocity_error, er.correction * 1000);
+		}
+	}
+	return (0);
+}
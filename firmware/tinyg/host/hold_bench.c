@@ -0,0 +1,364 @@
+/*
+ * hold_bench.c - feedhold latency and stopping distance, from the firmware planner
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ * Usage: hold_bench [-g gap] [-s seed] file.gcode [file.gcode ...]
+ *
+ *	Streams each file through the parser, planner and exec as planner_bench does and
+ *	fires a feedhold ('!') after a random number of segments, on average every gap
+ *	(default HOLD_GAP). Each hold is released with a cycle start as soon as the machine
+ *	stands still, and the job runs on to the next one. Between exec passes the driver
+ *	runs the two controller callbacks that sequence a hold, in controller order.
+ *
+ *	The request arrives at a random point of the segment being stepped out. The prep
+ *	queue behind it is full (PREP_QUEUE_DEPTH), so the latency is the rest of that segment
+ *	plus every segment prepared before the first decelerating one - PREP_QUEUE_DEPTH+1,
+ *	or one more if the hold is synced at the end of a move, as long as planning the hold
+ *	takes less than a segment on the AVR. Times are machine times from the segment times,
+ *	except for the planning times, which are this host's.
+ *
+ *	Reported per file, as min / median / 90% / 99% / max over all holds:
+ *	  latency		- request to the first decelerating segment (ms)
+ *	  stop			- distance travelled from the request to standstill (mm)
+ *	  brake/ideal	- distance from the first decelerating segment to standstill over
+ *					  the jerk limited braking length from the segment before it. Below 1
+ *					  where the hold lands in a deceleration that was already under way
+ *	  stop vel		- velocity of the last segment before the hold (mm/min)
+ *	  plan			- mp_plan_hold_callback() time (us, host)
+ *	  plan zoids	- mp_calculate_trapezoid() calls made by mp_plan_hold_callback()
+ *	  resume		- mp_end_hold() time (us, host)
+ *	and the distance between where the job ends and where it ends without holds.
+ *
+ *	make holdbench runs the braid test twice: hold_bench with the bounded hold planning
+ *	and hold_bench_replan with plan_line.c built with PLAN_HOLD_FULL_REPLAN.
+ */
+#include "tinyg.h"
+#include "config.h"
+#include "canonical_machine.h"
+#include "gcode_parser.h"
+#include "plan_arc.h"
+#include "planner.h"
+#include "stepper.h"
+#include "util.h"
+#include "host.h"
+
+#define HOLD_LINE_LEN	256				// longer than any line the board's RX buffer accepts
+#define HOLD_GAP		100				// mean segments between holds
+#define HOLD_MAX		10000			// holds recorded per file
+
+enum holdMetric {
+	HOLD_LATENCY = 0,
+	HOLD_STOP,
+	HOLD_BRAKE,
+	HOLD_STOP_VELOCITY,
+	HOLD_PLAN,
+	HOLD_PLAN_ZOIDS,
+	HOLD_RESUME,
+	HOLD_METRICS
+};
+
+static const char *metric_names[HOLD_METRICS] = {
+	"latency (ms)", "stop (mm)", "brake/ideal", "stop vel (mm/min)",
+	"plan (us)", "plan zoids", "resume (us)"
+};
+
+enum holdState {
+	HOLD_IDLE = 0,						// running, waiting to fire the next hold
+	HOLD_LATENT,						// hold requested, no decelerating segment yet
+	HOLD_BRAKING						// decelerating to the hold
+};
+
+typedef struct holdBench {
+	uint8_t state;
+	uint32_t segments;					// segments run in the file
+	uint32_t fire;						// segment count to fire the next hold at
+	uint32_t gap;						// mean segments between holds
+	uint32_t holds;						// holds recorded
+	double latency;						// of the hold in progress
+	double stop;
+	double brake;
+	double brake_ideal;
+	double segment_time[PREP_QUEUE_DEPTH+1];	// the last segments prepared, newest first
+	double segment_length[PREP_QUEUE_DEPTH+1];
+	double *metric[HOLD_METRICS];		// per hold
+} holdBench_t;
+
+static holdBench_t hb;
+
+static double _rand(void) { return ((double)rand() / ((double)RAND_MAX + 1));}
+
+static void _segment(double segment_time, double segment_length, uint8_t decel);
+
+static uint32_t _zoids(void)
+{
+	uint32_t zoids = 0;
+	for (uint8_t i=0; i<ZOID_CASES; i++) { zoids += mps.zoid[i];}
+	return (zoids);
+}
+
+/*
+ * _controller() - the hold callbacks of the controller loop, timed
+ */
+
+static void _controller(void)
+{
+	uint8_t resuming = (cm.hold_state == FEEDHOLD_HOLD) && (cm.cycle_start_requested == true);
+	double start = host_usec();
+	cm_feedhold_sequencing_callback();
+	if (resuming == true) {
+		hb.metric[HOLD_RESUME][hb.holds-1] = host_usec() - start;
+	}
+	if (cm.hold_state != FEEDHOLD_PLAN) {
+		return;
+	}
+	uint32_t zoids = _zoids();
+	start = host_usec();
+	mp_plan_hold_callback();
+	hb.metric[HOLD_PLAN][hb.holds] = host_usec() - start;
+	hb.metric[HOLD_PLAN_ZOIDS][hb.holds] = _zoids() - zoids;
+}
+
+/*
+ * _step() - one controller pass and one exec pass, and what the segment did to the hold
+ */
+
+static stat_t _step(void)
+{
+	float position[AXES];
+	double time = hr.segment_time;
+	copy_vector(position, mr.position);
+	uint8_t decel = (cm.hold_state == FEEDHOLD_DECEL);
+
+	_controller();
+	decel |= (cm.hold_state == FEEDHOLD_DECEL);		// the hold was planned just now
+	stat_t status = host_exec_move();
+
+	double segment_time = (hr.segment_time - time) * 60;
+	if (segment_time > 0) {							// else not a segment
+		_segment(segment_time, get_axis_vector_length(mr.position, position), decel);
+	}
+	if ((hb.state != HOLD_IDLE) && (cm.hold_state == FEEDHOLD_HOLD)) {
+		hb.metric[HOLD_LATENCY][hb.holds] = hb.latency * 1000;
+		hb.metric[HOLD_STOP][hb.holds] = hb.stop;
+		hb.metric[HOLD_BRAKE][hb.holds] = (hb.brake_ideal > 0) ? hb.brake / hb.brake_ideal : 1;
+		hb.metric[HOLD_STOP_VELOCITY][hb.holds] = hb.segment_length[0] / hb.segment_time[0] * 60;
+		hb.metric[HOLD_RESUME][hb.holds] = 0;
+		hb.holds++;
+		hb.state = HOLD_IDLE;
+		hb.fire = hb.segments + 1 + (uint32_t)(_rand() * 2 * hb.gap);
+		cm_request_cycle_start();					// resumes on the next controller pass
+	}
+	return (status);
+}
+
+/*
+ * _segment() - account a segment to the hold in progress, or fire the next hold
+ */
+
+static void _segment(double segment_time, double segment_length, uint8_t decel)
+{
+	hb.segments++;
+	memmove(&hb.segment_time[1], &hb.segment_time[0], sizeof(double) * PREP_QUEUE_DEPTH);
+	memmove(&hb.segment_length[1], &hb.segment_length[0], sizeof(double) * PREP_QUEUE_DEPTH);
+	hb.segment_time[0] = segment_time;
+	hb.segment_length[0] = segment_length;
+
+	switch (hb.state) {
+		case HOLD_IDLE: {
+			uint8_t queued = PREP_QUEUE_DEPTH;		// this one and those ahead of it
+			if ((hb.segments < hb.fire) || (hb.holds >= HOLD_MAX) || (hb.segment_time[queued] == 0) ||
+				(cm.motion_state != MOTION_RUN) || (cm.hold_state != FEEDHOLD_OFF)) {
+				break;
+			}
+			double rest = 1 - _rand();				// of the segment stepping out
+			hb.latency = rest * hb.segment_time[queued];
+			hb.stop = rest * hb.segment_length[queued];
+			for (uint8_t i=0; i<queued; i++) {
+				hb.latency += hb.segment_time[i];
+				hb.stop += hb.segment_length[i];
+			}
+			hb.brake = 0;
+			hb.brake_ideal = 0;
+			cm_request_feedhold();
+			hb.state = HOLD_LATENT;
+			break;
+		}
+		case HOLD_LATENT: {
+			if (decel == false) {
+				hb.latency += segment_time;
+				hb.stop += segment_length;
+				break;
+			}
+			mpBuf_t *bf = mp_get_run_buffer();
+			double velocity = hb.segment_length[1] / hb.segment_time[1] * 60;
+			hb.brake_ideal = (bf != NULL) ? mp_get_target_length(velocity, 0, bf) : 0;
+			hb.state = HOLD_BRAKING;
+		}	// no break
+		case HOLD_BRAKING: {
+			hb.stop += segment_length;
+			hb.brake += segment_length;
+			break;
+		}
+	}
+}
+
+/*
+ * _exec_until() - run the exec until the planner has N free buffers and less than T queued
+ *
+ *	Same as planner_bench, except that a hold that has stopped the exec is not the end of
+ *	the queue - it is released on the next pass.
+ */
+
+static void _exec_until(uint8_t buffers_available, float queue_time)
+{
+	uint8_t available;
+
+	while ((mp_merge_callback() == STAT_OK) &&
+		   (((available = mp_get_planner_buffers_available()) < buffers_available) ||
+			(mp_get_planner_queue_time() >= queue_time))) {
+		stat_t status = _step();
+		if ((status == STAT_NOOP) && (cm.hold_state == FEEDHOLD_OFF) &&
+			(mp_get_planner_buffers_available() == available)) {
+			break;
+		}
+	}
+}
+
+/*
+ * _run_file() - stream one file, with holds every gap segments on average (0 = none)
+ *
+ *	Returns the line that raised an alarm, 0 if none. The final position is left in end[].
+ */
+
+static uint32_t _run_file(const char *filename, uint32_t gap, float end[])
+{
+	char_t line[HOLD_LINE_LEN];
+	volatile uint32_t lines = 0;
+	FILE *fp;
+
+	if ((fp = fopen(filename, "r")) == NULL) {
+		fprintf(stderr, "%s: cannot open\n", filename);
+		exit(1);
+	}
+	host_init(PLANNER_BUFFER_POOL_SIZE);
+	hb.state = HOLD_IDLE;
+	hb.segments = 0;
+	hb.holds = 0;
+	hb.gap = gap;
+	hb.fire = (gap == 0) ? UINT32_MAX : 1 + (uint32_t)(_rand() * 2 * gap);
+	memset(hb.segment_time, 0, sizeof(hb.segment_time));
+	if (setjmp(hr.shutdown) != 0) {							// hard alarm
+		fclose(fp);
+		return (max(lines, 1));
+	}
+	hr.armed = true;
+
+	while (fgets((char *)line, sizeof(line), fp) != NULL) {
+		lines++;
+		while (cm_arc_callback() == STAT_EAGAIN) {
+			_exec_until(PLANNER_BUFFER_HEADROOM, INFINITY);
+		}
+		_exec_until(PLANNER_BUFFER_HEADROOM, PLANNER_LOOKAHEAD_TIME);
+		mp_merge_callback();
+		gc_gcode_parser(line);
+		if (cm.machine_state == MACHINE_ALARM) {
+			fclose(fp);
+			return (lines);
+		}
+	}
+	while (cm_arc_callback() == STAT_EAGAIN) {
+		_exec_until(PLANNER_BUFFER_HEADROOM, INFINITY);
+	}
+	_exec_until(mb.pool_size, INFINITY);
+	hr.armed = false;
+	memcpy(end, mr.position, sizeof(mr.position));
+	fclose(fp);
+	return (0);
+}
+
+static int _compare(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return ((x > y) - (x < y));
+}
+
+static void _print_metric(const char *name, double *value, uint32_t count)
+{
+	qsort(value, count, sizeof(double), _compare);
+	printf("  %-20s %10.3f %10.3f %10.3f %10.3f %10.3f\n", name, value[0], value[count/2],
+		   value[count*9/10], value[count*99/100], value[count-1]);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t gap = HOLD_GAP;
+	unsigned seed = 1;
+	int first = 1;
+
+	while ((first+1 < argc) && (argv[first][0] == '-')) {
+		if (strcmp(argv[first], "-g") == 0) {
+			gap = max(atoi(argv[first+1]), 1);
+		} else if (strcmp(argv[first], "-s") == 0) {
+			seed = atoi(argv[first+1]);
+		} else {
+			break;
+		}
+		first += 2;
+	}
+	if (first >= argc) {
+		fprintf(stderr, "usage: %s [-g gap] [-s seed] file.gcode [file.gcode ...]\n", argv[0]);
+		return (1);
+	}
+	for (uint8_t i=0; i<HOLD_METRICS; i++) {
+		hb.metric[i] = calloc(HOLD_MAX, sizeof(double));
+	}
+#ifdef PLAN_HOLD_FULL_REPLAN
+	printf("hold planning: full replan (PLAN_HOLD_FULL_REPLAN)\n");
+#else
+	printf("hold planning: bounded\n");
+#endif
+	for (int f = first; f < argc; f++) {
+		const char *name = strrchr(argv[f], '/');
+		name = (name == NULL) ? argv[f] : name+1;
+		float reference[AXES], end[AXES];
+		uint32_t alarm;
+
+		srand(seed);
+		if ((alarm = _run_file(argv[f], 0, reference)) != 0) {
+			printf("%s: alarm at line %lu without holds\n", name, (unsigned long)alarm);
+			continue;
+		}
+		if ((alarm = _run_file(argv[f], gap, end)) != 0) {
+			printf("%s: alarm at line %lu after %lu holds\n", name, (unsigned long)alarm,
+				   (unsigned long)hb.holds);
+			continue;
+		}
+		printf("%s: %lu holds, %lu segments, end position off by %.4f mm\n", name,
+			   (unsigned long)hb.holds, (unsigned long)hb.segments,
+			   get_axis_vector_length(end, reference));
+		if (hb.holds == 0) {
+			continue;
+		}
+		printf("  %-20s %10s %10s %10s %10s %10s\n", "", "min", "median", "90%", "99%", "max");
+		for (uint8_t i=0; i<HOLD_METRICS; i++) {
+			_print_metric(metric_names[i], hb.metric[i], hb.holds);
+		}
+	}
+	return (0);
+}
@@ -0,0 +1,81 @@
+/*
+ * host.h - host-native harness for the planner (Linux build)
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ * The host harness compiles the real planner, canonical machine and Gcode parser
+ * for the build machine and replaces the hardware, xio, stepper and reporting
+ * layers with the stubs in host_stubs.c. The stepper stub does not generate
+ * pulses - it counts the segments handed to it by the exec and sums their times.
+ *
+ * Exec and load are not interrupt driven on the host. The driver calls
+ * host_exec_move() to run one pass of what the exec or loader ISR would do, the
+ * exec running ahead through the prep queue as it does on the board.
+ *
+ * A hard alarm shuts the board down for good. cm_hard_alarm() calls stepper_init()
+ * first, so once the driver arms hr.shutdown the stepper stub longjmp()s back to
+ * the driver instead of letting the alarm run (it can recurse if the queue is full).
+ */
+#ifndef HOST_H_ONCE
+#define HOST_H_ONCE
+
+#include <setjmp.h>
+#include <time.h>
+
+typedef struct hostRuntimeSingleton {	// counters kept by the stubbed lower layers
+	uint32_t segments;					// segments prepped by st_prep_line()
+	uint32_t dwells;					// dwells prepped by st_prep_dwell()
+	uint32_t commands;					// synchronous commands run by the loader
+	uint32_t committed;					// planner buffers committed to the queue
+	uint32_t exceptions;				// exception reports raised
+	stat_t last_exception;				// status code of the most recent exception
+	double segment_time;				// sum of all prepped segment times (minutes)
+	double dwell_time;					// sum of all dwell times (seconds)
+	uint8_t clocked;					// true if the driver runs rtc.sys_ticks (see host_exec_move())
+	uint8_t armed;						// true once hr.shutdown is valid
+	jmp_buf shutdown;					// where a hard alarm returns to
+} hostRuntime_t;
+
+extern THREAD_LOCAL hostRuntime_t hr;
+
+void host_init(uint8_t pool_size);		// apply settings profile and init the planner stack
+stat_t host_exec_move(void);			// one pass of exec ISR or loader ISR
+uint8_t host_load_move(void);			// one pass of loader ISR, false if the prep queue is empty
+
+/*
+ * host_usec() - monotonic timestamp in microseconds
+ * host_cycles() - CPU timestamp counter (nanoseconds where there is no TSC)
+ */
+static inline double host_usec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((double)ts.tv_sec * 1000000.0 + (double)ts.tv_nsec / 1000.0);
+}
+
+static inline uint64_t host_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return (__builtin_ia32_rdtsc());
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+#endif
+}
+
+#endif // End of include guard: HOST_H_ONCE
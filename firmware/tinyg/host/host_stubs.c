@@ -0,0 +1,326 @@
+/*
+ * host_stubs.c - stubbed hardware, xio, stepper and reporting layers for the host harness
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ * Everything below the planner is replaced here. Only the symbols the planner,
+ * canonical machine and Gcode parser actually link against are provided.
+ * The stepper stub keeps the prep buffer handshake of stepper.c so the exec
+ * sees the same ownership rules it does on the board.
+ */
+#include "tinyg.h"
+#include "config.h"
+#include "canonical_machine.h"
+#include "controller.h"
+#include "planner.h"
+#include "stepper.h"
+#include "pwm.h"
+#include "gpio.h"
+#include "report.h"
+#include "text_parser.h"
+#include "hardware.h"
+#include "settings.h"
+#include "util.h"
+#include "xio.h"
+#include "host.h"
+
+/**** Allocations normally made by modules that are not linked ****/
+
+THREAD_LOCAL hostRuntime_t hr;
+THREAD_LOCAL stat_t status_code;						// allocated in main.c on the board
+THREAD_LOCAL char global_string_buf[MESSAGE_LEN];	// allocated in main.c on the board
+THREAD_LOCAL controller_t cs;						// controller.c
+THREAD_LOCAL stConfig_t st_cfg;						// stepper.c
+THREAD_LOCAL stPrepSingleton_t st_pre;				// stepper.c
+THREAD_LOCAL stSimSingleton_t st_sim;				// stepper.c
+THREAD_LOCAL pwmSingleton_t pwm;						// pwm.c
+THREAD_LOCAL rtClock_t rtc;							// xmega_rtc.c
+const cfgItem_t cfgArray[1];			// config_app.c - nothing is looked up by index on the host
+
+/**** Settings profile ****
+ *
+ * The board gets these from the cfgArray defaults on a config reset. The host has
+ * no cfgArray, so the same settings.h values are applied directly.
+ */
+
+#define _set_axis(axis, p) { \
+	cm.a[axis].axis_mode = p##_AXIS_MODE; \
+	cm.a[axis].velocity_max = p##_VELOCITY_MAX; \
+	cm.a[axis].feedrate_max = p##_FEEDRATE_MAX; \
+	cm.a[axis].travel_min = p##_TRAVEL_MIN; \
+	cm.a[axis].travel_max = p##_TRAVEL_MAX; \
+	cm.a[axis].jerk_homing = p##_JERK_HOMING; \
+	cm.a[axis].junction_dev = p##_JUNCTION_DEVIATION; \
+	cm_set_axis_jerk(axis, p##_JERK_MAX); \
+	cm_set_axis_accel(axis, p##_ACCEL_MAX); }
+
+#define _set_motor(m, p) { \
+	st_cfg.mot[m].motor_map = p##_MOTOR_MAP; \
+	st_cfg.mot[m].step_angle = p##_STEP_ANGLE; \
+	st_cfg.mot[m].travel_rev = p##_TRAVEL_PER_REV; \
+	st_cfg.mot[m].microsteps = p##_MICROSTEPS; \
+	st_cfg.mot[m].polarity = p##_POLARITY; \
+	st_cfg.mot[m].steps_per_unit = (360 * st_cfg.mot[m].microsteps) / \
+								   (st_cfg.mot[m].travel_rev * st_cfg.mot[m].step_angle); }
+
+#define _set_offset(c, p) { \
+	cm.offset[c][AXIS_X] = p##_X_OFFSET; cm.offset[c][AXIS_Y] = p##_Y_OFFSET; \
+	cm.offset[c][AXIS_Z] = p##_Z_OFFSET; cm.offset[c][AXIS_A] = p##_A_OFFSET; \
+	cm.offset[c][AXIS_B] = p##_B_OFFSET; cm.offset[c][AXIS_C] = p##_C_OFFSET; }
+
+static void _apply_settings(void)
+{
+	memset(&cm, 0, sizeof(cm));
+	memset(&st_cfg, 0, sizeof(st_cfg));
+
+	cm.junction_acceleration = JUNCTION_ACCELERATION;
+	cm.chordal_tolerance = CHORDAL_TOLERANCE;
+	cm.soft_limit_enable = SOFT_LIMIT_ENABLE;
+	cm.units_mode = GCODE_DEFAULT_UNITS;
+	cm.coord_system = GCODE_DEFAULT_COORD_SYSTEM;
+	cm.select_plane = GCODE_DEFAULT_PLANE;
+	cm.path_control = GCODE_DEFAULT_PATH_CONTROL;
+	cm.distance_mode = GCODE_DEFAULT_DISTANCE_MODE;
+
+	_set_axis(AXIS_X, X);
+	_set_axis(AXIS_Y, Y);
+	_set_axis(AXIS_Z, Z);
+	_set_axis(AXIS_A, A);
+	_set_axis(AXIS_B, B);
+	_set_axis(AXIS_C, C);
+	cm.a[AXIS_A].radius = A_RADIUS;
+	cm.a[AXIS_B].radius = B_RADIUS;
+	cm.a[AXIS_C].radius = C_RADIUS;
+	for (uint8_t axis = MOTION_AXES; axis < AXES; axis++) {
+		cm.a[axis].axis_mode = AXIS_DISABLED;		// the only mode cm_set_am() takes for them
+	}
+
+	_set_motor(MOTOR_1, M1);
+#if (MOTORS >= 2)
+	_set_motor(MOTOR_2, M2);
+#endif
+#if (MOTORS >= 3)
+	_set_motor(MOTOR_3, M3);
+#endif
+#if (MOTORS >= 4)
+	_set_motor(MOTOR_4, M4);
+#endif
+	_set_offset(G54, G54);
+	_set_offset(G55, G55);
+	_set_offset(G56, G56);
+	_set_offset(G57, G57);
+	_set_offset(G58, G58);
+	_set_offset(G59, G59);
+}
+
+/*
+ * host_init() - bring up the planner stack in the same order as _application_init()
+ */
+
+void host_init(uint8_t pool_size)
+{
+	memset(&hr, 0, sizeof(hr));
+	memset(&rtc, 0, sizeof(rtc));
+	_apply_settings();
+	stepper_init();
+	planner_init(pool_size);
+	canonical_machine_init();
+}
+
+/*
+ * _prep_queue_is_free() - same test as the exec ISR's in stepper.c
+ * _commit_prep_segment() - hand the entry to the loader, as stepper.c does
+ */
+
+static uint8_t _prep_queue_is_free()
+{
+	uint8_t queued = st_pre.prep_index - st_pre.load_index;
+
+	if ((st_pre.command_queued == true) && (queued != 0)) {
+		return (false);
+	}
+	return (queued < PREP_QUEUE_DEPTH);
+}
+
+static void _commit_prep_segment(stSegment_t *seg, uint8_t move_type)
+{
+	seg->move_type = move_type;
+	seg->sync_func = st_pre.sync_func;
+	seg->sync_value = st_pre.sync_value;
+	st_pre.sync_func = NULL;
+	st_pre.command_queued = (move_type == MOVE_TYPE_COMMAND);
+	st_pre.prep_index++;
+}
+
+/*
+ * host_exec_move() - one pass of the exec ISR, or of the loader ISR once the exec can't run
+ *
+ *	The exec runs ahead of the loader as it does on the board: while there is room in the
+ *	prep queue a pass only preps. Once the queue is full, waits behind a command, or the
+ *	exec has nothing to run, the oldest entry is loaded instead.
+ *
+ *	Returns STAT_NOOP if there was nothing to run or load, otherwise the exec status
+ *	(STAT_OK for a pass that only loaded).
+ *
+ *	A driver that calls this has nothing more to send for now, so if the exec holds an
+ *	idle start to prime the queue - with nothing left to load - the SysTick is run on
+ *	until it lets go, unless the driver keeps the clock itself (hr.clocked).
+ */
+
+stat_t host_exec_move()
+{
+	stat_t status = STAT_NOOP;
+
+	if (_prep_queue_is_free() == true) {
+		while (((status = mp_exec_move()) == STAT_NOOP) && (mb.priming == true) &&
+			   (hr.clocked == false) && (st_pre.load_index == st_pre.prep_index)) {
+			rtc.sys_ticks++;
+		}
+		if ((status != STAT_NOOP) && (_prep_queue_is_free() == true)) {
+			return (status);							// prep the next one first
+		}
+	}
+	if ((host_load_move() == true) && (status == STAT_NOOP)) {
+		return (STAT_OK);
+	}
+	return (status);
+}
+
+/*
+ * host_load_move() - one pass of the loader ISR: take the oldest entry of the prep queue
+ *
+ *	Synchronous commands are run exactly as _load_move() does. Returns false if the
+ *	queue was empty.
+ */
+
+uint8_t host_load_move()
+{
+	if (st_pre.load_index == st_pre.prep_index) {
+		return (false);
+	}
+	stSegment_t *seg = &st_pre.seg[st_pre.load_index & PREP_QUEUE_MASK];
+
+	if (seg->move_type == MOVE_TYPE_COMMAND) {
+		hr.commands++;
+		mp_runtime_command(seg->bf);
+	}
+	if (seg->sync_func != NULL) {
+		hr.commands++;
+		seg->sync_func(&seg->sync_value, &seg->sync_value);
+	}
+	st_pre.load_index++;
+	return (true);
+}
+
+/**** Stepper stubs ****/
+
+void stepper_init()
+{
+	if (hr.armed == true) {					// called from cm_hard_alarm()
+		hr.armed = false;
+		longjmp(hr.shutdown, 1);
+	}
+	memset(&st_pre, 0, sizeof(st_pre));			// empty prep queue
+	stepper_init_assertions();
+}
+
+void stepper_init_assertions()
+{
+	st_pre.magic_end = MAGICNUM;
+	st_pre.magic_start = MAGICNUM;
+}
+
+uint8_t st_runtime_isbusy() { return (false); }
+void st_request_exec_move() {}			// the driver pulls segments with host_exec_move()
+
+stat_t st_prep_line(float travel_steps[], float following_error[], float segment_time)
+{
+	if (_prep_queue_is_free() != true) {
+		return (cm_hard_alarm(STAT_INTERNAL_ERROR));
+	} else if (isinf(segment_time)) { return (cm_hard_alarm(STAT_PREP_LINE_MOVE_TIME_IS_INFINITE));
+	} else if (isnan(segment_time)) { return (cm_hard_alarm(STAT_PREP_LINE_MOVE_TIME_IS_NAN));
+	} else if (segment_time < EPSILON) { return (STAT_MINIMUM_TIME_MOVE);
+	}
+	_commit_prep_segment(&st_pre.seg[st_pre.prep_index & PREP_QUEUE_MASK], MOVE_TYPE_ALINE);
+	hr.segments++;
+	hr.segment_time += segment_time;
+	return (STAT_OK);
+}
+
+void st_prep_null() {}
+
+void st_prep_command(void *bf)
+{
+	stSegment_t *seg = &st_pre.seg[st_pre.prep_index & PREP_QUEUE_MASK];
+
+	seg->bf = (mpBuf_t *)bf;
+	_commit_prep_segment(seg, MOVE_TYPE_COMMAND);
+}
+
+void st_prep_dwell(float microseconds)
+{
+	_commit_prep_segment(&st_pre.seg[st_pre.prep_index & PREP_QUEUE_MASK], MOVE_TYPE_DWELL);
+	hr.dwells++;
+	hr.dwell_time += microseconds / 1000000;
+}
+
+/**** Reporting stubs ****/
+
+stat_t rpt_exception(uint8_t status)
+{
+	hr.exceptions++;
+	hr.last_exception = status;
+	return (STAT_OK);
+}
+
+void qr_init_queue_report() {}
+void qr_request_queue_report(int8_t buffers) { if (buffers > 0) hr.committed++; }
+void rx_request_rx_report() {}
+stat_t sr_request_status_report(uint8_t request_type) { return (STAT_OK); }
+
+void text_print_str(nvObj_t *nv, const char *format) {}
+void text_print_ui8(nvObj_t *nv, const char *format) {}
+void text_print_int(nvObj_t *nv, const char *format) {}
+void text_print_flt(nvObj_t *nv, const char *format) {}
+void text_print_flt_units(nvObj_t *nv, const char *format, const char *units) {}
+
+/**** Config stubs ****/
+
+index_t nv_get_index(const char_t *group, const char_t *token) { return (NO_MATCH); }
+stat_t nv_persist(nvObj_t *nv) { return (STAT_OK); }
+stat_t nv_copy_string(nvObj_t *nv, const char_t *src) { return (STAT_OK); }
+nvObj_t *nv_add_object(const char_t *token) { return (NULL); }
+nvObj_t *nv_add_string(const char_t *token, const char_t *string) { return (NULL); }
+stat_t set_ui8(nvObj_t *nv) { return (STAT_OK); }
+stat_t set_flt(nvObj_t *nv) { return (STAT_OK); }
+stat_t set_flu(nvObj_t *nv) { return (STAT_OK); }
+stat_t get_ui8(nvObj_t *nv) { return (STAT_OK); }
+
+/**** Hardware, IO and cycle stubs ****/
+
+void gpio_set_bit_on(uint8_t b) {}
+void gpio_set_bit_off(uint8_t b) {}
+stat_t pwm_set_freq(uint8_t channel, float freq) { return (STAT_OK); }
+stat_t pwm_set_duty(uint8_t channel, float duty) { return (STAT_OK); }
+uint8_t xio_isbusy() { return (false); }
+void xio_reset_usb_rx_buffers() {}
+uint16_t hw_get_plan_timer() { return ((uint16_t)(host_usec() / PLAN_TIMER_USEC)); }
+
+stat_t cm_homing_cycle_start() { return (STAT_OK); }
+stat_t cm_homing_cycle_start_no_set() { return (STAT_OK); }
+stat_t cm_jogging_cycle_start(uint8_t axis) { return (STAT_OK); }
+stat_t cm_straight_probe(float target[], float flags[]) { return (STAT_OK); }
@@ -0,0 +1,14 @@
+/*
+ * interrupt.h - host shim for <avr/interrupt.h>
+ * This file is part of the TinyG host benchmark harness
+ */
+#ifndef HOST_AVR_INTERRUPT_H_ONCE
+#define HOST_AVR_INTERRUPT_H_ONCE
+
+#include "io.h"
+
+#define sei()
+#define cli()
+#define ISR(vector) void vector(void)
+
+#endif // End of include guard: HOST_AVR_INTERRUPT_H_ONCE
@@ -0,0 +1,23 @@
+/*
+ * io.h - host shim for <avr/io.h>
+ * This file is part of the TinyG host benchmark harness
+ *
+ * Provides just enough of the xmega register types for the firmware headers
+ * to compile. Nothing here touches real hardware - the peripherals the
+ * planner would drive are replaced by the stubs in host_stubs.c
+ */
+#ifndef HOST_AVR_IO_H_ONCE
+#define HOST_AVR_IO_H_ONCE
+
+#include <stdint.h>
+
+typedef volatile uint8_t register8_t;
+typedef volatile uint16_t register16_t;
+
+typedef struct PORT_struct { register8_t DIR, DIRSET, DIRCLR, OUT, OUTSET, OUTCLR, IN, INTCTRL; } PORT_t;
+typedef struct USART_struct { register8_t DATA, STATUS, CTRLA, CTRLB, CTRLC, BAUDCTRLA, BAUDCTRLB; } USART_t;
+typedef struct SPI_struct { register8_t CTRL, INTCTRL, STATUS, DATA; } SPI_t;
+typedef struct TC0_struct { register8_t CTRLA, CTRLB, INTCTRLA, INTFLAGS; register16_t CNT, PER, CCA; } TC0_t;
+typedef struct TC1_struct { register8_t CTRLA, CTRLB, INTCTRLA, INTFLAGS; register16_t CNT, PER, CCA; } TC1_t;
+
+#endif // End of include guard: HOST_AVR_IO_H_ONCE
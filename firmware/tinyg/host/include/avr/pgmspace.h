@@ -0,0 +1,36 @@
+/*
+ * pgmspace.h - host shim for <avr/pgmspace.h>
+ * This file is part of the TinyG host benchmark harness
+ *
+ * On the host program memory and RAM are the same address space, so PROGMEM
+ * is dropped and the pgm_read_xxx() accessors become plain dereferences. The
+ * accessors are type-generic so pointer tables (e.g. msg strings) read back
+ * at full host pointer width.
+ */
+#ifndef HOST_AVR_PGMSPACE_H_ONCE
+#define HOST_AVR_PGMSPACE_H_ONCE
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) ((const char *)(s))
+
+#define pgm_read_byte(a)  (*(a))
+#define pgm_read_word(a)  (*(a))
+#define pgm_read_dword(a) (*(a))
+#define pgm_read_float(a) (*(a))
+
+#define strcpy_P	strcpy
+#define strncpy_P	strncpy
+#define strcmp_P	strcmp
+#define strncmp_P	strncmp
+#define strlen_P	strlen
+#define memcpy_P	memcpy
+#define printf_P	printf
+#define fprintf_P	fprintf
+#define sprintf_P	sprintf
+
+#endif // End of include guard: HOST_AVR_PGMSPACE_H_ONCE
@@ -0,0 +1,255 @@
+/*
+ * job_estimate.c - predicted run time of Gcode files, from the firmware planner
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ * Usage: job_estimate [-j jobs] [-p pool] file.gcode [file.gcode ...]
+ *
+ *	Predicts how long each file runs on the machine, per file and per tool. Each file
+ *	goes through gc_gcode_parser(), the planner and mp_exec_move() exactly as planner_bench
+ *	streams it - a line is parsed once _sync_to_planner() would pass - and the estimate is
+ *	the sum of the segment and dwell times the exec prepares. No steps are generated.
+ *
+ *	The machine is the settings profile the tool is built with (make PROFILE=shapeoko2
+ *	uses settings/settings_shapeoko2.h). Files are handed out to -j worker threads from a
+ *	shared queue, default one per core. Every thread runs its own planner (see
+ *	THREAD_LOCAL in tinyg.h), so the results do not depend on -j.
+ *
+ *	Time is charged to the tool in the spindle when the segment runs - the tool an M6
+ *	last put there, T0 before the first. The split is printed for files that use more
+ *	than one. Results are printed in argument order once all
+ *	files are done. A file that raises an alarm is reported up to the line that did.
+ */
+#include "tinyg.h"
+#include "config.h"
+#include "canonical_machine.h"
+#include "gcode_parser.h"
+#include "plan_arc.h"
+#include "planner.h"
+#include "util.h"
+#include "host.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define JOB_LINE_LEN	256				// longer than any line the board's RX buffer accepts
+#define JOB_TOOLS		256				// tool numbers are uint8_t
+
+typedef struct jobResult {				// what one file came to
+	const char *filename;
+	uint32_t lines;						// Gcode lines read
+	uint32_t errors;					// lines the parser returned an error for
+	uint32_t alarm_line;				// line that raised an alarm (0 = none)
+	uint8_t opened;						// false if the file could not be read
+	double time;						// predicted run time (seconds)
+	double tool_time[JOB_TOOLS];		// the same per tool in the spindle
+} jobResult_t;
+
+typedef struct jobQueue {				// files waiting for a worker
+	pthread_mutex_t lock;
+	jobResult_t *job;
+	int count;
+	int next;
+} jobQueue_t;
+
+static jobQueue_t jq = { PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0 };
+static uint8_t pool_size = PLANNER_BUFFER_POOL_SIZE;
+
+static THREAD_LOCAL jobResult_t *job;	// file the calling thread is running
+static THREAD_LOCAL double job_charged;	// run time already charged to a tool
+
+/*
+ * _charge_tool() - charge the run time prepared since the last call to the current tool
+ */
+
+static void _charge_tool(void)
+{
+	double now = hr.segment_time * 60 + hr.dwell_time;
+	job->tool_time[cm.gm.tool] += now - job_charged;
+	job_charged = now;
+}
+
+/*
+ * _exec_until() - run the exec until the planner has N free buffers and less than T queued
+ *
+ *	Same as planner_bench: pass mb.pool_size to drain the queue. A NOOP that freed a
+ *	buffer (zero length move) is not the end of the queue.
+ */
+
+static void _exec_until(uint8_t buffers_available, float queue_time)
+{
+	uint8_t available;
+
+	while ((mp_merge_callback() == STAT_OK) &&
+		   (((available = mp_get_planner_buffers_available()) < buffers_available) ||
+			(mp_get_planner_queue_time() >= queue_time))) {
+		stat_t status = host_exec_move();
+		_charge_tool();
+		if ((status == STAT_NOOP) && (mp_get_planner_buffers_available() == available)) {
+			break;
+		}
+	}
+}
+
+/*
+ * _run_job() - stream one file through the parser, planner and exec
+ */
+
+static void _run_job(jobResult_t *jr)
+{
+	char_t line[JOB_LINE_LEN];
+	FILE *fp;
+
+	job = jr;
+	job_charged = 0;
+	if ((fp = fopen(jr->filename, "r")) == NULL) {
+		return;
+	}
+	jr->opened = true;
+	host_init(pool_size);
+	if (setjmp(hr.shutdown) != 0) {						// hard alarm
+		jr->alarm_line = max(jr->lines, 1);
+		jr->time = job_charged;
+		fclose(fp);
+		return;
+	}
+	hr.armed = true;
+
+	while (fgets((char *)line, sizeof(line), fp) != NULL) {
+		jr->lines++;
+		while (cm_arc_callback() == STAT_EAGAIN) {
+			_exec_until(PLANNER_BUFFER_HEADROOM, INFINITY);
+		}
+		_exec_until(PLANNER_BUFFER_HEADROOM, PLANNER_LOOKAHEAD_TIME);
+		mp_merge_callback();
+
+		stat_t status = gc_gcode_parser(line);
+		if ((status != STAT_OK) && (status != STAT_NOOP) && (status != STAT_MINIMUM_TIME_MOVE)) {
+			jr->errors++;
+		}
+		if (cm.machine_state == MACHINE_ALARM) {
+			jr->alarm_line = jr->lines;
+			break;
+		}
+	}
+	while (cm_arc_callback() == STAT_EAGAIN) {
+		_exec_until(PLANNER_BUFFER_HEADROOM, INFINITY);
+	}
+	_exec_until(mb.pool_size, INFINITY);
+	hr.armed = false;
+	jr->time = job_charged;
+	fclose(fp);
+}
+
+/*
+ * _worker() - take files off the queue until it is empty
+ */
+
+static void *_worker(void *arg)
+{
+	for (;;) {
+		pthread_mutex_lock(&jq.lock);
+		int index = jq.next++;
+		pthread_mutex_unlock(&jq.lock);
+		if (index >= jq.count) { return (NULL); }
+		_run_job(&jq.job[index]);
+	}
+}
+
+static void _print_time(const char *label, double seconds)
+{
+	unsigned long s = (unsigned long)(seconds + 0.5);
+	printf("%-36s %12.1f %4lu:%02lu:%02lu\n", label, seconds, s / 3600, (s / 60) % 60, s % 60);
+}
+
+static void _print_job(const jobResult_t *jr)
+{
+	const char *name = strrchr(jr->filename, '/');
+	name = (name == NULL) ? jr->filename : name+1;
+
+	if (jr->opened == false) {
+		printf("%-36s %12s\n", name, "unreadable");
+		return;
+	}
+	_print_time(name, jr->time);
+	int tools = 0;
+	for (int tool = 0; tool < JOB_TOOLS; tool++) {
+		if (jr->tool_time[tool] > 0) { tools++; }
+	}
+	for (int tool = 0; (tool < JOB_TOOLS) && (tools > 1); tool++) {
+		if (jr->tool_time[tool] > 0) {
+			char label[16];
+			sprintf(label, "  T%d", tool);
+			_print_time(label, jr->tool_time[tool]);
+		}
+	}
+	if (jr->errors != 0) {
+		printf("  %lu lines returned errors\n", (unsigned long)jr->errors);
+	}
+	if (jr->alarm_line != 0) {
+		printf("  alarm at line %lu - estimate stops there\n", (unsigned long)jr->alarm_line);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	int first = 1;
+
+	while ((first+1 < argc) && (argv[first][0] == '-')) {
+		if (strcmp(argv[first], "-j") == 0) {
+			jobs = atoi(argv[first+1]);
+		} else if (strcmp(argv[first], "-p") == 0) {
+			pool_size = min(max(atoi(argv[first+1]), 1), 255);
+		} else {
+			break;
+		}
+		first += 2;
+	}
+	if (first >= argc) {
+		fprintf(stderr, "usage: %s [-j jobs] [-p pool] file.gcode [file.gcode ...]\n", argv[0]);
+		return (1);
+	}
+	jq.count = argc - first;
+	jq.job = calloc(jq.count, sizeof(jobResult_t));
+	for (int i = 0; i < jq.count; i++) {
+		jq.job[i].filename = argv[first+i];
+	}
+	jobs = min(max(jobs, 1), jq.count);
+
+	double start = host_usec();
+	pthread_t *worker = calloc(jobs, sizeof(pthread_t));
+	for (int i = 0; i < jobs; i++) {
+		pthread_create(&worker[i], NULL, _worker, NULL);
+	}
+	for (int i = 0; i < jobs; i++) {
+		pthread_join(worker[i], NULL);
+	}
+	double elapsed = host_usec() - start;
+
+	double total = 0;
+	printf("%-36s %12s %12s\n", "file", "seconds", "h:mm:ss");
+	for (int i = 0; i < jq.count; i++) {
+		_print_job(&jq.job[i]);
+		total += jq.job[i].time;
+	}
+	_print_time("total", total);
+	fprintf(stderr, "%d files on %d threads in %.2f s\n", jq.count, jobs, elapsed / 1000000);
+	free(worker);
+	free(jq.job);
+	return (0);
+}
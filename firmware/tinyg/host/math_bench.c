@@ -0,0 +1,142 @@
+/*
+ * math_bench.c - accuracy and throughput of the plan_math.c kernels against libm
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ * Usage: math_bench [stride]
+ *
+ *	Accuracy: every stride'th float in each planner range is run through the kernel
+ *	and through float libm, and both are compared to a double precision reference.
+ *	Errors are reported in ulps of the float result. The default stride of 1 is
+ *	exhaustive.
+ *
+ *	Throughput: the same argument array is run through the kernel, float libm and
+ *	double libm (what the firmware source calls - double is float on the xmega).
+ *
+ *	Ranges are the arguments the planner produces with sane settings:
+ *	  x^(2/3)	block length L, mm								1e-5 .. 1e4
+ *	  cbrt		block jerk Jm, mm/min^3 (scaled by the unit vector)	1e5 .. 1e13
+ *	  sqrt		lengths squared, dV/Jm, junction radius * accel		1e-12 .. 1e12
+ *	  rsqrt		block length squared, mm^2							1e-10 .. 1e8
+ */
+#include "tinyg.h"
+#include "plan_math.h"
+#include "host.h"
+
+#define BENCH_CALLS 4000000
+#define BENCH_ARGS	4096
+
+typedef struct mathTest {
+	const char *name;
+	float lo;
+	float hi;
+	float (*kernel)(float);
+	float (*libm_f)(float);
+	double (*libm_d)(double);
+	double (*ref)(double);
+} mathTest_t;
+
+static float _powf23(float x) { return (powf(x, 2.0f/3.0f));}
+static float _rsqrtf(float x) { return (1/sqrtf(x));}
+static double _pow23(double x) { return (pow(x, 0.66666666));}
+static double _rsqrt(double x) { return (1/sqrt(x));}
+static double _ref_pow23(double x) { return (cbrt(x*x));}
+static float _mp_sqrt(float x) { return (mp_sqrt(x));}
+
+static const mathTest_t tests[] = {
+	{ "x^(2/3)", 1e-5,  1e4,  mp_pow23, _powf23, _pow23, _ref_pow23 },
+	{ "cbrt",    1e5,   1e13, mp_cbrt,  cbrtf,   cbrt,   cbrt },
+	{ "sqrt",    1e-12, 1e12, _mp_sqrt, sqrtf,   sqrt,   sqrt },
+	{ "rsqrt",   1e-10, 1e8,  mp_rsqrt, _rsqrtf, _rsqrt, _rsqrt },
+};
+
+static double _ulps(float got, double ref)
+{
+	float r = (float)ref;
+	float ulp = nextafterf(r, INFINITY) - r;
+	return (fabs((double)got - ref) / ulp);
+}
+
+static void _accuracy(const mathTest_t *t, uint32_t stride)
+{
+	union { float f; uint32_t u; } lo = { t->lo }, hi = { t->hi }, x;
+	double k_max = 0, k_sum = 0, l_max = 0, k_rel = 0;
+	uint32_t n = 0;
+
+	for (x.u = lo.u; x.u <= hi.u; x.u += stride, n++) {
+		double ref = t->ref(x.f);
+		double k = _ulps(t->kernel(x.f), ref);
+		double l = _ulps(t->libm_f(x.f), ref);
+		k_sum += k;
+		if (k > k_max) k_max = k;
+		if (l > l_max) l_max = l;
+		double rel = fabs(t->kernel(x.f) - ref) / ref;
+		if (rel > k_rel) k_rel = rel;
+	}
+	printf("%-8s %8.0e %8.0e %10lu %9.2f %9.3f %10.2e %9.2f", t->name, t->lo, t->hi,
+		   (unsigned long)n, k_max, k_sum / n, k_rel, l_max);
+}
+
+static double _time_f(float (*f)(float), const float *args)
+{
+	volatile float sink = 0;
+	uint64_t start = host_cycles();
+	for (uint32_t i = 0; i < BENCH_CALLS; i++) {
+		sink += f(args[i & (BENCH_ARGS-1)]);
+	}
+	return ((double)(host_cycles() - start) / BENCH_CALLS);
+}
+
+static double _time_d(double (*f)(double), const float *args)
+{
+	volatile float sink = 0;
+	uint64_t start = host_cycles();
+	for (uint32_t i = 0; i < BENCH_CALLS; i++) {
+		sink += f(args[i & (BENCH_ARGS-1)]);
+	}
+	return ((double)(host_cycles() - start) / BENCH_CALLS);
+}
+
+static void _throughput(const mathTest_t *t)
+{
+	float args[BENCH_ARGS];
+	double span = log(t->hi / t->lo);
+
+	srand(1);
+	for (int i = 0; i < BENCH_ARGS; i++) {		// log-uniform over the range
+		args[i] = t->lo * exp(span * rand() / RAND_MAX);
+	}
+	double k = _time_f(t->kernel, args);
+	double lf = _time_f(t->libm_f, args);
+	double ld = _time_d(t->libm_d, args);
+	printf(" %8.1f %8.1f %8.1f\n", k, lf, ld);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t stride = (argc > 1) ? atoi(argv[1]) : 1;
+
+	if (stride == 0) stride = 1;
+
+	printf("%-8s %8s %8s %10s %9s %9s %10s %9s %8s %8s %8s\n", "kernel", "from", "to", "samples",
+		   "max ulp", "mean ulp", "max rel", "libmf ulp", "cyc", "libmf", "libm");
+	for (uint8_t i = 0; i < sizeof(tests)/sizeof(tests[0]); i++) {
+		_accuracy(&tests[i], stride);
+		_throughput(&tests[i]);
+	}
+	return (0);
+}
@@ -0,0 +1,366 @@
+/*
+ * plan_trace.c - record a planner trace of a Gcode file, or replay one and diff the blocks
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ * Usage: plan_trace [-p pool] -o file.trc file.gcode	- record
+ *		  plan_trace [-v] file.trc [file.trc ...]		- replay and diff
+ *
+ *	Built with the firmware compiled with __PLANNER_TRACE (see planner.h for the record
+ *	format). Recording streams the file through the parser, planner and exec the way
+ *	planner_bench does and writes every planner input and every block the exec takes.
+ *	The header carries the settings the planner reads from cm, so a trace replays the
+ *	same whatever profile the replaying tool was built for.
+ *
+ *	Replay feeds the inputs straight to mp_aline(), mp_dwell(), mp_queue_command() and
+ *	mp_queue_sync_command() - no parser, arcs are already lines - and runs the exec up
+ *	to each recorded BLOCK and FREE, so every line is planned against the same queue it
+ *	was planned against when recorded. Each block the exec takes is compared bit for bit with the recorded
+ *	one. The workflow for a planner change is: record traces with the tree before it
+ *	(make trace), make the change, then make replay.
+ *
+ *	Replay prints, per trace, blocks compared, how many differ, the largest relative
+ *	difference in a velocity and in a section length, and the line of the first block
+ *	that differs (-v prints every one, recorded over replayed). Exit status is 1 if any block differs.
+ */
+#include "tinyg.h"
+#include "config.h"
+#include "canonical_machine.h"
+#include "gcode_parser.h"
+#include "plan_arc.h"
+#include "planner.h"
+#include "util.h"
+#include "host.h"
+
+#define TRACE_LINE_LEN	256				// longer than any line the board's RX buffer accepts
+
+typedef struct traceReplay {			// replay state kept by the trace sink
+	uint8_t replaying;					// false = recording to fp
+	FILE *fp;
+	uint32_t blocks;					// BLOCK records the exec produced
+	uint32_t frees;						// FREE records the exec produced
+	mpTraceBlock_t block;				// the last of them
+} traceReplay_t;
+
+typedef struct traceDiff {
+	uint32_t blocks;					// blocks compared
+	uint32_t differ;					// blocks not bit for bit identical
+	uint32_t missing;					// recorded blocks the replay never ran
+	uint32_t first_block;				// first block that differs (from 1)
+	uint32_t first_line;				// and its Gcode line number (N word)
+	double velocity;					// largest relative velocity difference
+	double length;						// largest relative length difference
+} traceDiff_t;
+
+static traceReplay_t tr;
+static traceDiff_t td;					// of the trace being replayed
+static uint8_t verbose = false;
+static uint8_t pool_size = PLANNER_BUFFER_POOL_SIZE;
+
+static const uint8_t record_size[TRACE_TYPES] = {
+	0,
+	sizeof(mpTraceHeader_t),
+	sizeof(mpTraceLine_t),
+	sizeof(float),						// DWELL
+	0,									// COMMAND
+	0,									// RELEASE
+	sizeof(mpTraceBlock_t),
+	0,									// FREE
+	0									// SYNC
+};
+
+/*
+ * mp_trace_write() - the trace sink: write the record, or note what the exec ran on replay
+ */
+
+void mp_trace_write(uint8_t type, const void *record, uint8_t size)
+{
+	if (tr.replaying == false) {
+		if (tr.fp == NULL) { return; }					// host_init() - replay runs it too
+		fputc(type, tr.fp);
+		fwrite(record, size, 1, tr.fp);
+	} else if (type == TRACE_BLOCK) {
+		memcpy(&tr.block, record, sizeof(mpTraceBlock_t));
+		tr.blocks++;
+	} else if (type == TRACE_FREE) {
+		tr.frees++;
+	}
+}
+
+/**** Recording ****/
+
+static void _exec_until(uint8_t buffers_available, float queue_time)
+{
+	uint8_t available;
+
+	while ((mp_merge_callback() == STAT_OK) &&
+		   (((available = mp_get_planner_buffers_available()) < buffers_available) ||
+			(mp_get_planner_queue_time() >= queue_time))) {
+		if ((host_exec_move() == STAT_NOOP) && (mp_get_planner_buffers_available() == available)) {
+			break;
+		}
+	}
+}
+
+static int _record(const char *gcode, const char *trace)
+{
+	char_t line[TRACE_LINE_LEN];
+	volatile uint32_t lines = 0;		// read after a longjmp()
+	FILE *fp, *out;
+
+	if ((fp = fopen(gcode, "r")) == NULL) {
+		fprintf(stderr, "%s: cannot read\n", gcode);
+		return (1);
+	}
+	if ((out = fopen(trace, "wb")) == NULL) {
+		fprintf(stderr, "%s: cannot write\n", trace);
+		return (1);
+	}
+	host_init(pool_size);
+	tr.fp = out;
+	mp_trace_header();
+	if (setjmp(hr.shutdown) != 0) {							// hard alarm
+		fprintf(stderr, "%s: alarm at line %lu - trace stops there\n", gcode, (unsigned long)lines);
+		fclose(fp);
+		fclose(tr.fp);
+		return (1);
+	}
+	hr.armed = true;
+
+	while (fgets((char *)line, sizeof(line), fp) != NULL) {
+		lines++;
+		while (cm_arc_callback() == STAT_EAGAIN) {
+			_exec_until(PLANNER_BUFFER_HEADROOM, INFINITY);
+		}
+		_exec_until(PLANNER_BUFFER_HEADROOM, PLANNER_LOOKAHEAD_TIME);
+		mp_merge_callback();
+		gc_gcode_parser(line);
+		if (cm.machine_state == MACHINE_ALARM) {
+			fprintf(stderr, "%s: alarm at line %lu - trace stops there\n", gcode, (unsigned long)lines);
+			break;
+		}
+	}
+	while (cm_arc_callback() == STAT_EAGAIN) {
+		_exec_until(PLANNER_BUFFER_HEADROOM, INFINITY);
+	}
+	_exec_until(mb.pool_size, INFINITY);
+	hr.armed = false;
+	fclose(fp);
+	fclose(tr.fp);
+	return (0);
+}
+
+/**** Replay ****/
+
+static void _replay_command(float *value, float *flag) {}
+
+/*
+ * _run_exec_to() - run the exec until it has produced count records of a kind
+ *
+ *	Returns false if the queue runs out first - the replay planned fewer blocks.
+ */
+
+static uint8_t _run_exec_to(const uint32_t *produced, uint32_t count)
+{
+	while (*produced < count) {
+		uint32_t frees = tr.frees;
+		if ((host_exec_move() == STAT_NOOP) && (tr.frees == frees) &&
+			(mp_get_planner_buffers_available() == mb.pool_size)) {
+			return (false);
+		}
+	}
+	return (true);
+}
+
+static double _rel_diff(float a, float b)
+{
+	double scale = max(fabs(a), fabs(b));
+	return ((scale > 0) ? fabs((double)a - b) / scale : 0);
+}
+
+static void _compare(const mpTraceBlock_t *rec)
+{
+	const mpTraceBlock_t *run = &tr.block;
+
+	td.blocks++;
+	if (memcmp(rec, run, sizeof(mpTraceBlock_t)) == 0) {
+		return;
+	}
+	if (td.differ++ == 0) {
+		td.first_block = td.blocks;
+		td.first_line = rec->linenum;
+	}
+	td.velocity = max(td.velocity, _rel_diff(rec->entry_velocity, run->entry_velocity));
+	td.velocity = max(td.velocity, _rel_diff(rec->cruise_velocity, run->cruise_velocity));
+	td.velocity = max(td.velocity, _rel_diff(rec->exit_velocity, run->exit_velocity));
+	td.length = max(td.length, _rel_diff(rec->length, run->length));
+	td.length = max(td.length, _rel_diff(rec->head_length, run->head_length));
+	td.length = max(td.length, _rel_diff(rec->body_length, run->body_length));
+	td.length = max(td.length, _rel_diff(rec->tail_length, run->tail_length));
+	if (verbose == true) {
+		printf("  block %lu N%lu: recorded %.9g/%.9g/%.9g mm/min %.9g/%.9g/%.9g mm\n"
+			   "    replayed %.9g/%.9g/%.9g mm/min %.9g/%.9g/%.9g mm\n",
+			   (unsigned long)td.blocks, (unsigned long)rec->linenum,
+			   rec->entry_velocity, rec->cruise_velocity, rec->exit_velocity,
+			   rec->head_length, rec->body_length, rec->tail_length,
+			   run->entry_velocity, run->cruise_velocity, run->exit_velocity,
+			   run->head_length, run->body_length, run->tail_length);
+	}
+}
+
+static void _apply_header(const mpTraceHeader_t *th)
+{
+	cm.junction_acceleration = th->junction_acceleration;
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		cm.a[axis].feedrate_max = th->a[axis].feedrate_max;
+		cm.a[axis].velocity_max = th->a[axis].velocity_max;
+		cm.a[axis].jerk_max = th->a[axis].jerk_max;
+		cm.a[axis].recip_jerk = th->a[axis].recip_jerk;
+		cm.a[axis].recip_accel = th->a[axis].recip_accel;
+		cm.a[axis].junction_dev = th->a[axis].junction_dev;
+	}
+}
+
+static int _replay(const char *trace)
+{
+	union {
+		mpTraceHeader_t header;
+		mpTraceLine_t line;
+		mpTraceBlock_t block;
+		float value;
+	} rec;
+	uint32_t blocks = 0, frees = 0;
+	float zero[AXES] = {0,0,0,0,0,0};
+	int type;
+
+	memset(&td, 0, sizeof(td));
+	if ((tr.fp = fopen(trace, "rb")) == NULL) {
+		fprintf(stderr, "%s: cannot read\n", trace);
+		return (1);
+	}
+	if ((fgetc(tr.fp) != TRACE_HEADER) || (fread(&rec.header, sizeof(rec.header), 1, tr.fp) != 1) ||
+		(rec.header.magic != TRACE_MAGIC) || (rec.header.version != TRACE_VERSION) ||
+		(rec.header.axes != AXES)) {
+		fprintf(stderr, "%s: not a version %d trace for %d axes\n", trace, TRACE_VERSION, AXES);
+		fclose(tr.fp);
+		return (1);
+	}
+	memset(&tr.block, 0, sizeof(tr.block));
+	tr.replaying = true;
+	tr.blocks = 0;
+	tr.frees = 0;
+	host_init(rec.header.pool_size);
+	_apply_header(&rec.header);
+	if (setjmp(hr.shutdown) != 0) {							// hard alarm - the recording had it too
+		fprintf(stderr, "%s: alarm in replay after %lu blocks\n", trace, (unsigned long)td.blocks);
+		fseek(tr.fp, 0, SEEK_END);
+	}
+	hr.armed = true;
+
+	while ((type = fgetc(tr.fp)) != EOF) {
+		if ((type <= TRACE_HEADER) || (type >= TRACE_TYPES) ||
+			((record_size[type] != 0) && (fread(&rec, record_size[type], 1, tr.fp) != 1))) {
+			fprintf(stderr, "%s: truncated or corrupt after %lu blocks\n", trace, (unsigned long)td.blocks);
+			break;
+		}
+		switch (type) {
+			case TRACE_LINE: {
+				cm.gm.linenum = rec.line.linenum;
+				copy_vector(cm.gm.target, rec.line.target);
+				cm.gm.feed_rate = rec.line.feed_rate;
+				cm.gm.motion_mode = rec.line.motion_mode;
+				cm.gm.feed_rate_mode = rec.line.feed_rate_mode;
+				cm.gm.path_control = rec.line.path_control;
+				cm.gmx.path_tolerance = rec.line.path_tolerance;
+				cm.gm.arc_radius = rec.line.arc_radius;
+				mp_aline(&cm.gm);
+				break;
+			}
+			case TRACE_DWELL: { mp_dwell(rec.value); break; }
+			case TRACE_COMMAND: { mp_queue_command(_replay_command, zero, zero); break; }
+			case TRACE_SYNC: { mp_queue_sync_command(_replay_command, 0); break; }
+			case TRACE_RELEASE: {
+				mp_release_merge();
+				if (mp_get_planner_buffers_available() != 0) { mp_release_sync_command(); }
+				break;
+			}
+			case TRACE_BLOCK: {
+				if (_run_exec_to(&tr.blocks, ++blocks) == false) {
+					blocks = tr.blocks;
+					td.missing++;
+					break;
+				}
+				_compare(&rec.block);
+				break;
+			}
+			case TRACE_FREE: {
+				if (_run_exec_to(&tr.frees, ++frees) == false) {
+					frees = tr.frees;
+				}
+				break;
+			}
+		}
+	}
+	hr.armed = false;
+	tr.replaying = false;
+	fclose(tr.fp);
+
+	const char *name = strrchr(trace, '/');
+	name = (name == NULL) ? trace : name+1;
+	printf("%-36s %8lu %8lu %8lu %10.2e %10.2e", name, (unsigned long)td.blocks,
+		   (unsigned long)td.differ, (unsigned long)td.missing, td.velocity, td.length);
+	if ((td.differ != 0) || (td.missing != 0)) {
+		printf("  first at block %lu, N%lu", (unsigned long)td.first_block, (unsigned long)td.first_line);
+	}
+	printf("\n");
+	return (((td.differ != 0) || (td.missing != 0)) ? 1 : 0);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *output = NULL;
+	int first = 1;
+
+	while ((first < argc) && (argv[first][0] == '-')) {
+		if (strcmp(argv[first], "-v") == 0) {
+			verbose = true;
+			first++;
+		} else if ((strcmp(argv[first], "-o") == 0) && (first+1 < argc)) {
+			output = argv[first+1];
+			first += 2;
+		} else if ((strcmp(argv[first], "-p") == 0) && (first+1 < argc)) {
+			pool_size = min(max(atoi(argv[first+1]), 1), 255);
+			first += 2;
+		} else {
+			break;
+		}
+	}
+	if ((first >= argc) || ((output != NULL) && (first+1 != argc))) {
+		fprintf(stderr, "usage: %s [-p pool] -o file.trc file.gcode\n", argv[0]);
+		fprintf(stderr, "       %s [-v] file.trc [file.trc ...]\n", argv[0]);
+		return (2);
+	}
+	if (output != NULL) {
+		return (_record(argv[first], output));
+	}
+	int status = 0;
+	printf("%-36s %8s %8s %8s %10s %10s\n", "trace", "blocks", "differ", "missing", "velocity", "length");
+	for (int i = first; i < argc; i++) {
+		status |= _replay(argv[i]);
+	}
+	return (status);
+}
@@ -0,0 +1,358 @@
+/*
+ * planner_bench.c - host-native planner benchmark driven by Gcode files
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ * Usage: planner_bench [-s] [-r repeats] [-p pool] [-m tolerance] [-o factor] [-a accel] file.gcode [file.gcode ...]
+ *
+ *	Each file is streamed through gc_gcode_parser() the way the controller would
+ *	with a sender that always keeps the queue full: a new line is only parsed once
+ *	_sync_to_planner() would pass - PLANNER_BUFFER_HEADROOM buffers are free and
+ *	less than PLANNER_LOOKAHEAD_TIME of motion is queued - and segments are pulled
+ *	out of mp_exec_move() until that is true. Arcs are run through cm_arc_callback()
+ *	and only wait for buffers, as on the board.
+ *
+ *	-p sets the runtime pool size passed to planner_init(). It is capped by the
+ *	compiled PLANNER_BUFFER_POOL_SIZE (build with POOL=n to raise it), except in
+ *	planner_bench_heap, which allocates the pool as the ARM build does.
+ *	planner_bench_xyz is built with MOTION_AXES=3, for XYZ files (see tinyg.h).
+ *
+ *	-m runs each file as if it started with G64 P<tolerance> (mm), which merges runs of
+ *	nearly collinear G1 lines into single blocks. mp_merge_callback() runs wherever the
+ *	controller loop would run it: between exec passes and before each line.
+ *
+ *	-o sets the feed and traverse override to factor halfway through each file, as an
+ *	operator would from the panel ({mfo:..} / {mto:..}). The queued moves and the move
+ *	that is running are replanned; mp_feed_override_callback() runs with the merge callback.
+ *	A line per file counts the queued blocks the override replans, against the blocks
+ *	that were queued behind the running move. Every one of them must be replanned.
+ *
+ *	-a sets the acceleration limit of every axis, in mm/min^2 divided by 1000 as for {xac:..}.
+ *	Heads and tails that would exceed it are stretched and run as 7-segment profiles.
+ *
+ *	-s adds a line per file with the firmware's own planner statistics, as {pl:n} reports
+ *	them: trapezoid cases, non-replannable marks and starvation. Its planning time is left
+ *	out - the host is too fast for the board's 2 us timer resolution (see us/block).
+ *
+ *	Reported per file (best of N repeats for the timings):
+ *	  blocks	 - line blocks committed to the planner queue
+ *	  us/block	 - wall time spent in mp_aline() per planned block
+ *	  cyc/block	 - the same in CPU timestamp counter cycles
+ *	  us/seg	 - wall time spent in mp_exec_move() per prepped segment
+ *	  replans	 - mp_calculate_trapezoid() calls per planned block (1.00 = no replanning)
+ *	  ahead(ms)	 - average planned motion queued when a line is parsed
+ *	  time		 - predicted machining time (sum of segment and dwell times)
+ *
+ *	mp_aline(), mp_calculate_trapezoid() and mp_commit_write_buffer() are counted and timed
+ *	by wrapping them at link time (see Makefile), so the planner sources are compiled unmodified.
+ */
+#include "tinyg.h"
+#include "config.h"
+#include "canonical_machine.h"
+#include "gcode_parser.h"
+#include "plan_arc.h"
+#include "planner.h"
+#include "util.h"
+#include "host.h"
+
+#define BENCH_LINE_LEN 256				// longer than any line the board's RX buffer accepts
+
+typedef struct benchStats {				// per-run planner statistics
+	uint32_t lines;						// Gcode lines read
+	uint32_t blocks;					// line blocks committed to the queue
+	uint32_t min_time_moves;			// mp_aline() calls rejected with STAT_MINIMUM_TIME_MOVE
+	uint32_t trapezoids;				// mp_calculate_trapezoid() calls
+	uint32_t errors;					// lines the parser returned an error for
+	uint32_t first_error_line;			// line number of the first error
+	stat_t first_error;					// status code of the first error
+	double aline_usec;					// time spent in mp_aline()
+	uint64_t aline_cycles;				// cycles spent in mp_aline()
+	double exec_usec;					// time spent in mp_exec_move()
+	double queue_time;					// sum of queued planner time seen by each parsed line (minutes)
+	uint32_t override_queued;			// blocks queued behind the running move at override replans
+	uint32_t override_replanned;		// trapezoids computed by those replans
+} benchStats_t;
+
+static benchStats_t bs;
+static uint8_t pool_size = PLANNER_BUFFER_POOL_SIZE;
+static float merge_tolerance = 0;
+static float override_factor = 0;		// 0 = no override
+static float accel_max = -1;			// -1 = leave the settings profile values
+static uint8_t show_stats = false;
+
+/**** Link-time wrappers ****/
+
+stat_t __real_mp_aline(GCodeState_t *gm_in);
+void __real_mp_calculate_trapezoid(mpBuf_t *bf);
+void __real_mp_commit_write_buffer(const uint8_t move_type);
+
+stat_t __wrap_mp_aline(GCodeState_t *gm_in)
+{
+	double start = host_usec();
+	uint64_t cycles = host_cycles();
+	stat_t status = __real_mp_aline(gm_in);
+	bs.aline_cycles += host_cycles() - cycles;
+	bs.aline_usec += host_usec() - start;
+
+	if (status == STAT_MINIMUM_TIME_MOVE) { bs.min_time_moves++; }
+	return (status);
+}
+
+void __wrap_mp_commit_write_buffer(const uint8_t move_type)
+{
+	if (move_type == MOVE_TYPE_ALINE) { bs.blocks++; }	// a held G64 P line is counted when released
+	__real_mp_commit_write_buffer(move_type);
+}
+
+void __wrap_mp_calculate_trapezoid(mpBuf_t *bf)
+{
+	bs.trapezoids++;
+	__real_mp_calculate_trapezoid(bf);
+}
+
+/**** Driver ****/
+
+/*
+ * _override_callback() - mp_feed_override_callback(), counting what an override replan covers
+ */
+
+static void _override_callback(void)
+{
+	uint8_t replan = (mr.override_state == OVERRIDE_PLAN) ||
+					 ((mr.override_state == OVERRIDE_SYNC) && (mr.move_state != MOVE_RUN));
+	uint32_t queued = 0;
+	uint32_t trapezoids = bs.trapezoids;
+
+	if ((replan == true) && (cm.hold_state == FEEDHOLD_OFF) && (mp_get_run_buffer() != NULL)) {
+		for (mpBuf_t *bp = mp_get_run_buffer(); bp != mp_get_last_buffer(); bp = bp->nx) {
+			queued++;
+		}
+	}
+	mp_feed_override_callback();
+	if (queued != 0) {
+		bs.override_queued += queued;
+		bs.override_replanned += bs.trapezoids - trapezoids;
+	}
+}
+
+/*
+ * _exec_until() - run the exec until the planner has N free buffers and less than T queued
+ *
+ *	Pass mb.pool_size to drain the queue completely. A NOOP from the exec is not
+ *	the end of the queue if it freed a buffer (zero length moves).
+ */
+
+static void _exec_until(uint8_t buffers_available, float queue_time)
+{
+	uint8_t available;
+
+	while ((mp_merge_callback() == STAT_OK) &&
+		   (((available = mp_get_planner_buffers_available()) < buffers_available) ||
+			(mp_get_planner_queue_time() >= queue_time))) {
+		_override_callback();
+		uint32_t segments = hr.segments;
+		double start = host_usec();
+		stat_t status = host_exec_move();
+		double elapsed = host_usec() - start;
+
+		if (hr.segments != segments) { bs.exec_usec += elapsed; }
+		if ((status == STAT_NOOP) && (mp_get_planner_buffers_available() == available)) {
+			break;										// nothing left that can run
+		}
+	}
+}
+
+static stat_t _run_file(const char *filename)
+{
+	char_t line[BENCH_LINE_LEN];
+	uint32_t override_line = 0;
+	FILE *fp;
+
+	if ((fp = fopen(filename, "r")) == NULL) {
+		perror(filename);
+		return (STAT_FILE_NOT_OPEN);
+	}
+	if (override_factor > 0) {							// override at the middle line
+		while (fgets((char *)line, sizeof(line), fp) != NULL) { override_line++; }
+		override_line = max(override_line / 2, 1);
+		rewind(fp);
+	}
+	memset(&bs, 0, sizeof(bs));
+	host_init(pool_size);
+	cm_set_path_tolerance(merge_tolerance);
+	if (accel_max >= 0) {
+		for (uint8_t axis = 0; axis < AXES; axis++) { cm_set_axis_accel(axis, accel_max);}
+	}
+	if (setjmp(hr.shutdown) != 0) {
+		fprintf(stderr, "%s:%lu: hard alarm, machine shut down\n", filename, (unsigned long)bs.lines);
+		fclose(fp);
+		return (STAT_OK);
+	}
+	hr.armed = true;
+
+	while (fgets((char *)line, sizeof(line), fp) != NULL) {
+		bs.lines++;
+		while (cm_arc_callback() == STAT_EAGAIN) {
+			_exec_until(PLANNER_BUFFER_HEADROOM, INFINITY);
+		}
+		_exec_until(PLANNER_BUFFER_HEADROOM, PLANNER_LOOKAHEAD_TIME);
+		mp_merge_callback();
+		_override_callback();
+		bs.queue_time += mp_get_planner_queue_time();
+		if (bs.lines == override_line) {
+			cm.gmx.feed_rate_override_factor = override_factor;
+			cm.gmx.traverse_override_factor = override_factor;
+			cm_override_enables(true);
+		}
+
+		stat_t status = gc_gcode_parser(line);
+		if ((status != STAT_OK) && (status != STAT_NOOP) && (status != STAT_MINIMUM_TIME_MOVE)) {
+			if (bs.errors++ == 0) {
+				bs.first_error = status;
+				bs.first_error_line = bs.lines;
+			}
+		}
+		if (cm.machine_state == MACHINE_ALARM) {
+			fprintf(stderr, "%s:%lu: machine alarm, status %d\n", filename, (unsigned long)bs.lines, hr.last_exception);
+			break;
+		}
+	}
+	while (cm_arc_callback() == STAT_EAGAIN) {
+		_exec_until(PLANNER_BUFFER_HEADROOM, INFINITY);
+	}
+	_exec_until(mb.pool_size, INFINITY);
+	hr.armed = false;
+	fclose(fp);
+	return (STAT_OK);
+}
+
+static void _print_header(void)
+{
+	printf("%-28s %7s %7s %6s %9s %8s %9s %8s %8s %9s %11s\n",
+		   "file", "lines", "blocks", "mintm", "segments", "us/block", "cyc/block", "us/seg", "replans", "ahead(ms)", "time(s)");
+}
+
+static void _print_stats(const char *filename, benchStats_t *best)
+{
+	const char *name = strrchr(filename, '/');
+	name = (name == NULL) ? filename : name+1;
+	float blocks = (best->blocks == 0) ? 1 : best->blocks;
+	float segments = (hr.segments == 0) ? 1 : hr.segments;
+
+	printf("%-28s %7lu %7lu %6lu %9lu %8.3f %9.0f %8.3f %8.2f %9.1f %11.3f\n",
+		   name,
+		   (unsigned long)best->lines,
+		   (unsigned long)best->blocks,
+		   (unsigned long)best->min_time_moves,
+		   (unsigned long)hr.segments,
+		   best->aline_usec / blocks,
+		   best->aline_cycles / blocks,
+		   best->exec_usec / segments,
+		   best->trapezoids / blocks,
+		   best->queue_time * 60000 / max(best->lines, 1),
+		   hr.segment_time * 60 + hr.dwell_time);
+	if (override_factor > 0) {
+		printf("%-28s override replanned %lu of %lu queued blocks\n", "",
+			   (unsigned long)best->override_replanned, (unsigned long)best->override_queued);
+	}
+	if (best->errors != 0) {
+		printf("%-28s %lu lines returned errors, first was status %d at line %lu\n", "",
+			   (unsigned long)best->errors, best->first_error, (unsigned long)best->first_error_line);
+	}
+}
+
+static void _print_planner_stats(void)		// mps of the last run - counts are the same every run
+{
+	static const char *zoid_names[ZOID_CASES] = { "F", "B\"", "B", "T\"", "T'", "H\"", "H'", "HT", "HT'", "HBT" };
+
+	printf("%-28s", "");
+	for (uint8_t i = 0; i < ZOID_CASES; i++) {
+		printf(" %s:%lu", zoid_names[i], (unsigned long)mps.zoid[i]);
+	}
+	printf("  non-replannable:%lu min-time:%lu starved:%lu\n",
+		   (unsigned long)mps.optimal, (unsigned long)mps.min_time_moves, (unsigned long)mps.starved);
+}
+
+int main(int argc, char *argv[])
+{
+	int repeats = 1;
+	int first = 1;
+
+	while ((first+1 < argc) && (argv[first][0] == '-')) {
+		if (strcmp(argv[first], "-s") == 0) {
+			show_stats = true;
+			first++;
+			continue;
+		}
+		if (strcmp(argv[first], "-r") == 0) {
+			repeats = max(atoi(argv[first+1]), 1);
+		} else if (strcmp(argv[first], "-p") == 0) {
+			pool_size = min(max(atoi(argv[first+1]), 1), 255);
+		} else if (strcmp(argv[first], "-m") == 0) {
+			merge_tolerance = max(atof(argv[first+1]), 0);
+		} else if (strcmp(argv[first], "-a") == 0) {
+			accel_max = max(atof(argv[first+1]), 0);
+		} else if (strcmp(argv[first], "-o") == 0) {
+			override_factor = min(max(atof(argv[first+1]), FEED_OVERRIDE_MIN), FEED_OVERRIDE_MAX);
+		} else {
+			break;
+		}
+		first += 2;
+	}
+	if (first >= argc) {
+		fprintf(stderr, "usage: %s [-s] [-r repeats] [-p pool] [-m tolerance] [-o factor] [-a accel] file.gcode [file.gcode ...]\n", argv[0]);
+		return (1);
+	}
+	host_init(pool_size);								// report the pool as planner_init() sized it
+#ifdef PLANNER_HEAP_POOL
+	printf("planner pool %d buffers (heap) of %d+%d bytes, headroom %d, lookahead %d ms, nominal segment %d us\n",
+		   mb.pool_size, (int)sizeof(mpBuf_t), (int)sizeof(mpGCodeState_t),
+#else
+	printf("planner pool %d buffers (max %d) of %d+%d bytes, headroom %d, lookahead %d ms, nominal segment %d us\n",
+		   mb.pool_size, PLANNER_BUFFER_POOL_SIZE, (int)sizeof(mpBuf_t), (int)sizeof(mpGCodeState_t),
+#endif
+		   PLANNER_BUFFER_HEADROOM, (int)(PLANNER_LOOKAHEAD_USEC / 1000), (int)NOM_SEGMENT_USEC);
+	if (MOTION_AXES < AXES) {
+		printf("planning and exec built for %d of %d axes (MOTION_AXES)\n", MOTION_AXES, AXES);
+	}
+	if (merge_tolerance > 0) {
+		printf("G64 P%g line merging, up to %d lines per block\n", merge_tolerance, PLANNER_MERGE_POINTS+1);
+	}
+	if (accel_max > 0) {
+		printf("axis acceleration limit %g mm/min^2 (%g mm/s^2)\n", accel_max * ACCEL_MULTIPLIER, accel_max * ACCEL_MULTIPLIER / 3600);
+	}
+	if (override_factor > 0) {
+		printf("feed and traverse override %g from the middle of each file\n", override_factor);
+	}
+	_print_header();
+
+	for (int i = first; i < argc; i++) {
+		benchStats_t best;
+		memset(&best, 0, sizeof(best));
+		for (int r = 0; r < repeats; r++) {
+			if (_run_file(argv[i]) != STAT_OK) { break; }
+			if ((r == 0) || (bs.aline_usec + bs.exec_usec < best.aline_usec + best.exec_usec)) {
+				best = bs;
+			}
+		}
+		if (bs.lines != 0) {
+			_print_stats(argv[i], &best);
+			if (show_stats) { _print_planner_stats();}
+		}
+	}
+	return (0);
+}
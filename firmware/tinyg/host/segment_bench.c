@@ -0,0 +1,337 @@
+/*
+ * segment_bench.c - exec load and velocity steps of the segment slicing, from the firmware planner
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ * Usage: segment_bench file.gcode [file.gcode ...]
+ *
+ *	Streams each file through the parser, planner and exec as planner_bench does and
+ *	looks at every segment the exec prepares. Each segment runs at the velocity of the
+ *	profile at its midpoint, so the step rate is a staircase over the profile, off it by
+ *	up to half the slope times the segment time. The slope of a head or tail is taken
+ *	from the neighbouring segments in the same section, or from the section's velocity
+ *	change if it has only one segment. Bodies have none.
+ *
+ *	Hold latency is the time from a feedhold request to the first decelerating segment.
+ *	The segment running and the ones already prepared behind it (PREP_QUEUE_DEPTH) run
+ *	out first, so a request arriving during segment i waits for the rest of segment i
+ *	and all of the prepared ones. The mean is over requests at uniformly random times.
+ *
+ *	Step error is the position of a model of the DDA against the exact sum of the steps
+ *	the exec asked for, per motor. The model does the loader's integer arithmetic: the
+ *	substep increment rounded to DDA_SUBSTEPS, the accumulator rescaled when the segment
+ *	time changes and mirrored when the direction does. The accumulator phase counts, so
+ *	this is drift from the substep resolution and the rescaling, not the +/-0.5 step of
+ *	a whole number of steps.
+ *
+ *	make segmentbench runs the samples twice: segment_bench with the per-section
+ *	segment times and segment_bench_fixed with plan_exec.c built to slice every section
+ *	at NOM_SEGMENT_USEC (see BODY_SEGMENT_USEC in planner.h).
+ *
+ *	Reported per file:
+ *	  segments	- segments prepared. Each one is a pass of the exec and the loader
+ *	  seg/s		- segments per second of machine time: the exec's share of the
+ *				  LO interrupt goes with it
+ *	  short		- segments under 1.2 * MIN_SEGMENT_USEC (%) - the ones that leave the
+ *				  least time to prepare the next
+ *	  vel rms	- RMS of staircase minus profile over the heads and tails (mm/min)
+ *	  vel max	- the largest such difference (mm/min)
+ *	  hold ms	- mean and largest hold latency (ms)
+ *	  step err	- largest DDA position error on any motor over the run (steps). A '!'
+ *				  after it means the accumulator left the int32 range (DDA_SUBSTEPS)
+ *	  time		- machine time (s)
+ */
+#include "tinyg.h"
+#include "config.h"
+#include "canonical_machine.h"
+#include "gcode_parser.h"
+#include "plan_arc.h"
+#include "planner.h"
+#include "stepper.h"
+#include "hardware.h"
+#include "util.h"
+#include "host.h"
+
+#define SEGMENT_LINE_LEN	256				// longer than any line the board's RX buffer accepts
+
+typedef struct segmentMotor {				// the DDA model of one motor
+	int64_t accumulator;					// substep accumulator, as st_run keeps it
+	int64_t steps;							// steps taken, signed
+	uint8_t direction;						// as st_pre.mot[].prev_direction
+	uint8_t moved;							// false until the first segment that moves it
+	float prev_segment_time;				// as st_pre.mot[].prev_segment_time
+	double exact;							// sum of travel_steps, from the model's start position
+} segmentMotor_t;
+
+typedef struct segmentStats {				// what one file came to
+	uint32_t segments;
+	uint32_t short_segments;				// under 1.2 * MIN_SEGMENT_USEC
+	double accel_time;						// time in heads and tails (min)
+	double error_sum;						// integral of (staircase - profile)^2
+	double error_max;
+	float velocity[3];						// the last three segments of the section
+	uint32_t count;							// segments of the section so far
+	double hold_sum;						// integral of the hold latency over time (min^2)
+	double hold_max;						// (min)
+	double window[PREP_QUEUE_DEPTH+1];		// times of the segment running and the ones prepared
+	uint32_t window_count;
+	double step_error_max;					// (steps)
+	uint8_t overflow;						// true if the accumulator left the int32 range
+	segmentMotor_t mot[MOTORS];
+} segmentStats_t;
+
+static segmentStats_t ss;
+
+stat_t __real_st_prep_line(float travel_steps[], float following_error[], float segment_time);
+
+/*
+ * _add_error() - add a segment of time h on a profile of the given slope
+ *
+ *	The staircase is off the profile by slope*t for t in -h/2..h/2. Squared, that
+ *	integrates to slope^2 * h^3/12.
+ */
+
+static void _add_error(double slope, double h)
+{
+	ss.error_sum += slope*slope * h*h*h / 12;
+	ss.error_max = max(ss.error_max, fabs(slope) * h/2);
+}
+
+/*
+ * _add_hold_window() - add a segment to the hold latency
+ *
+ *	Once a segment has PREP_QUEUE_DEPTH segments behind it, the latency over it runs
+ *	from its own time plus theirs down to theirs alone.
+ */
+
+static void _add_hold_window(double h)
+{
+	uint8_t n = PREP_QUEUE_DEPTH;
+
+	memmove(&ss.window[0], &ss.window[1], sizeof(double) * n);
+	ss.window[n] = h;
+	if (++ss.window_count <= n) { return; }
+
+	double prepared = 0;
+	for (uint8_t i=1; i<=n; i++) { prepared += ss.window[i]; }
+	ss.hold_sum += ss.window[0] * (prepared + ss.window[0]/2);
+	ss.hold_max = max(ss.hold_max, prepared + ss.window[0]);
+}
+
+/*
+ * _add_dda_segment() - run a segment through the DDA model of each motor
+ *
+ *	The same arithmetic as st_prep_line() and _load_move(). The ISR steps when the
+ *	accumulator goes positive and takes a step's worth of substeps back, so over a
+ *	segment it steps enough times to bring the accumulator back to zero or below.
+ *	With p = (accumulator + ticks*substeps) / (ticks*substeps) the exact position is
+ *	steps - 1 + p going forward and steps - p going back - the DDA keeps the step count
+ *	at the exact position rounded up either way, which is what mirroring the accumulator
+ *	on a direction change keeps. The first segment of a motor sets where the count is
+ *	taken from.
+ */
+
+static void _add_dda_segment(const float travel_steps[], float segment_time)
+{
+	int32_t dda_ticks = (int32_t)(segment_time * 60 * FREQUENCY_DDA);
+	int64_t dda_ticks_X_substeps = (uint32_t)(dda_ticks * DDA_SUBSTEPS);
+
+	if (dda_ticks_X_substeps > INT32_MAX) { ss.overflow = true; }	// the accumulator is an int32_t
+
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		segmentMotor_t *m = &ss.mot[motor];
+
+		if (fp_ZERO(travel_steps[motor])) { continue; }
+		int8_t sign = (travel_steps[motor] >= 0) ? 1 : -1;
+		uint8_t direction = ((sign > 0) ? DIRECTION_CW : DIRECTION_CCW) ^ st_cfg.mot[motor].polarity;
+		int64_t increment = (uint32_t)round(fabs(travel_steps[motor] * DDA_SUBSTEPS));
+
+		if (fabs(segment_time - m->prev_segment_time) > 0.0000001) {
+			if (fp_NOT_ZERO(m->prev_segment_time)) {
+				m->accumulator = (int32_t)(m->accumulator * (segment_time / m->prev_segment_time));
+			}
+			m->prev_segment_time = segment_time;
+		}
+		if (direction != m->direction) {
+			m->direction = direction;
+			m->accumulator = -(dda_ticks_X_substeps + m->accumulator);
+		}
+		double phase = (double)(m->accumulator + dda_ticks_X_substeps) / dda_ticks_X_substeps;
+		if (m->moved == false) {
+			m->moved = true;
+			m->exact = m->steps - ((sign > 0) ? 1 - phase : phase);
+		}
+		int64_t total = m->accumulator + increment * dda_ticks;
+		int64_t steps = (total > 0) ? (total + dda_ticks_X_substeps - 1) / dda_ticks_X_substeps : 0;
+		m->accumulator = total - steps * dda_ticks_X_substeps;
+		m->steps += sign * steps;
+		m->exact += travel_steps[motor];
+
+		phase = (double)(m->accumulator + dda_ticks_X_substeps) / dda_ticks_X_substeps;
+		double error = m->steps - ((sign > 0) ? 1 - phase : phase) - m->exact;
+		ss.step_error_max = max(ss.step_error_max, fabs(error));
+	}
+}
+
+/*
+ * __wrap_st_prep_line() - record the segment the exec prepares
+ *
+ *	A segment is scored once the one after it is known, and the last of a section when
+ *	it is prepared. Segments of a section all have the same time.
+ */
+stat_t __wrap_st_prep_line(float travel_steps[], float following_error[], float segment_time)
+{
+	float steps[MOTORS];
+
+	memcpy(steps, travel_steps, sizeof(steps));
+	stat_t status = __real_st_prep_line(travel_steps, following_error, segment_time);
+
+	if (status != STAT_OK) { return (status); }
+	ss.segments++;
+	_add_hold_window(segment_time);
+	_add_dda_segment(steps, segment_time);
+	if (segment_time < 1.2 * MIN_SEGMENT_TIME) { ss.short_segments++; }
+	if (mr.section == SECTION_BODY) { return (status); }
+	ss.accel_time += segment_time;
+
+	double h = segment_time;
+	if (mr.segment_count == (uint32_t)mr.segments - 1) {		// first of the section
+		ss.count = 0;
+	}
+	ss.velocity[0] = ss.velocity[1];
+	ss.velocity[1] = ss.velocity[2];
+	ss.velocity[2] = mr.segment_velocity;
+	ss.count++;
+
+	if (ss.count >= 3) {										// the one before, from both sides
+		_add_error((ss.velocity[2] - ss.velocity[0]) / (2*h), h);
+	} else if (ss.count == 2) {									// the first, from the right
+		_add_error((ss.velocity[2] - ss.velocity[1]) / h, h);
+	}
+	if (mr.segment_count == 0) {								// the last
+		if (ss.count >= 2) {
+			_add_error((ss.velocity[2] - ss.velocity[1]) / h, h);
+		} else if (mr.section == SECTION_HEAD) {
+			_add_error((mr.cruise_velocity - mr.entry_velocity) / h, h);
+		} else {
+			_add_error((mr.exit_velocity - mr.cruise_velocity) / h, h);
+		}
+	}
+	return (status);
+}
+
+/*
+ * _exec_until() - run the exec until the planner has N free buffers and less than T queued
+ *
+ *	Same as planner_bench: pass mb.pool_size to drain the queue.
+ */
+
+static void _exec_until(uint8_t buffers_available, float queue_time)
+{
+	uint8_t available;
+
+	while ((mp_merge_callback() == STAT_OK) &&
+		   (((available = mp_get_planner_buffers_available()) < buffers_available) ||
+			(mp_get_planner_queue_time() >= queue_time))) {
+		stat_t status = host_exec_move();
+		if ((status == STAT_NOOP) && (mp_get_planner_buffers_available() == available)) {
+			break;
+		}
+	}
+}
+
+/*
+ * _run_file() - stream one file through the parser, planner and exec
+ *
+ *	Returns the line that raised an alarm, 0 if none.
+ */
+
+static uint32_t _run_file(const char *filename)
+{
+	char_t line[SEGMENT_LINE_LEN];
+	volatile uint32_t lines = 0;
+	FILE *fp;
+
+	if ((fp = fopen(filename, "r")) == NULL) {
+		fprintf(stderr, "%s: cannot open\n", filename);
+		exit(1);
+	}
+	host_init(PLANNER_BUFFER_POOL_SIZE);
+	memset(&ss, 0, sizeof(ss));
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		ss.mot[motor].direction = STEP_INITIAL_DIRECTION;
+	}
+	if (setjmp(hr.shutdown) != 0) {						// hard alarm
+		fclose(fp);
+		return (max(lines, 1));
+	}
+	hr.armed = true;
+
+	while (fgets((char *)line, sizeof(line), fp) != NULL) {
+		lines++;
+		while (cm_arc_callback() == STAT_EAGAIN) {
+			_exec_until(PLANNER_BUFFER_HEADROOM, INFINITY);
+		}
+		_exec_until(PLANNER_BUFFER_HEADROOM, PLANNER_LOOKAHEAD_TIME);
+		mp_merge_callback();
+		gc_gcode_parser(line);
+		if (cm.machine_state == MACHINE_ALARM) {
+			fclose(fp);
+			return (lines);
+		}
+	}
+	while (cm_arc_callback() == STAT_EAGAIN) {
+		_exec_until(PLANNER_BUFFER_HEADROOM, INFINITY);
+	}
+	_exec_until(mb.pool_size, INFINITY);
+	hr.armed = false;
+	fclose(fp);
+	return (0);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s file.gcode [file.gcode ...]\n", argv[0]);
+		return (1);
+	}
+	printf("segments: heads and tails %d us, at least %d, down to %d us; bodies %d us\n",
+		   (int)NOM_SEGMENT_USEC, (int)ACCEL_SECTION_SEGMENTS, (int)MIN_SEGMENT_USEC,
+		   (int)BODY_SEGMENT_USEC);
+	printf("%d segments prepared behind the one running, %.0f substeps per step\n",
+		   PREP_QUEUE_DEPTH, (double)DDA_SUBSTEPS);
+	printf("%-30s %9s %7s %6s %8s %8s %13s %9s %10s\n", "file", "segments", "seg/s", "short",
+		   "vel rms", "vel max", "hold ms", "step err", "time (s)");
+	for (int f = 1; f < argc; f++) {
+		const char *name = strrchr(argv[f], '/');
+		name = (name == NULL) ? argv[f] : name+1;
+		uint32_t alarm;
+
+		if ((alarm = _run_file(argv[f])) != 0) {
+			printf("%-30s alarm at line %lu\n", name, (unsigned long)alarm);
+			continue;
+		}
+		double seconds = hr.segment_time * 60;
+		printf("%-30s %9lu %7.1f %5.1f%% %8.3f %8.3f %6.1f %6.1f %8.1e%s %10.3f\n", name,
+			   (unsigned long)ss.segments, (seconds > 0) ? ss.segments / seconds : 0,
+			   100.0 * ss.short_segments / max(ss.segments, 1),
+			   (ss.accel_time > 0) ? sqrt(ss.error_sum / ss.accel_time) : 0, ss.error_max,
+			   (hr.segment_time > 0) ? ss.hold_sum / hr.segment_time * 60000 : 0, ss.hold_max * 60000,
+			   ss.step_error_max, (ss.overflow == true) ? "!" : " ", seconds + hr.dwell_time);
+	}
+	return (0);
+}
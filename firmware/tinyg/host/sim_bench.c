@@ -0,0 +1,201 @@
+/*
+ * sim_bench.c - dry run ({sim:1}) pacing, from the firmware planner
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ * Usage: sim_bench [-u] file.gcode [file.gcode ...]
+ *
+ *	Runs each file the way the board runs it in dry run. Lines arrive as fast as the
+ *	controller takes them and the clock stands still, as it nearly does at CPU speed.
+ *	Every commit asks for the exec, which then takes segments until it is held - by
+ *	mp_throttle_exec(), as the exec ISR does in stepper.c - or has nothing to run. A
+ *	held exec leaves the main loop to parse the next line. At the end of the file the
+ *	clock is moved on by PLANNER_INPUT_IDLE_MSEC and the queue runs out.
+ *
+ *	-u leaves the throttle out, as the dry run first was: the exec takes each block as
+ *	soon as start-up priming lets it go, so the queue never holds more than that.
+ *
+ *	make simbench runs both on a few sample files after planner_bench, which keeps the
+ *	queue as full as a sender that keeps up. The dry run times should match its times.
+ *
+ *	Reported per file:
+ *	  bursts	- times the exec took the queue back from the controller and ran
+ *	  stops		- moves that ran down to a standstill, the last one and exact stops included
+ *	  ahead(ms)	- average planned motion queued as the exec takes the queue back
+ *	  time(s)	- dry run time (sum of segment and dwell times, as st_sim adds them up)
+ */
+#include "tinyg.h"
+#include "config.h"
+#include "canonical_machine.h"
+#include "gcode_parser.h"
+#include "plan_arc.h"
+#include "planner.h"
+#include "hardware.h"
+#include "util.h"
+#include "host.h"
+
+#define SIM_LINE_LEN		256				// longer than any line the board's RX buffer accepts
+
+typedef struct simRun {						// what one file came to
+	uint32_t bursts;
+	uint32_t stops;
+	double ahead;							// sum of the queue time at the start of each burst (min)
+} simRun_t;
+
+static simRun_t sr_;
+static uint8_t throttled = true;
+
+/*
+ * _exec_held() - the exec ISR's test in stepper.c (_sim_exec_held()), or never with -u
+ */
+
+static uint8_t _exec_held(void)
+{
+	return ((throttled == true) && (mp_throttle_exec() == true));
+}
+
+/*
+ * _burst() - exec passes until the exec is held or nothing can run
+ */
+
+static void _burst(void)
+{
+	float ahead = mp_get_planner_queue_time();
+	uint8_t ran = false;
+
+	while (_exec_held() == false) {
+		uint8_t move = mr.move_state;
+		uint8_t available = mp_get_planner_buffers_available();
+
+		stat_t status = host_exec_move();
+		if ((move != MOVE_OFF) && (mr.move_state == MOVE_OFF) && (fp_ZERO(mr.exit_velocity))) {
+			sr_.stops++;
+		}
+		if ((status == STAT_NOOP) && (mp_get_planner_buffers_available() == available)) {
+			break;									// nothing left that can run
+		}
+		ran = true;
+	}
+	if (ran == true) {
+		sr_.bursts++;
+		sr_.ahead += ahead;
+	}
+}
+
+/*
+ * _planner_ready() - true if _sync_to_planner() would take a line
+ */
+
+static uint8_t _planner_ready(void)
+{
+	return ((mp_get_planner_buffers_available() >= PLANNER_BUFFER_HEADROOM) &&
+			(mp_get_planner_queue_time() < PLANNER_LOOKAHEAD_TIME));
+}
+
+/*
+ * _run_file() - dry run one file
+ *
+ *	Returns the line that raised an alarm, 0 if none.
+ */
+
+static uint32_t _run_file(const char *filename)
+{
+	char_t line[SIM_LINE_LEN];
+	volatile uint32_t lines = 0;
+	FILE *fp;
+
+	if ((fp = fopen(filename, "r")) == NULL) {
+		fprintf(stderr, "%s: cannot open\n", filename);
+		exit(1);
+	}
+	host_init(PLANNER_BUFFER_POOL_SIZE);
+	memset(&sr_, 0, sizeof(sr_));
+	hr.clocked = true;
+	if (setjmp(hr.shutdown) != 0) {					// hard alarm
+		fclose(fp);
+		return (max(lines, 1));
+	}
+	hr.armed = true;
+
+	while (fgets((char *)line, sizeof(line), fp) != NULL) {
+		lines++;
+		for (;;) {									// controller passes until the line is taken
+			mp_merge_callback();
+			if ((cm_arc_callback() != STAT_EAGAIN) && (_planner_ready() == true)) {
+				break;
+			}
+			uint32_t segments = hr.segments + hr.dwells + hr.commands;
+			_burst();
+			if (hr.segments + hr.dwells + hr.commands == segments) {
+				rtc.sys_ticks++;					// only the clock can let go
+			}
+		}
+		mp_record_line_arrival();
+		gc_gcode_parser(line);
+		if (cm.machine_state == MACHINE_ALARM) {
+			fclose(fp);
+			return (lines);
+		}
+		_burst();									// the commit asked for the exec
+	}
+	rtc.sys_ticks += (uint32_t)max(PLANNER_INPUT_IDLE_MSEC, PLANNER_PRIME_MAX_MSEC);
+	while ((cm_arc_callback() == STAT_EAGAIN) || (mp_merge_callback(), false) ||
+		   (mp_get_planner_buffers_available() != mb.pool_size)) {
+		uint32_t segments = hr.segments + hr.dwells + hr.commands;
+		_burst();
+		if (hr.segments + hr.dwells + hr.commands == segments) {
+			rtc.sys_ticks++;
+		}
+	}
+	hr.armed = false;
+	fclose(fp);
+	return (0);
+}
+
+int main(int argc, char *argv[])
+{
+	int first = 1;
+
+	if ((first < argc) && (strcmp(argv[first], "-u") == 0)) {
+		throttled = false;
+		first++;
+	}
+	if (first >= argc) {
+		fprintf(stderr, "usage: %s [-u] file.gcode [file.gcode ...]\n", argv[0]);
+		return (1);
+	}
+	if (throttled == true) {
+		printf("dry run, exec throttled to the lookahead (%d ms) or end of input\n",
+			   (int)(PLANNER_LOOKAHEAD_USEC / 1000));
+	} else {
+		printf("dry run, exec not throttled (-u)\n");
+	}
+	printf("%-28s %7s %7s %9s %11s\n", "file", "bursts", "stops", "ahead(ms)", "time(s)");
+	for (int f = first; f < argc; f++) {
+		const char *name = strrchr(argv[f], '/');
+		name = (name == NULL) ? argv[f] : name+1;
+		uint32_t alarm;
+
+		if ((alarm = _run_file(argv[f])) != 0) {
+			printf("%-28s alarm at line %lu\n", name, (unsigned long)alarm);
+			continue;
+		}
+		printf("%-28s %7lu %7lu %9.1f %11.3f\n", name, (unsigned long)sr_.bursts, (unsigned long)sr_.stops,
+			   sr_.ahead * 60000 / max(sr_.bursts, 1), hr.segment_time * 60 + hr.dwell_time);
+	}
+	return (0);
+}
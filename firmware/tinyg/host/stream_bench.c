@@ -0,0 +1,200 @@
+/*
+ * stream_bench.c - start/stop motion under a slow sender, from the firmware planner
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ * Usage: stream_bench [-r lines/s] file.gcode [file.gcode ...]
+ *
+ *	Streams each file as a sender that gets a line out every 1/rate seconds at best
+ *	(default STREAM_RATE). A line is taken when it has arrived and _sync_to_planner()
+ *	would pass, and timed with mp_record_line_arrival() as the controller does. Until
+ *	then the exec runs on machine time - segment and dwell times, plus idle time when
+ *	there is nothing to run or the exec holds an idle start. SysTick follows that clock.
+ *
+ *	make streambench runs it twice on one file at a few rates: stream_bench with start-up
+ *	priming and stream_bench_noprime with planner.c built with PLANNER_PRIME_MAX_MSEC=0.
+ *
+ *	Reported per file:
+ *	  starts	- times the machine started from idle: the first line, and every time
+ *				  the queue ran empty under the sender
+ *	  held		- starts from standstill the exec held to prime the queue (mps.primes)
+ *	  stops		- moves that ran down to a standstill, apart from the last one. This
+ *				  includes the exact stops the file asks for
+ *	  idle (s)	- time with nothing running between the first line and the end
+ *	  total (s)	- time from the first line to the end
+ *	  line (ms)	- the line interval the planner measured at the end (mb.line_interval)
+ */
+#include "tinyg.h"
+#include "config.h"
+#include "canonical_machine.h"
+#include "gcode_parser.h"
+#include "plan_arc.h"
+#include "planner.h"
+#include "hardware.h"
+#include "util.h"
+#include "host.h"
+
+#define STREAM_LINE_LEN		256				// longer than any line the board's RX buffer accepts
+#define STREAM_RATE			50				// lines per second
+
+typedef struct streamRun {					// what one file came to
+	uint32_t starts;
+	uint32_t stops;
+	double idle;							// ms
+} streamRun_t;
+
+static streamRun_t sr_;
+
+/*
+ * _clock() - machine clock in ms, and SysTick with it
+ */
+
+static double _clock(void)
+{
+	double clock = hr.segment_time * 60000 + hr.dwell_time * 1000 + sr_.idle;
+	rtc.sys_ticks = (uint32_t)clock;
+	return (clock);
+}
+
+/*
+ * _planner_ready() - true if _sync_to_planner() would take a line
+ */
+
+static uint8_t _planner_ready(void)
+{
+	return ((mp_get_planner_buffers_available() >= PLANNER_BUFFER_HEADROOM) &&
+			(mp_get_planner_queue_time() < PLANNER_LOOKAHEAD_TIME));
+}
+
+/*
+ * _step() - one exec pass, idling up to until if there was nothing to run
+ */
+
+static void _step(double until)
+{
+	uint8_t motion = cm.motion_state;
+	uint8_t move = mr.move_state;
+	uint8_t available = mp_get_planner_buffers_available();
+
+	stat_t status = host_exec_move();
+	if ((motion == MOTION_STOP) && (cm.motion_state == MOTION_RUN)) {
+		sr_.starts++;
+	}
+	if ((move != MOVE_OFF) && (mr.move_state == MOVE_OFF) && (fp_ZERO(mr.exit_velocity)) &&
+		(mp_get_planner_buffers_available() != mb.pool_size)) {
+		sr_.stops++;
+	}
+	if ((status == STAT_NOOP) && (mp_get_planner_buffers_available() == available)) {
+		sr_.idle += max(until - _clock(), 1);		// nothing ran: wait for the line or a tick
+	}
+	_clock();
+}
+
+/*
+ * _run_file() - stream one file at rate lines per second
+ *
+ *	Returns the line that raised an alarm, 0 if none.
+ */
+
+static uint32_t _run_file(const char *filename, double rate)
+{
+	char_t line[STREAM_LINE_LEN];
+	volatile uint32_t lines = 0;
+	double interval = 1000 / rate;
+	double arrival = 0;								// when the next line is at the board (ms)
+	FILE *fp;
+
+	if ((fp = fopen(filename, "r")) == NULL) {
+		fprintf(stderr, "%s: cannot open\n", filename);
+		exit(1);
+	}
+	host_init(PLANNER_BUFFER_POOL_SIZE);
+	memset(&sr_, 0, sizeof(sr_));
+	hr.clocked = true;
+	if (setjmp(hr.shutdown) != 0) {					// hard alarm
+		fclose(fp);
+		return (max(lines, 1));
+	}
+	hr.armed = true;
+
+	while (fgets((char *)line, sizeof(line), fp) != NULL) {
+		lines++;
+		for (;;) {									// controller passes until the line is taken
+			mp_merge_callback();
+			if (cm_arc_callback() != STAT_EAGAIN) {
+				if ((_clock() >= arrival) && (_planner_ready() == true)) {
+					break;
+				}
+			}
+			_step(arrival);
+		}
+		mp_record_line_arrival();
+		gc_gcode_parser(line);
+		if (cm.machine_state == MACHINE_ALARM) {
+			fclose(fp);
+			return (lines);
+		}
+		arrival = _clock() + interval;				// the sender is flow controlled
+	}
+	while ((cm_arc_callback() == STAT_EAGAIN) || (mp_merge_callback(), false) ||
+		   (mp_get_planner_buffers_available() != mb.pool_size)) {
+		_step(_clock() + 1);
+	}
+	hr.armed = false;
+	fclose(fp);
+	return (0);
+}
+
+int main(int argc, char *argv[])
+{
+	double rate = STREAM_RATE;
+	int first = 1;
+
+	while ((first+1 < argc) && (argv[first][0] == '-')) {
+		if (strcmp(argv[first], "-r") == 0) {
+			rate = max(atof(argv[first+1]), 0.1);
+		} else {
+			break;
+		}
+		first += 2;
+	}
+	if (first >= argc) {
+		fprintf(stderr, "usage: %s [-r lines/s] file.gcode [file.gcode ...]\n", argv[0]);
+		return (1);
+	}
+	if (PLANNER_PRIME_MAX_MSEC > 0) {
+		printf("start-up priming, %.1f lines/s\n", rate);
+	} else {
+		printf("no start-up priming (PLANNER_PRIME_MAX_MSEC=0), %.1f lines/s\n", rate);
+	}
+	printf("%-30s %8s %8s %8s %10s %10s %9s\n", "file", "starts", "held", "stops",
+		   "idle (s)", "total (s)", "line (ms)");
+	for (int f = first; f < argc; f++) {
+		const char *name = strrchr(argv[f], '/');
+		name = (name == NULL) ? argv[f] : name+1;
+		uint32_t alarm;
+
+		if ((alarm = _run_file(argv[f], rate)) != 0) {
+			printf("%-30s alarm at line %lu\n", name, (unsigned long)alarm);
+			continue;
+		}
+		printf("%-30s %8lu %8lu %8lu %10.2f %10.2f %9.1f\n", name, (unsigned long)sr_.starts,
+			   (unsigned long)mps.primes, (unsigned long)sr_.stops, sr_.idle / 1000,
+			   _clock() / 1000, mb.line_interval);
+	}
+	return (0);
+}
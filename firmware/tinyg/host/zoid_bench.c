@@ -0,0 +1,154 @@
+/*
+ * zoid_bench.c - cost and accuracy of the HT' case in mp_calculate_trapezoid()
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ * Usage: zoid_bench [blocks]
+ *
+ *	Random rate-limited blocks with Ve != Vx are run through mp_calculate_trapezoid(),
+ *	once with the jerk limit only and once with an acceleration limit as well. Only the
+ *	blocks that land in the HT' case are reported. Each block is built from a cruise
+ *	velocity its head and tail just reach, with jerk, Ve and Vx drawn log-uniform or
+ *	uniform over what the planner sees with sane settings.
+ *
+ *	The build runs this twice (make zoidbench): zoid_bench with the fixed step solver,
+ *	and zoid_bench_iter with plan_zoid.c built with PLAN_ZOID_ITERATIVE - the successive
+ *	approximation it replaced.
+ *
+ *	Reported per limit:
+ *	  blocks	- blocks that ran the HT' case
+ *	  cyc		- mean cycles per call (each block timed as the best of ZOID_REPEATS)
+ *	  max cyc	- the slowest block
+ *	  Vt low	- largest relative shortfall of Vt against a bisection to float precision
+ *	  Vt high	- largest relative excess of Vt - the head and tail then overrun the limits
+ *	  overfit	- largest (head + tail needed for Vt) / length - 1
+ */
+#include "tinyg.h"
+#include "config.h"
+#include "planner.h"
+#include "util.h"
+#include "host.h"
+
+#define ZOID_BLOCKS		100000
+#define ZOID_REPEATS	11
+#define ZOID_VMAX		((float)12000)		// mm/min
+
+typedef struct zoidStats {
+	uint32_t blocks;
+	double cycles;
+	uint64_t cycles_max;
+	double low;
+	double high;
+	double overfit;
+} zoidStats_t;
+
+static float _rand(float lo, float hi) { return (lo + (hi - lo) * rand() / RAND_MAX);}
+static float _rand_log(float lo, float hi) { return (lo * exp(log(hi / lo) * rand() / RAND_MAX));}
+
+/*
+ * _reference_velocity() - highest Vt whose head and tail fit in the block, by bisection
+ */
+static float _reference_velocity(const mpBuf_t *bf)
+{
+	float lo = max(bf->entry_velocity, bf->exit_velocity);
+	float hi = bf->cruise_vmax;
+
+	for (uint8_t i=0; i<48; i++) {
+		float velocity = (lo + hi) / 2;
+		if ((mp_get_target_length(bf->entry_velocity, velocity, bf) +
+			 mp_get_target_length(bf->exit_velocity, velocity, bf)) > bf->length) {
+			hi = velocity;
+		} else {
+			lo = velocity;
+		}
+	}
+	return (lo);
+}
+
+static void _make_block(mpBuf_t *bf, float accel)
+{
+	memset(bf, 0, sizeof(mpBuf_t));
+	bf->pv = bf;
+	bf->jerk = _rand_log(1e7, 1e10);
+	bf->recip_jerk = 1/bf->jerk;
+	bf->cbrt_jerk = cbrt(bf->jerk);
+	bf->accel = accel;
+	bf->entry_velocity = _rand(0, ZOID_VMAX/2);
+	bf->exit_velocity = _rand(0, ZOID_VMAX/2);
+	bf->cruise_vmax = ZOID_VMAX;
+	bf->cruise_velocity = ZOID_VMAX;
+	bf->delta_vmax = mp_get_target_velocity(0, 1, bf);
+
+	float velocity = _rand(max(bf->entry_velocity, bf->exit_velocity), ZOID_VMAX);
+	bf->length = mp_get_target_length(bf->entry_velocity, velocity, bf) +
+				 mp_get_target_length(bf->exit_velocity, velocity, bf);
+}
+
+static void _run(const char *name, uint8_t accel_limit, uint32_t count)
+{
+	zoidStats_t zs;
+	mpBuf_t in, bf;
+
+	memset(&zs, 0, sizeof(zs));
+	srand(1);
+	for (uint32_t n = 0; n < count; n++) {
+		_make_block(&in, (accel_limit == true) ? _rand_log(1e5, 1e7) : 0);
+		if (in.length < 1e-4) continue;
+
+		uint64_t best = UINT64_MAX;
+		uint32_t ht_asym = mps.zoid[ZOID_HT_ASYM];
+		for (uint8_t r = 0; r < ZOID_REPEATS; r++) {
+			memcpy(&bf, &in, sizeof(mpBuf_t));
+			bf.pv = &bf;
+			uint64_t start = host_cycles();
+			mp_calculate_trapezoid(&bf);
+			uint64_t cycles = host_cycles() - start;
+			if (cycles < best) best = cycles;
+		}
+		if (mps.zoid[ZOID_HT_ASYM] == ht_asym) continue;	// not an HT' block
+
+		zs.blocks++;
+		zs.cycles += best;
+		if (best > zs.cycles_max) zs.cycles_max = best;
+
+		double reference = _reference_velocity(&in);
+		double error = (bf.cruise_velocity - reference) / reference;
+		if (-error > zs.low) zs.low = -error;
+		if (error > zs.high) zs.high = error;
+		double fit = (mp_get_target_length(bf.entry_velocity, bf.cruise_velocity, &bf) +
+					  mp_get_target_length(bf.exit_velocity, bf.cruise_velocity, &bf)) / bf.length - 1;
+		if (fit > zs.overfit) zs.overfit = fit;
+	}
+	printf("%-12s %8lu %8.0f %8lu %10.2e %10.2e %10.2e\n", name, (unsigned long)zs.blocks,
+		   zs.cycles / max(zs.blocks, 1), (unsigned long)zs.cycles_max, zs.low, zs.high, zs.overfit);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t count = (argc > 1) ? atoi(argv[1]) : ZOID_BLOCKS;
+
+#ifdef PLAN_ZOID_ITERATIVE
+	printf("HT' solver: successive approximation (PLAN_ZOID_ITERATIVE)\n");
+#else
+	printf("HT' solver: fixed step\n");
+#endif
+	printf("%-12s %8s %8s %8s %10s %10s %10s\n", "limit", "blocks", "cyc", "max cyc",
+		   "Vt low", "Vt high", "overfit");
+	_run("jerk", false, count);
+	_run("jerk+accel", true, count);
+	return (0);
+}
@@ -48,42 +48,30 @@ extern "C"{
  *	fractional DDA steps. The DDA deals with fractional step values as fixed-point binary in
  *	order to get the smoothest possible operation. Steps are passed to the move prep routine
  *	as floats and converted to fixed-point binary during queue loading. See stepper.c for details.
+ *
+ *	Each motor looks up the joint it is mapped to, so there are MOTORS multiplies and no
+ *	compares of the motor map against every axis. st_set_ma() refuses maps past
+ *	MOTION_AXES. The spare joint, always 0, only keeps a map set some other way from
+ *	reading past the joints.
  */
 
 void ik_kinematics(const float travel[], float steps[])
 {
-	float joint[AXES];
+	float joint[MOTION_AXES+1];
 
 //	_inverse_kinematics(travel, joint);				// you can insert inverse kinematics transformations here
-	memcpy(joint, travel, sizeof(float)*AXES);		//...or just do a memcpy for Cartesian machines
+	for (uint8_t axis=0; axis<MOTION_AXES; axis++) {	//...or just copy for Cartesian machines
+		joint[axis] = (cm.a[axis].axis_mode == AXIS_INHIBITED) ? 0 : travel[axis];
+	}
+	joint[MOTION_AXES] = 0;
 
 	// Map motors to axes and convert length units to steps
 	// Most of the conversion math has already been done in during config in steps_per_unit()
 	// which takes axis travel, step angle and microsteps into account.
-	for (uint8_t axis=0; axis<AXES; axis++) {
-		if (cm.a[axis].axis_mode == AXIS_INHIBITED) { joint[axis] = 0;}
-		if (st_cfg.mot[MOTOR_1].motor_map == axis) { steps[MOTOR_1] = joint[axis] * st_cfg.mot[MOTOR_1].steps_per_unit;}
-		if (st_cfg.mot[MOTOR_2].motor_map == axis) { steps[MOTOR_2] = joint[axis] * st_cfg.mot[MOTOR_2].steps_per_unit;}
-		if (st_cfg.mot[MOTOR_3].motor_map == axis) { steps[MOTOR_3] = joint[axis] * st_cfg.mot[MOTOR_3].steps_per_unit;}
-		if (st_cfg.mot[MOTOR_4].motor_map == axis) { steps[MOTOR_4] = joint[axis] * st_cfg.mot[MOTOR_4].steps_per_unit;}
-#if (MOTORS >= 5)
-		if (st_cfg.mot[MOTOR_5].motor_map == axis) { steps[MOTOR_5] = joint[axis] * st_cfg.mot[MOTOR_5].steps_per_unit;}
-#endif
-#if (MOTORS >= 6)
-		if (st_cfg.mot[MOTOR_6].motor_map == axis) { steps[MOTOR_6] = joint[axis] * st_cfg.mot[MOTOR_6].steps_per_unit;}
-#endif
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		uint8_t axis = (st_cfg.mot[motor].motor_map < MOTION_AXES) ? st_cfg.mot[motor].motor_map : MOTION_AXES;
+		steps[motor] = joint[axis] * st_cfg.mot[motor].steps_per_unit;
 	}
-
-/* The above is a loop unrolled version of this:
-	for (uint8_t axis=0; axis<AXES; axis++) {
-		for (uint8_t motor=0; motor<MOTORS; motor++) {
-			if (st_cfg.mot[motor].motor_map == axis) {
-				steps[motor] = joint[axis] * st_cfg.mot[motor].steps_per_unit;
-			}
-		}
-	}
-*/
-
 }
 /*
  * _inverse_kinematics() - inverse kinematics - example is for a cartesian machine
@@ -131,7 +131,11 @@ static void _application_init(void)
 	controller_init(STD_IN, STD_OUT, STD_ERR);// 必须作为第一个应用初始; reqs xio_init()
 	config_init();					// 记录在eeprom中的配置         - 必须作为下一个应用初始化
 	network_init();					// 如果有需要，复位std设备   	- 必须在config_init()后
-	planner_init();					// 运动规划子系统
+#ifdef PLANNER_HEAP_POOL
+	planner_init(cfg.planner_pool_size);	// 运动规划子系统 - 缓冲区数量来自{pool:n}
+#else
+	planner_init(PLANNER_BUFFER_POOL_SIZE);	// 运动规划子系统
+#endif
 	canonical_machine_init();		// canonical machine		  - 必须在config_init()后
 
 	// 下面启动中断并开始
@@ -174,8 +178,8 @@ int main(void)
  * http://www.cs.mun.ca/~paul/cs4723/material/atmel/avr-libc-user-manual-1.6.5/pgmspace.html
  */
 
-stat_t status_code;						// 分配一个变量用于ritorno宏(ritorno定义处查看详细)
-char global_string_buf[MESSAGE_LEN];	// 分配一个字符串数组用于全局信息输出 
+THREAD_LOCAL stat_t status_code;						// 分配一个变量用于ritorno宏(ritorno定义处查看详细)
+THREAD_LOCAL char global_string_buf[MESSAGE_LEN];	// 分配一个字符串数组用于全局信息输出 
 
 //#ifdef __TEXT_MODE
 
@@ -220,8 +224,8 @@ static const char stat_32[] PROGMEM = "Float is infinite";
 static const char stat_33[] PROGMEM = "Float is NAN";
 static const char stat_34[] PROGMEM = "Persistence error";
 static const char stat_35[] PROGMEM = "Bad status report setting";
-static const char stat_36[] PROGMEM = "36";
-static const char stat_37[] PROGMEM = "37";
+static const char stat_36[] PROGMEM = "Segment exec over time budget";
+static const char stat_37[] PROGMEM = "Segment load over time budget";
 static const char stat_38[] PROGMEM = "38";
 static const char stat_39[] PROGMEM = "39";
 
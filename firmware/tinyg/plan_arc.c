@@ -30,7 +30,7 @@
 
 // Allocate arc planner singleton structure
 
-arc_t arc;
+THREAD_LOCAL arc_t arc;
 
 // static本地函数
 static stat_t _compute_arc(void);
@@ -162,6 +162,7 @@ stat_t cm_arc_feed(float target[], float flags[],       // arc endpoints
 
 	// compute arc runtime values
 	ritorno(_compute_arc());
+	arc.gm.arc_radius = arc.radius;					// chords are velocity limited by it (see _get_arc_vmax())
 
 	if (fp_ZERO(arc.length)) {
         return (STAT_MINIMUM_LENGTH_MOVE);          // trap zero length arcs that _compute_arc can throw
@@ -65,7 +65,7 @@ typedef struct arArcSingleton {	    // persistent planner and runtime variables
 
 	magic_t magic_end;
 } arc_t;
-extern arc_t arc;
+extern THREAD_LOCAL arc_t arc;
 
 
 /* arc function prototypes */	// NOTE: See canonical_machine.h for cm_arc_feed() prototype
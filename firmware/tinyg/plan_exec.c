@@ -44,9 +44,11 @@ static stat_t _exec_aline_head(void);
 static stat_t _exec_aline_body(void);
 static stat_t _exec_aline_tail(void);
 static stat_t _exec_aline_segment(void);
+static void _exec_aline_override(mpBuf_t *bf);
 
 #ifndef __JERK_EXEC
 static void _init_forward_diffs(float Vi, float Vt);
+static void _init_accel_section(float Vi, float Vt);
 #endif
 
 /*************************************************************************
@@ -66,6 +68,10 @@ stat_t mp_exec_move()
 	}
 	// Manage cycle and motion state transitions
 	if (bf->move_type == MOVE_TYPE_ALINE) { 			// cycle auto-start for lines only
+		if ((bf->move_state == MOVE_NEW) && (mp_prime_exec(bf) == true)) {
+			st_prep_null();								// let the queue fill before starting
+			return (STAT_NOOP);
+		}
 		if (cm.motion_state == MOTION_STOP) cm_set_motion_state(MOTION_RUN);
 	}
 	if (bf->bf_func == NULL)
@@ -122,6 +128,10 @@ stat_t mp_exec_move()
  *	combinations (head and tail; head and body; body and tail), and single
  *	sections - any one of the three.
  *
+ *	If the move has an acceleration limit the head and tail may also hold a constant
+ *	acceleration between their two halves, which makes 7 periods in all. See
+ *	_init_accel_section().
+ *
  *	The equations that govern the acceleration and deceleration ramps are:
  *
  *	  Period 1	  V = Vi + Jm*(T^2)/2
@@ -162,8 +172,17 @@ stat_t mp_exec_aline(mpBuf_t *bf)
             return (STAT_NOOP);	                        // stops here if holding
 
 		// initialization to process the new incoming bf buffer (Gcode block)
-		memcpy(&mr.gm, &(bf->gm), sizeof(GCodeState_t));// copy in the gcode model state
+		mp_load_gcode_state(&mr.gm, bf->gm);			// copy in the gcode model state
 		bf->replannable = false;
+		if (bf->cm_func != NULL) {						// S or coolant command attached to the block
+			st_pre.sync_func = bf->cm_func;				// ...runs when the loader takes the first segment
+			st_pre.sync_value = bf->sync_value;
+			bf->cm_func = NULL;							// only once - a block restarted after a hold is new again
+			mps.sync_commands++;
+		}
+#ifdef __PLANNER_TRACE
+		mp_trace_block(bf);
+#endif
 														// too short lines have already been removed
 		if (fp_ZERO(bf->length)) {						// ...looks for an actual zero here
 			mr.move_state = MOVE_OFF;					// reset mr buffer
@@ -178,6 +197,7 @@ stat_t mp_exec_aline(mpBuf_t *bf)
 		mr.section = SECTION_HEAD;
 		mr.section_state = SECTION_NEW;
 		mr.jerk = bf->jerk;
+		mr.accel = bf->accel;
 #ifdef __JERK_EXEC
 		mr.jerk_div2 = bf->jerk/2;						// only needed by __JERK_EXEC
 #endif
@@ -190,10 +210,10 @@ stat_t mp_exec_aline(mpBuf_t *bf)
 		mr.exit_velocity = bf->exit_velocity;
 
 		copy_vector(mr.unit, bf->unit);
-		copy_vector(mr.target, bf->gm.target);			// save the final target of the move
+		copy_vector(mr.target, bf->gm->target);			// save the final target of the move
 
 		// generate the waypoints for position correction at section ends
-		for (uint8_t axis=0; axis<AXES; axis++) {
+		for (uint8_t axis=0; axis<MOTION_AXES; axis++) {
 			mr.waypoint[SECTION_HEAD][axis] = mr.position[axis] + mr.unit[axis] * mr.head_length;
 			mr.waypoint[SECTION_BODY][axis] = mr.position[axis] + mr.unit[axis] * (mr.head_length + mr.body_length);
 			mr.waypoint[SECTION_TAIL][axis] = mr.position[axis] + mr.unit[axis] * (mr.head_length + mr.body_length + mr.tail_length);
@@ -201,6 +221,12 @@ stat_t mp_exec_aline(mpBuf_t *bf)
 	}
 	// NB: from this point on the contents of the bf buffer do not affect execution
 
+	// Feed rate override. Rescale the rest of the move at a body segment boundary
+	if ((mr.override_state == OVERRIDE_SYNC) && (mr.override_bf == bf) &&
+		(mr.section == SECTION_BODY) && (mr.section_state == SECTION_2nd_HALF)) {
+		_exec_aline_override(bf);
+	}
+
 	//**** main dispatcher to process segments ***
 	stat_t status = STAT_OK;
 	if (mr.section == SECTION_HEAD) { status = _exec_aline_head();} else
@@ -213,8 +239,12 @@ stat_t mp_exec_aline(mpBuf_t *bf)
 	// Catch the feedhold request and start the planning the hold
 	if (cm.hold_state == FEEDHOLD_SYNC) { cm.hold_state = FEEDHOLD_PLAN;}
 
-	// Look for the end of the decel to go into HOLD state
-	if ((cm.hold_state == FEEDHOLD_DECEL) && (status == STAT_OK)) {
+	// The first segment run after the hold was planned is the first decelerating one
+	if ((cm.hold_state == FEEDHOLD_DECEL) && (mps.hold_timing == true)) { mp_record_hold_time();}
+
+	// Look for the end of the decel to go into HOLD state. A decel that runs on into
+	// the following blocks (Case 2 in mp_plan_hold_callback()) ends where one exits at zero
+	if ((cm.hold_state == FEEDHOLD_DECEL) && (status == STAT_OK) && (fp_ZERO(mr.exit_velocity))) {
 		cm.hold_state = FEEDHOLD_HOLD;
 		cm_set_motion_state(MOTION_HOLD);
 		sr_request_status_report(SR_IMMEDIATE_REQUEST);
@@ -233,6 +263,9 @@ stat_t mp_exec_aline(mpBuf_t *bf)
 		mr.move_state = MOVE_OFF;						// reset mr buffer
 		mr.section_state = SECTION_OFF;
 		bf->nx->replannable = false;					// prevent overplanning (Note 2)
+		if ((mr.override_state == OVERRIDE_SYNC) && (mr.override_bf == bf)) {
+			mr.override_state = OVERRIDE_PLAN;			// ended before it could be rescaled
+		}
 		if (bf->move_state == MOVE_RUN) {
 			if (mp_free_run_buffer()) cm_cycle_end();	// free buffer & end cycle if planner is empty
 		}
@@ -240,6 +273,43 @@ stat_t mp_exec_aline(mpBuf_t *bf)
 	return (status);
 }
 
+/*
+ * _exec_aline_override() - replace the rest of a cruising move with the feed override profile
+ *
+ *	The planner computed the new velocities and the head and tail lengths (see
+ *	mp_feed_override_callback()). What is left of the body and tail becomes a new head,
+ *	body and tail starting here. bf->exit_velocity is updated so the blocks behind are
+ *	replanned from the new exit velocity. The move is left alone if the rest of it is
+ *	too short, if it is not the move the override was computed for, or if a feedhold has
+ *	started. Either way the planner is told to replan the queue.
+ */
+static void _exec_aline_override(mpBuf_t *bf)
+{
+	float body_length = mr.segment_count * mr.segment_time * mr.cruise_velocity + mr.tail_length
+					  - mr.override_head - mr.override_tail;
+
+	mr.override_state = OVERRIDE_PLAN;
+	if ((cm.hold_state != FEEDHOLD_OFF) || (fp_NE(mr.cruise_velocity, mr.override_entry)) ||
+		(body_length < mr.override_velocity * MIN_SEGMENT_TIME)) {
+		return;
+	}
+	mr.entry_velocity = mr.cruise_velocity;
+	mr.cruise_velocity = mr.override_velocity;
+	mr.exit_velocity = mr.override_exit;
+	mr.head_length = mr.override_head;
+	mr.body_length = body_length;
+	mr.tail_length = mr.override_tail;
+	bf->exit_velocity = mr.exit_velocity;
+
+	for (uint8_t axis=0; axis<MOTION_AXES; axis++) {
+		mr.waypoint[SECTION_HEAD][axis] = mr.position[axis] + mr.unit[axis] * mr.head_length;
+		mr.waypoint[SECTION_BODY][axis] = mr.position[axis] + mr.unit[axis] * (mr.head_length + mr.body_length);
+		mr.waypoint[SECTION_TAIL][axis] = mr.target[axis];
+	}
+	mr.section = SECTION_HEAD;
+	mr.section_state = SECTION_NEW;
+}
+
 /* Forward difference math explained:
  *
  *	We are using a quintic (fifth-degree) Bezier polynomial for the velocity curve.
@@ -382,8 +452,72 @@ static void _init_forward_diffs(float Vi, float Vt)
 	float half_Ah_5 = C * half_h * half_h * half_h * half_h * half_h;
 	mr.segment_velocity = half_Ah_5 + half_Bh_4 + half_Ch_3 + Vi;
 }
+
+/*
+ * _init_accel_section() - set up a head or tail, as a 7-segment profile if it needs one
+ *
+ *	The S-curve over the section time T peaks at ACCEL_PEAK_FACTOR * dV/T. If that is more
+ *	than the move's acceleration limit the S-curve is split at its midpoint and the
+ *	segments in between hold the midpoint acceleration - jerk up, constant acceleration,
+ *	jerk down. With forward differences the hold costs nothing: the differences are just
+ *	not advanced for accel_segments segments, and the second half of the curve carries on
+ *	from the higher velocity. mp_get_target_length() gives the section enough time for the
+ *	hold acceleration to stay at or under the limit.
+ *
+ *	The S-curve runs over the segments not held (an even number, at least 2), scaled to a
+ *	smaller dV so that the curve plus the hold segments add up to the full dV. The hold
+ *	count is rounded up, which errs to a lower acceleration. Requires mr.segments and
+ *	mr.segment_time to be set for the section.
+ */
+static void _init_accel_section(float Vi, float Vt)
+{
+	mr.accel_segments = 0;
+	float move_time = mr.gm.move_time;
+
+	if ((mr.accel > 0) && (mr.segments >= 3) &&
+		(ACCEL_PEAK_FACTOR * fabs(Vt - Vi) > mr.accel * move_time)) {
+		uint32_t segments = (uint32_t)mr.segments;
+		float curve_time = (move_time - fabs(Vt - Vi) / mr.accel) * (ACCEL_PEAK_FACTOR / (ACCEL_PEAK_FACTOR - 1));
+		uint32_t hold = (uint32_t)ceil(max(move_time - curve_time, 0) / mr.segment_time);
+		hold = min(hold, segments - 2);
+		if ((segments - hold) & 1) { hold++;}
+
+		// velocity step across the midpoint of the curve, as a fraction of its dV
+		float n = (segments - hold) / 2;
+		float u_lo = (n - 0.5) / (2*n);
+		float u_hi = (n + 0.5) / (2*n);
+		float step = u_hi*u_hi*u_hi * (10 - 15*u_hi + 6*u_hi*u_hi) -
+					 u_lo*u_lo*u_lo * (10 - 15*u_lo + 6*u_lo*u_lo);
+
+		mr.segments = segments - hold;					// the curve's segment spacing
+		_init_forward_diffs(Vi, Vi + (Vt - Vi) / (1 + hold * step));
+		mr.segments = segments;
+		mr.accel_segments = hold;
+		mr.accel_start = segments - (uint32_t)n - 1;	// segment_count after the first hold segment
+		return;
+	}
+	_init_forward_diffs(Vi, Vt);
+}
 #endif
 
+/*
+ * _get_section_segments() - number of segments to slice a section of move_time into
+ *
+ *	Segments of segment_usec, or min_segments if that gives more, as long as they are
+ *	not shorter than MIN_SEGMENT_USEC. A section under MIN_SEGMENT_USEC gets one segment
+ *	and the caller rejects it as a minimum time move. See BODY_SEGMENT_USEC in planner.h.
+ */
+static float _get_section_segments(float move_time, float segment_usec, float min_segments)
+{
+	float segments = ceil(uSec(move_time) / segment_usec);
+	float max_segments = floor(move_time / MIN_SEGMENT_TIME_PLUS_MARGIN);
+
+	if (segments < min(min_segments, max_segments)) {
+		segments = min(min_segments, max_segments);
+	}
+	return (segments);
+}
+
 /*********************************************************************************************
  * _exec_aline_head()
  */
@@ -398,7 +532,7 @@ static stat_t _exec_aline_head()
 		}
 		mr.midpoint_velocity = (mr.entry_velocity + mr.cruise_velocity) / 2;
 		mr.gm.move_time = mr.head_length / mr.midpoint_velocity;	// time for entire accel region
-		mr.segments = ceil(uSec(mr.gm.move_time) / (2 * NOM_SEGMENT_USEC)); // # of segments in *each half*
+		mr.segments = _get_section_segments(mr.gm.move_time/2, NOM_SEGMENT_USEC, ACCEL_SECTION_SEGMENTS/2); // # of segments in *each half*
 		mr.segment_time = mr.gm.move_time / (2 * mr.segments);
 		mr.accel_time = 2 * sqrt((mr.cruise_velocity - mr.entry_velocity) / mr.jerk);
 		mr.midpoint_acceleration = 2 * (mr.cruise_velocity - mr.entry_velocity) / mr.accel_time;
@@ -442,9 +576,9 @@ static stat_t _exec_aline_head()
 			return(_exec_aline_body());								// skip ahead to the body generator
 		}
 		mr.gm.move_time = 2*mr.head_length / (mr.entry_velocity + mr.cruise_velocity);// time for entire accel region
-		mr.segments = ceil(uSec(mr.gm.move_time) / NOM_SEGMENT_USEC);// # of segments for the section
+		mr.segments = _get_section_segments(mr.gm.move_time, NOM_SEGMENT_USEC, ACCEL_SECTION_SEGMENTS);// # of segments for the section
 		mr.segment_time = mr.gm.move_time / mr.segments;
-		_init_forward_diffs(mr.entry_velocity, mr.cruise_velocity);
+		_init_accel_section(mr.entry_velocity, mr.cruise_velocity);
 		mr.segment_count = (uint32_t)mr.segments;
 		if (mr.segment_time < MIN_SEGMENT_TIME)
             return(STAT_MINIMUM_TIME_MOVE);                         // exit without advancing position
@@ -477,6 +611,8 @@ static stat_t _exec_aline_head()
                 return(STAT_OK);                                    // ends the move
 			mr.section = SECTION_BODY;
 			mr.section_state = SECTION_NEW;
+		} else if ((mr.accel_segments != 0) && (mr.segment_count <= mr.accel_start)) {
+			mr.accel_segments--;									// hold the acceleration (7-segment profile)
 		} else {
 #ifndef __KAHAN
 			mr.forward_diff_5 += mr.forward_diff_4;
@@ -518,7 +654,8 @@ static stat_t _exec_aline_head()
  * _exec_aline_body()
  *
  *	The body is broken into little segments even though it is a straight line so that
- *	feedholds can happen in the middle of a line with a minimum of latency
+ *	feedholds can happen in the middle of a line with a minimum of latency. They are
+ *	BODY_SEGMENT_USEC long, longer than head and tail segments as the velocity is constant.
  */
 static stat_t _exec_aline_body()
 {
@@ -528,7 +665,7 @@ static stat_t _exec_aline_body()
 			return(_exec_aline_tail());						// skip ahead to tail periods
 		}
 		mr.gm.move_time = mr.body_length / mr.cruise_velocity;
-		mr.segments = ceil(uSec(mr.gm.move_time) / NOM_SEGMENT_USEC);
+		mr.segments = _get_section_segments(mr.gm.move_time, BODY_SEGMENT_USEC, 1);
 		mr.segment_time = mr.gm.move_time / mr.segments;
 		mr.segment_velocity = mr.cruise_velocity;
 		mr.segment_count = (uint32_t)mr.segments;
@@ -561,7 +698,7 @@ static stat_t _exec_aline_tail()
             return(STAT_OK);			                            // end the move
 		mr.midpoint_velocity = (mr.cruise_velocity + mr.exit_velocity) / 2;
 		mr.gm.move_time = mr.tail_length / mr.midpoint_velocity;
-		mr.segments = ceil(uSec(mr.gm.move_time) / (2 * NOM_SEGMENT_USEC));// # of segments in *each half*
+		mr.segments = _get_section_segments(mr.gm.move_time/2, NOM_SEGMENT_USEC, ACCEL_SECTION_SEGMENTS/2);// # of segments in *each half*
 		mr.segment_time = mr.gm.move_time / (2 * mr.segments);		// time to advance for each segment
 		mr.accel_time = 2 * sqrt((mr.cruise_velocity - mr.exit_velocity) / mr.jerk);
 		mr.midpoint_acceleration = 2 * (mr.cruise_velocity - mr.exit_velocity) / mr.accel_time;
@@ -599,9 +736,9 @@ static stat_t _exec_aline_tail()
 		if (fp_ZERO(mr.tail_length))
             return(STAT_OK);                                        // end the move
 		mr.gm.move_time = 2*mr.tail_length / (mr.cruise_velocity + mr.exit_velocity); // len/avg. velocity
-		mr.segments = ceil(uSec(mr.gm.move_time) / NOM_SEGMENT_USEC);// # of segments for the section
+		mr.segments = _get_section_segments(mr.gm.move_time, NOM_SEGMENT_USEC, ACCEL_SECTION_SEGMENTS);// # of segments for the section
 		mr.segment_time = mr.gm.move_time / mr.segments;			// time to advance for each segment
-		_init_forward_diffs(mr.cruise_velocity, mr.exit_velocity);
+		_init_accel_section(mr.cruise_velocity, mr.exit_velocity);
 		mr.segment_count = (uint32_t)mr.segments;
 		if (mr.segment_time < MIN_SEGMENT_TIME)
             return(STAT_MINIMUM_TIME_MOVE);                         // exit without advancing position
@@ -632,6 +769,8 @@ static stat_t _exec_aline_tail()
 
 		if (_exec_aline_segment() == STAT_OK) { 					// set up for body
 			return STAT_OK;
+		} else if ((mr.accel_segments != 0) && (mr.segment_count <= mr.accel_start)) {
+			mr.accel_segments--;									// hold the deceleration (7-segment profile)
 		} else {
 #ifndef __KAHAN
 			mr.forward_diff_5 += mr.forward_diff_4;
@@ -701,10 +840,10 @@ static stat_t _exec_aline_segment()
 
 	if ((--mr.segment_count == 0) && (mr.section_state == SECTION_2nd_HALF) &&
 		(cm.motion_state == MOTION_RUN) && (cm.cycle_state == CYCLE_MACHINING)) {
-		copy_vector(mr.gm.target, mr.waypoint[mr.section]);
+		memcpy(mr.gm.target, mr.waypoint[mr.section], sizeof(float)*MOTION_AXES);	// the rest keep the block's target
 	} else {
 		float segment_length = mr.segment_velocity * mr.segment_time;
-		for (i=0; i<AXES; i++) {
+		for (i=0; i<MOTION_AXES; i++) {
 			mr.gm.target[i] = mr.position[i] + (mr.unit[i] * segment_length);
 		}
 	}
@@ -31,16 +31,32 @@
 #include "controller.h"
 #include "canonical_machine.h"
 #include "planner.h"
+#include "plan_math.h"
 #include "stepper.h"
 #include "report.h"
+#include "hardware.h"
 #include "util.h"
 
 // aline planner routines / feedhold planning
+static stat_t _plan_line(GCodeState_t *gm_in, const uint8_t flush);
+static void _get_held_line(GCodeState_t *gm);
+static void _release_held_line(void);
+static void _carry_line(const GCodeState_t *gm_in, const uint8_t inverse_time);
+static void _take_carry(const GCodeState_t *gm_in);
+static uint8_t _merge_allowed(const GCodeState_t *gm_in);
+static uint8_t _merge_fits(const GCodeState_t *gm_in);
+static uint8_t _blend_corner(const GCodeState_t *gm_in);
 //static void _calc_move_times(GCodeState_t *gms, const float position[]);
 static void _calc_move_times(GCodeState_t *gms, const float axis_length[], const float axis_square[]);
-static void _plan_block_list(mpBuf_t *bf, uint8_t *mr_flag);
-static float _get_junction_vmax(const float a_unit[], const float b_unit[]);
+static void _plan_block_list(mpBuf_t *bf, uint8_t *mr_flag, uint8_t full_replan);
+static float _get_junction_vmax(const mpBuf_t *a, const mpBuf_t *b);
+static float _get_cruise_vmax(const mpBuf_t *bf, uint8_t motion_mode);
+static float _get_arc_vmax(const mpBuf_t *bf);
+static float _get_arc_junction_vmax(const mpBuf_t *a, const mpBuf_t *b, float velocity);
 static void _reset_replannable_list(void);
+static void _plan_hold(mpBuf_t *bp);
+static uint8_t _request_runtime_override(void);
+static void _replan_for_override(void);
 
 /* Runtime-specific setters and getters
  *
@@ -83,6 +99,365 @@ uint8_t mp_get_runtime_busy()
  *  需要注意的是，所有的数学计算都是使用单精度浮点数在绝对坐标值的情况下进行的。
  *	注意：返回的状态如果不是STAT_OK，意味着结束点不是符合要求的。因此太短而无法进行移动的线段将累计起来，并且
  *  在超过最小值之后再执行。
+ *
+ *	Collinear line merging (G64 P):
+ *	CAM output is often long runs of very short, nearly collinear lines. Each one would
+ *	take a planner buffer and a planning pass. With a G64 P tolerance set, a G1 line is
+ *	held in mm instead of being planned. Following G1 lines extend the held line as long
+ *	as every vertex they fold away stays within the tolerance of the single chord from
+ *	mm.position to the newest target. The merged block carries the Gcode state (and
+ *	line number) of its last line, which is where the block ends.
+ *
+ *	The held line is released - planned as one block - when the next line does not fit,
+ *	when anything else is queued (other motion, commands, dwells), or by mp_merge_callback()
+ *	once the queue runs short. A planner flush discards it. mm.position stays at the
+ *	chord start while a line is held.
+ *
+ *	Corner blending (G64 P):
+ *	When the next G1 line turns a corner instead, the corner itself is replaced by a
+ *	blend arc within the same tolerance (see _blend_corner()). The held line is
+ *	shortened to the start of the arc, and the next line starts at its end.
+ *
+ *	Minimum time moves:
+ *	A line that would run shorter than MIN_BLOCK_TIME is rejected (STAT_MINIMUM_TIME_MOVE)
+ *	and carried: mm.position stays at its start and its state is kept in mm.merge_gs
+ *	(free then, as nothing is held). The next line of the same kind plans from mm.position,
+ *	so it takes the carried displacement - and in G93 the carried time - into its block.
+ *	Once the accumulated length reaches the minimum the block is accepted. Anything that
+ *	cannot take the carry over - another kind of motion, commands, dwells, or the queue
+ *	running short - flushes it first as a block of its own, which mp_calculate_trapezoid()
+ *	runs as a single segment (F case). Either way the endpoint of every line is reached
+ *	and no block takes more than one buffer.
+ */
+
+stat_t mp_aline(GCodeState_t *gm_in)
+{
+#ifdef __PLANNER_TRACE
+	mp_trace_line(gm_in);
+#endif
+	if (_merge_allowed(gm_in) == true) {
+		if ((mm.merge_count != 0) && (_merge_fits(gm_in) == true)) {
+			for (uint8_t axis=0; axis<MOTION_AXES; axis++) {			// old end becomes a vertex
+				mm.merge_point[mm.merge_count-1][axis] = mm.merge_gs.target[axis];
+			}
+			mp_save_gcode_state(&mm.merge_gs, gm_in);
+			mm.merge_count++;
+			return (STAT_OK);
+		}
+		if (_blend_corner(gm_in) == false) {
+			_release_held_line();
+		}
+		_take_carry(gm_in);									// the new held line starts at mm.position
+		mp_save_gcode_state(&mm.merge_gs, gm_in);			// start a new held line
+		mm.merge_count = 1;
+		return (STAT_OK);
+	}
+	_release_held_line();
+	_take_carry(gm_in);
+	return (_plan_line(gm_in, false));
+}
+
+/*
+ * mp_release_merge() - plan the held line and any carried line
+ *
+ *	Called before anything else is queued, so the path is complete up to that point.
+ *	A held chord too short to plan is carried (see above) and flushed right behind it.
+ */
+
+void mp_release_merge()
+{
+	_release_held_line();
+	_take_carry(NULL);
+}
+
+/*
+ * _get_held_line()		- unpack the held or carried line into a full Gcode state to plan
+ * _release_held_line() - plan the held G64 P line, if there is one
+ * _carry_line()		- keep a line rejected as too short to be picked up later
+ * _take_carry()		- hand the carried line over to gm_in, or flush it if it can't take it
+ *
+ *	The held line is kept in mm as the compact state its block will carry, which has all
+ *	_plan_line() uses but the arc radius - it is planned as a straight line.
+ *
+ *	A carried line is only taken by a line of the same kind - feed or traverse, and the
+ *	same feed rate mode - as the carried displacement then runs with that line's rates.
+ *	Pass NULL to flush unconditionally.
+ */
+
+static void _get_held_line(GCodeState_t *gm)
+{
+	memset(gm, 0, sizeof(GCodeState_t));
+	mp_load_gcode_state(gm, &mm.merge_gs);
+}
+
+static void _release_held_line()
+{
+	GCodeState_t gm;
+
+	if (mm.merge_count == 0) { return; }
+	mm.merge_count = 0;
+	_get_held_line(&gm);
+	_plan_line(&gm, false);
+}
+
+static void _carry_line(const GCodeState_t *gm_in, const uint8_t inverse_time)
+{
+	float move_time = gm_in->move_time;			// includes any time carried into this line
+
+	mp_save_gcode_state(&mm.merge_gs, gm_in);
+	mm.carry = true;
+	mm.carry_time = 0;
+	if (inverse_time == true) {					// _calc_move_times() cleared G93 in the state
+		mm.merge_gs.feed_rate_mode = INVERSE_TIME_MODE;
+		mm.merge_gs.feed_rate = move_time;
+		mm.carry_time = move_time;
+	}
+}
+
+static void _take_carry(const GCodeState_t *gm_in)
+{
+	GCodeState_t gm;
+
+	if (mm.carry == false) { return; }
+	mm.carry = false;
+	if ((gm_in != NULL) &&
+		((gm_in->motion_mode == MOTION_MODE_STRAIGHT_TRAVERSE) ==
+		 (mm.merge_gs.motion_mode == MOTION_MODE_STRAIGHT_TRAVERSE)) &&
+		(gm_in->feed_rate_mode == mm.merge_gs.feed_rate_mode)) {
+		return;									// gm_in plans from mm.position and takes it
+	}
+	mm.carry_time = 0;							// already in merge_gs.feed_rate
+	_get_held_line(&gm);
+	_plan_line(&gm, true);
+}
+
+/*
+ * mp_merge_callback() - release the held or carried line before the runtime can run dry
+ *
+ *	Runs from the controller loop. Holding costs nothing while enough motion is queued.
+ *	Below PLANNER_MERGE_RELEASE_TIME the line is planned so it joins the queue in time.
+ *	A carried line waits for PLANNER_CARRY_RELEASE_TIME - the next line usually takes it.
+ *	A command waiting for the next line block is queued on its own below the merge time,
+ *	so one sent while idle or at the end of a program still runs.
+ */
+
+stat_t mp_merge_callback()
+{
+	if ((mm.merge_count == 0) && (mm.carry == false) && (mm.sync_func == NULL)) return (STAT_OK);
+	if (mp_get_planner_buffers_available() == 0) return (STAT_OK);
+
+	float queue_time = mp_get_planner_queue_time();
+	if ((queue_time < PLANNER_MERGE_RELEASE_TIME) &&
+		((mm.merge_count != 0) || (mm.sync_func != NULL) || (queue_time < PLANNER_CARRY_RELEASE_TIME))) {
+#ifdef __PLANNER_TRACE
+		mp_trace_event(TRACE_RELEASE, 0);
+#endif
+		mp_release_merge();
+		if (mp_get_planner_buffers_available() != 0) {
+			mp_release_sync_command();
+		}
+	}
+	return (STAT_OK);
+}
+
+/*
+ * _merge_allowed() - true if the line may be held for merging
+ * _merge_fits()	- true if the line can extend the held line within tolerance
+ *
+ *	Only G1 lines in G64 with a tolerance merge. The held and new lines must carry the
+ *	same state apart from target and line number, so the merged block runs the same.
+ *	A line that starts on a blend is not extended - its direction must stay on the
+ *	tangent the blend was built for.
+ *
+ *	Every interior vertex and the current chord end must lie within the tolerance of the
+ *	new chord, and project inside it so the path cannot double back. The distance is
+ *	taken from the perpendicular vector rather than |V-S|^2 - proj^2, which loses its
+ *	precision in float once the chord is a few mm long.
+ */
+
+static uint8_t _merge_allowed(const GCodeState_t *gm_in)
+{
+	return ((cm.gmx.path_tolerance > 0) &&
+			(gm_in->path_control == PATH_CONTINUOUS) &&
+			(gm_in->motion_mode == MOTION_MODE_STRAIGHT_FEED) &&
+			(gm_in->feed_rate_mode != INVERSE_TIME_MODE));
+}
+
+static uint8_t _merge_fits(const GCodeState_t *gm_in)
+{
+	const mpGCodeState_t *gm = &mm.merge_gs;
+
+	if ((mm.merge_count > PLANNER_MERGE_POINTS) ||
+		(mm.blend_vmax > 0) ||
+		(gm_in->feed_rate != gm->feed_rate) ||
+		(gm_in->feed_rate_mode != gm->feed_rate_mode) ||
+		(gm_in->select_plane != gm->select_plane) ||
+		(gm_in->units_mode != gm->units_mode) ||
+		(gm_in->coord_system != gm->coord_system) ||
+		(gm_in->distance_mode != gm->distance_mode) ||
+		(gm_in->tool != gm->tool) ||
+		(memcmp(gm_in->work_offset, gm->work_offset, sizeof(gm->work_offset)) != 0)) {
+		return (false);
+	}
+
+	float chord[MOTION_AXES];
+	float length_square = 0;
+	for (uint8_t axis=0; axis<MOTION_AXES; axis++) {
+		chord[axis] = gm_in->target[axis] - mm.position[axis];
+		length_square += square(chord[axis]);
+	}
+	float recip_length = mp_rsqrt(length_square);
+	if (recip_length == 0) { return (false); }
+	float length = length_square * recip_length;
+	for (uint8_t axis=0; axis<MOTION_AXES; axis++) {
+		chord[axis] *= recip_length;					// unit vector along the chord
+	}
+
+	float tolerance_square = square(cm.gmx.path_tolerance);
+	for (uint8_t i=0; i<mm.merge_count; i++) {
+		const float *vertex = (i < mm.merge_count-1) ? mm.merge_point[i] : gm->target;
+		float offset[MOTION_AXES];
+		float proj = 0;
+		for (uint8_t axis=0; axis<MOTION_AXES; axis++) {
+			offset[axis] = vertex[axis] - mm.position[axis];
+			proj += offset[axis] * chord[axis];
+		}
+		if ((proj < 0) || (proj > length)) { return (false); }
+		float deviation_square = 0;
+		for (uint8_t axis=0; axis<MOTION_AXES; axis++) {
+			deviation_square += square(offset[axis] - proj * chord[axis]);
+		}
+		if (deviation_square > tolerance_square) { return (false); }
+	}
+	return (true);
+}
+
+/*
+ * _blend_corner() - release the held line with its corner to the next line blended
+ *
+ *	The corner between the held line (A) and the next line (B) at vertex V is replaced
+ *	by a circular arc tangent to both lines. With phi the deflection between them:
+ *
+ *		arc deviation from V	e = R*(1-cos(phi/2))/cos(phi/2)
+ *		tangent distance		d = R*tan(phi/2)	(from V back along A and on along B)
+ *
+ *	Half the tolerance is spent on the arc (e = P/2) and the rest on the chords that
+ *	approximate it, so the path stays within P of the corner. d is limited to all of A
+ *	(whose start may already be a blend) and half of B (leaving half for its far end),
+ *	which makes R and e smaller on short lines.
+ *
+ *	The blend speed is the centripetal limit of the junction model with the arc radius,
+ *	and the jerk of running a circle at constant speed - v^3/R^2 - at the lowest jerk of
+ *	the axes involved:
+ *
+ *		Vb = min(sqrt(Aj*R), cbrt(J*R^2))
+ *
+ *	Vb replaces the junction velocity at every chord junction and at the start of B.
+ *	The corner is left alone if Vb is no better than the junction model at V would give,
+ *	if a chord would be shorter than the minimum block time, or for straight and reversal
+ *	cases. Returns true if A was released and the blend queued, false if A is still held.
+ */
+
+static uint8_t _blend_corner(const GCodeState_t *gm_in)
+{
+	GCodeState_t held;
+	GCodeState_t *gm = &held;
+	float unit_a[MOTION_AXES], unit_b[MOTION_AXES];
+	float length_a = 0, length_b = 0;
+
+	if ((mm.merge_count == 0) || (mm.merge_gs.feed_rate_mode != gm_in->feed_rate_mode)) {
+		return (false);
+	}
+	_get_held_line(gm);
+	for (uint8_t axis=0; axis<MOTION_AXES; axis++) {
+		unit_a[axis] = gm->target[axis] - mm.position[axis];
+		unit_b[axis] = gm_in->target[axis] - gm->target[axis];
+		length_a += square(unit_a[axis]);
+		length_b += square(unit_b[axis]);
+	}
+	float recip_a = mp_rsqrt(length_a);
+	float recip_b = mp_rsqrt(length_b);
+	if ((recip_a == 0) || (recip_b == 0)) { return (false); }
+	length_a *= recip_a;
+	length_b *= recip_b;
+
+	float cos_phi = 0, delta_a = 0, delta_b = 0;
+	float jerk = 8675309;								// an arbitrarily large jerk
+	for (uint8_t axis=0; axis<MOTION_AXES; axis++) {
+		unit_a[axis] *= recip_a;
+		unit_b[axis] *= recip_b;
+		cos_phi += unit_a[axis] * unit_b[axis];
+		delta_a += square(unit_a[axis] * cm.a[axis].junction_dev);
+		delta_b += square(unit_b[axis] * cm.a[axis].junction_dev);
+		if ((fp_NOT_ZERO(unit_a[axis]) || fp_NOT_ZERO(unit_b[axis])) && (cm.a[axis].jerk_max < jerk)) {
+			jerk = cm.a[axis].jerk_max;
+		}
+	}
+	if ((cos_phi > 0.99) || (cos_phi < -0.99)) { return (false); }	// straight or reversal
+
+	float cos_half = mp_sqrt((1 + cos_phi)/2);			// cos(phi/2)
+	float sin_half = mp_sqrt((1 - cos_phi)/2);			// sin(phi/2)
+	float tangent = cm.gmx.path_tolerance/2 * sin_half / (1 - cos_half);
+	tangent = min3(tangent, length_a, length_b/2);
+	float radius = tangent * cos_half / sin_half;
+	float deviation = radius * (1 - cos_half) / cos_half;
+
+	// compare to the junction model at V - its radius is delta*cos(phi/2)/(1-cos(phi/2))
+	float delta = (mp_sqrt(delta_a) + mp_sqrt(delta_b))/2;
+	float junction_velocity = mp_sqrt(delta * cos_half / (1 - cos_half) * cm.junction_acceleration);
+	float velocity = min(mp_sqrt(radius * cm.junction_acceleration),
+						 mp_cbrt(jerk * JERK_MULTIPLIER * square(radius)));
+	if (velocity <= junction_velocity) { return (false); }
+
+	// split the arc into 1, 2 or 4 chords until their sagitta fits the rest of the tolerance
+	uint8_t segments = 1;
+	float cos_step = cos_half;							// cos of half the angle of each chord
+	while ((radius * (1 - cos_step) > cm.gmx.path_tolerance - deviation) &&
+		   (segments < PLANNER_BLEND_SEGMENTS)) {
+		cos_step = mp_sqrt((1 + cos_step)/2);
+		segments *= 2;
+	}
+	float sin_step = mp_sqrt(1 - square(cos_step));
+	float feed_rate = min(gm->feed_rate, gm_in->feed_rate);
+	if (2 * radius * sin_step < feed_rate * MIN_BLOCK_TIME) { return (false); }
+
+	// release A at the arc start, then the chords
+	float normal[MOTION_AXES];									// unit normal towards the turn, in the plane of A and B
+	float recip_sin_phi = 1 / (2 * sin_half * cos_half);
+	for (uint8_t axis=0; axis<MOTION_AXES; axis++) {
+		normal[axis] = (unit_b[axis] - cos_phi * unit_a[axis]) * recip_sin_phi;
+		unit_b[axis] = gm->target[axis] + tangent * unit_b[axis];	// arc end
+		gm->target[axis] -= tangent * unit_a[axis];					// arc start
+	}
+	mm.merge_count = 0;
+	_plan_line(gm, false);
+
+	GCodeState_t blend;
+	memcpy(&blend, gm_in, sizeof(GCodeState_t));
+	blend.feed_rate = feed_rate;
+	float cos_step2 = 2 * square(cos_step) - 1;			// rotation of one chord
+	float sin_step2 = 2 * sin_step * cos_step;
+	float cos_beta = 1, sin_beta = 0;
+	for (uint8_t i=1; i<=segments; i++) {
+		float c = cos_beta * cos_step2 - sin_beta * sin_step2;
+		sin_beta = sin_beta * cos_step2 + cos_beta * sin_step2;
+		cos_beta = c;
+		for (uint8_t axis=0; axis<MOTION_AXES; axis++) {
+			blend.target[axis] = (i == segments) ? unit_b[axis] :
+				gm->target[axis] + radius * (sin_beta * unit_a[axis] + (1 - cos_beta) * normal[axis]);
+		}
+		mm.blend_vmax = velocity;
+		_plan_line(&blend, false);
+	}
+	mm.blend_vmax = velocity;							// for the start of B
+	return (true);
+}
+
+/*
+ * _plan_line() - plan one line into a planner buffer. This is the mp_aline() work proper.
+ *
+ *	A line too short to plan is carried (see mp_aline()) unless flush is set, which plans
+ *	it regardless.
  */
 /*
 #define axis_length bf->body_length
@@ -90,24 +465,29 @@ uint8_t mp_get_runtime_busy()
 #define axis_tail bf->tail_length
 #define longest_tail bf->head_length
 */
-stat_t mp_aline(GCodeState_t *gm_in)
+static stat_t _plan_line(GCodeState_t *gm_in, const uint8_t flush)
 {
 	mpBuf_t *bf; 						// current move pointer
 	float exact_stop = 0;				// preset this value OFF
 	float junction_velocity;
+	float blend_vmax = mm.blend_vmax;	// set if this line starts on a G64 P blend
 	uint8_t mr_flag = false;
+	uint16_t plan_start = hw_get_plan_timer();
+
+	mm.blend_vmax = 0;
 
 	// compute some reusable terms
-	float axis_length[AXES];
-	float axis_square[AXES];
+	float axis_length[MOTION_AXES];
+	float axis_square[MOTION_AXES];
 	float length_square = 0;
 	//计算需要移动的相对距离，以及相对距离的平方,以及总相对距离
-	for (uint8_t axis=0; axis<AXES; axis++) {
+	for (uint8_t axis=0; axis<MOTION_AXES; axis++) {
 		axis_length[axis] = gm_in->target[axis] - mm.position[axis];
 		axis_square[axis] = square(axis_length[axis]);
 		length_square += axis_square[axis];
 	}
-	float length = sqrt(length_square);
+	float recip_length = mp_rsqrt(length_square);		// 0 for a zero length move
+	float length = length_square * recip_length;
 
 	if (fp_ZERO(length)) {
 //		sr_request_status_report();
@@ -123,9 +503,13 @@ stat_t mp_aline(GCodeState_t *gm_in)
 	//	(2) Previous block is optimally planned. Vi = previous block's exit_velocity
 	//	(3) Previous block is not optimally planned. Vi <= previous block's entry_velocity + delta_velocity
 
+	uint8_t inverse_time = (gm_in->feed_rate_mode == INVERSE_TIME_MODE);
 	_calc_move_times(gm_in, axis_length, axis_square);						// set move time and minimum time in the state
-	if (gm_in->move_time < MIN_BLOCK_TIME) {
-		float delta_velocity = pow(length, 0.66666666) * mm.cbrt_jerk;		// max velocity change for this move
+	if (inverse_time == true) {
+		gm_in->move_time = max(gm_in->move_time, gm_in->feed_rate + mm.carry_time);	// G93 time of a carried line
+	}
+	if ((gm_in->move_time < MIN_BLOCK_TIME) && (flush == false)) {
+		float delta_velocity = mp_pow23(length) * mm.cbrt_jerk;		// max velocity change for this move
 		float entry_velocity = 0;											// pre-set as if no previous block
 		if ((bf = mp_get_run_buffer()) != NULL) {
 			if (bf->replannable == true) {									// not optimally planned
@@ -135,8 +519,11 @@ stat_t mp_aline(GCodeState_t *gm_in)
 			}
 		}
 		float move_time = (2 * length) / (2*entry_velocity + delta_velocity);// compute execution time for this move
-		if (move_time < MIN_BLOCK_TIME)
+		if (move_time < MIN_BLOCK_TIME) {
+			mps.min_time_moves++;
+			_carry_line(gm_in, inverse_time);
 			return (STAT_MINIMUM_TIME_MOVE);
+		}
 	}
 
 	// get a cleared buffer and setup move variables
@@ -144,7 +531,9 @@ stat_t mp_aline(GCodeState_t *gm_in)
         return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));                  // never supposed to fail
 	bf->bf_func = mp_exec_aline;										// register the callback to the exec function
 	bf->length = length;
-	memcpy(&bf->gm, gm_in, sizeof(GCodeState_t));						// copy model state into planner buffer
+	bf->arc_radius = gm_in->arc_radius;
+	bf->move_time = gm_in->move_time;
+	mp_save_gcode_state(bf->gm, gm_in);									// copy model state into the side ring
 
 	// Compute the unit vector and find the right jerk to use (combined operations)
 	// To determine the jerk value to use for the block we want to find the axis for which
@@ -204,28 +593,37 @@ stat_t mp_aline(GCodeState_t *gm_in)
 	// Finally, the selected jerk term needs to be scaled by the reciprocal of the absolute value
 	// of the jerk-limit axis's unit vector term. This way when the move is finally decomposed into
 	// its constituent axes for execution the jerk for that axis will be at it's maximum value.
+	//
+	// Acceleration is limited separately, as an axis with a low acceleration limit need not
+	// be the jerk-limit axis. Axis n reaches its limit A[n] when the move accelerates at
+	// A[n]/|U[n]|, so the move's limit is set by the largest |U[n]|/A[n] (0 if no axis has one).
 
 	float C;					// contribution term. C = T * a
 	float maxC = 0;
-	float recip_L2 = 1/length_square;
-
-	for (uint8_t axis=0; axis<AXES; axis++) {
-		if (fabs(axis_length[axis]) > 0) {								// You cannot use the fp_XXX comparisons here!
-			bf->unit[axis] = axis_length[axis] / bf->length;			// compute unit vector term (zeros are already zero)
-			C = axis_square[axis] * recip_L2 * cm.a[axis].recip_jerk;	// squaring axis_length ensures it's positive
-			if (C > maxC) {
-				maxC = C;
-				bf->jerk_axis = axis;						// also needed for junction vmax calculation
-			}
-		}
+	float recip_L2 = square(recip_length);
+	float delta = 0;			// fused junction deviation, squared
+	float recip_accel = 0;		// largest |U[n]|/A[n]
+
+	//	An axis that does not move adds zero to every term, so the loop takes all axes
+	//	without testing for them and compiles to a fixed MOTION_AXES wide kernel.
+
+	for (uint8_t axis=0; axis<MOTION_AXES; axis++) {
+		bf->unit[axis] = axis_length[axis] * recip_length;			// compute unit vector term
+		C = axis_square[axis] * recip_L2 * cm.a[axis].recip_jerk;	// squaring axis_length ensures it's positive
+		bf->jerk_axis = (C > maxC) ? axis : bf->jerk_axis;			// also needed for junction vmax calculation
+		maxC = max(C, maxC);
+		delta += square(bf->unit[axis] * cm.a[axis].junction_dev);
+		recip_accel = max(recip_accel, fabs(bf->unit[axis]) * cm.a[axis].recip_accel);
 	}
+	bf->junction_delta = mp_sqrt(delta);	// used for this junction and again for the next one
+	bf->accel = (recip_accel > 0) ? 1/recip_accel : 0;
 	// set up and pre-compute the jerk terms needed for this round of planning
 	bf->jerk = cm.a[bf->jerk_axis].jerk_max * JERK_MULTIPLIER / fabs(bf->unit[bf->jerk_axis]);	// scale the jerk
 
 	if (fabs(bf->jerk - mm.jerk) > JERK_MATCH_PRECISION) {	// specialized comparison for tolerance of delta
 		mm.jerk = bf->jerk;									// used before this point next time around
 		mm.recip_jerk = 1/bf->jerk;							// compute cached jerk terms used by planning
-		mm.cbrt_jerk = cbrt(bf->jerk);
+		mm.cbrt_jerk = mp_cbrt(bf->jerk);
 	}
 	bf->recip_jerk = mm.recip_jerk;
 	bf->cbrt_jerk = mm.cbrt_jerk;
@@ -235,17 +633,34 @@ stat_t mp_aline(GCodeState_t *gm_in)
 		bf->replannable = true;
 		exact_stop = 8675309;								// an arbitrarily large floating point number
 	}
-	bf->cruise_vmax = bf->length / bf->gm.move_time;		// target velocity requested
-	junction_velocity = _get_junction_vmax(bf->pv->unit, bf->unit);
-	bf->entry_vmax = min3(bf->cruise_vmax, junction_velocity, exact_stop);
+	bf->cruise_vset = bf->length / bf->move_time;		// target velocity requested
+	bf->cruise_vmax = _get_cruise_vmax(bf, gm_in->motion_mode);
+	if (blend_vmax > 0) {
+		junction_velocity = blend_vmax;
+	} else {
+		junction_velocity = _get_junction_vmax(bf->pv, bf);
+		if ((bf->arc_radius > 0) || (bf->pv->arc_radius > 0)) {
+			junction_velocity = _get_arc_junction_vmax(bf->pv, bf, junction_velocity);
+		}
+	}
+	bf->junction_vmax = min(junction_velocity, exact_stop);
+	bf->entry_vmax = min(bf->cruise_vmax, bf->junction_vmax);
 	bf->delta_vmax = mp_get_target_velocity(0, bf->length, bf);
 	bf->exit_vmax = min3(bf->cruise_vmax, (bf->entry_vmax + bf->delta_vmax), exact_stop);
 	bf->braking_velocity = bf->delta_vmax;
+	if (mm.sync_func != NULL) {					// a waiting S or coolant command runs at the start of this block
+		bf->cm_func = mm.sync_func;
+		bf->sync_value = mm.sync_value;
+		mm.sync_func = NULL;
+	}
 
 	// Note: these next lines must remain in exact order. Position must update before committing the buffer.
-	_plan_block_list(bf, &mr_flag);				// replan block list
-	copy_vector(mm.position, bf->gm.target);	// set the planner position
+	_plan_block_list(bf, &mr_flag, false);		// replan block list
+	copy_vector(mm.position, gm_in->target);	// set the planner position
 	mp_commit_write_buffer(MOVE_TYPE_ALINE); 	// commit current block (must follow the position update)
+	mm.carry = false;							// a carried line ends up in this block
+	mm.carry_time = 0;
+	mp_record_plan_time(plan_start);
 	return (STAT_OK);
 }
 
@@ -253,6 +668,7 @@ stat_t mp_aline(GCodeState_t *gm_in)
  * _calc_move_times()
  * _plan_block_list()
  * _get_junction_vmax()
+ * _get_arc_junction_vmax()
  * _reset_replannable_list()
  */
 
@@ -334,15 +750,21 @@ static void _calc_move_times(GCodeState_t *gms, const float axis_length[], const
 			gms->feed_rate_mode = UNITS_PER_MINUTE_MODE;
 		} else {
 			// compute length of linear move in millimeters. Feed rate is provided as mm/min
-			xyz_time = sqrt(axis_square[AXIS_X] + axis_square[AXIS_Y] + axis_square[AXIS_Z]) / gms->feed_rate;
+			xyz_time = mp_sqrt(axis_square[AXIS_X] + axis_square[AXIS_Y] + axis_square[AXIS_Z]) / gms->feed_rate;
 
+#if (MOTION_AXES > AXIS_A)
 			// if no linear axes, compute length of multi-axis rotary move in degrees. Feed rate is provided as degrees/min
 			if (fp_ZERO(xyz_time)) {
-				abc_time = sqrt(axis_square[AXIS_A] + axis_square[AXIS_B] + axis_square[AXIS_C]) / gms->feed_rate;
+				float abc_square = 0;
+				for (uint8_t axis = AXIS_A; axis < MOTION_AXES; axis++) {
+					abc_square += axis_square[axis];
+				}
+				abc_time = mp_sqrt(abc_square) / gms->feed_rate;
 			}
+#endif
 		}
 	}
-	for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+	for (uint8_t axis = AXIS_X; axis < MOTION_AXES; axis++) {
 		if (gms->motion_mode == MOTION_MODE_STRAIGHT_TRAVERSE) {
 			tmp_time = fabs(axis_length[axis]) / cm.a[axis].velocity_max;
 		} else { // MOTION_MODE_STRAIGHT_FEED
@@ -387,6 +809,7 @@ static void _calc_move_times(GCodeState_t *gms, const float axis_length[], const
  *
  *	  bf->recip_jerk		- used during trapezoid generation
  *	  bf->cbrt_jerk			- used during trapezoid generation
+ *	  bf->accel				- used during trapezoid generation and by the exec. 0 = no limit
  *
  *	Variables that will be set during processing:
  *
@@ -424,16 +847,39 @@ static void _calc_move_times(GCodeState_t *gms, const float axis_length[], const
  *
  *	[2] The mr_flag is used to tell replan to account for mr buffer's exit velocity (Vx)
  *		mr's Vx is always found in the provided bf buffer. Used to replan feedholds
+ *
+ *	[3] full_replan plans every replannable block, ignoring the planned-through watermark
+ *		[Note 4]. Feedholds and feed overrides change velocity limits all along the list,
+ *		so an unchanged braking velocity there says nothing about the blocks in front.
+ *
+ *	[4]	Adding a block can only raise the braking velocities of the blocks in front of it,
+ *		and only until a block's braking velocity exceeds its entry_vmax. From there on
+ *		min(entry_vmax, braking_velocity) is constant, so the braking velocities and the
+ *		planned velocities of all earlier blocks are unchanged. The first block found
+ *		whose braking velocity is unchanged is the planned-through watermark. Both passes
+ *		stop there, so the cost of a new block is the length of its deceleration ramp
+ *		rather than the depth of the queue. The watermark is found rather than stored,
+ *		so nothing needs invalidating when the exec frees buffers. It only holds for a
+ *		new block - everything else passes full_replan [Note 3].
  */
-static void _plan_block_list(mpBuf_t *bf, uint8_t *mr_flag)
+static void _plan_block_list(mpBuf_t *bf, uint8_t *mr_flag, uint8_t full_replan)
 {
 	mpBuf_t *bp = bf;
+	float braking_velocity;
 
 	// Backward planning pass. Find first block and update the braking velocities.
 	// At the end *bp points to the buffer before the first block.
 	while ((bp = mp_get_prev_buffer(bp)) != bf) {
 		if (bp->replannable == false) { break; }
-		bp->braking_velocity = min(bp->nx->entry_vmax, bp->nx->braking_velocity) + bp->delta_vmax;
+		braking_velocity = min(bp->nx->entry_vmax, bp->nx->braking_velocity) + bp->delta_vmax;
+
+		// Planned-through watermark [Note 4]. If the braking velocity did not change
+		// nothing before this block can change either. Plan forward from this block.
+		if ((braking_velocity == bp->braking_velocity) && (full_replan == false)) {
+			bp = mp_get_prev_buffer(bp);
+			break;
+		}
+		bp->braking_velocity = braking_velocity;
 	}
 
 	// forward planning pass - recomputes trapezoids in the list from the first block to the bf block.
@@ -458,6 +904,7 @@ static void _plan_block_list(mpBuf_t *bf, uint8_t *mr_flag)
 			  ( (bp->pv->replannable == false) &&
 				(fp_EQ(bp->exit_velocity, (bp->entry_velocity + bp->delta_vmax))) ) ) {
 			bp->replannable = false;
+			mps.optimal++;
 		}
 	}
 	// finish up the last block move
@@ -536,43 +983,113 @@ static void _reset_replannable_list()
  *	 	U[i]	Unit sum of i'th axis	fabs(unit_a[i]) + fabs(unit_b[i])
  *	 	Usum	Length of sums			Ux + Uy
  *	 	d		Delta of sums			(Dx*Ux+DY*UY)/Usum
+ *
+ *	Each block's fused delta - sqrt(sum((unit[i] * D[i])^2)) - only depends on its own
+ *	unit vector, so mp_aline() computes it once into bf->junction_delta. It is used
+ *	as the 'b' side of this junction and as the 'a' side of the next one.
  */
 
-static float _get_junction_vmax(const float a_unit[], const float b_unit[])
+static float _get_junction_vmax(const mpBuf_t *a, const mpBuf_t *b)
 {
-	float costheta = - (a_unit[AXIS_X] * b_unit[AXIS_X])
-					 - (a_unit[AXIS_Y] * b_unit[AXIS_Y])
-					 - (a_unit[AXIS_Z] * b_unit[AXIS_Z])
-					 - (a_unit[AXIS_A] * b_unit[AXIS_A])
-					 - (a_unit[AXIS_B] * b_unit[AXIS_B])
-					 - (a_unit[AXIS_C] * b_unit[AXIS_C]);
+	float costheta = 0;
+	for (uint8_t axis=0; axis<MOTION_AXES; axis++) {
+		costheta -= a->unit[axis] * b->unit[axis];
+	}
 
 	if (costheta < -0.99) { return (10000000); } 		// straight line cases
 	if (costheta > 0.99)  { return (0); } 				// reversal cases
 
-	// Fuse the junction deviations into a vector sum
-	float a_delta = square(a_unit[AXIS_X] * cm.a[AXIS_X].junction_dev);
-	a_delta += square(a_unit[AXIS_Y] * cm.a[AXIS_Y].junction_dev);
-	a_delta += square(a_unit[AXIS_Z] * cm.a[AXIS_Z].junction_dev);
-	a_delta += square(a_unit[AXIS_A] * cm.a[AXIS_A].junction_dev);
-	a_delta += square(a_unit[AXIS_B] * cm.a[AXIS_B].junction_dev);
-	a_delta += square(a_unit[AXIS_C] * cm.a[AXIS_C].junction_dev);
-
-	float b_delta = square(b_unit[AXIS_X] * cm.a[AXIS_X].junction_dev);
-	b_delta += square(b_unit[AXIS_Y] * cm.a[AXIS_Y].junction_dev);
-	b_delta += square(b_unit[AXIS_Z] * cm.a[AXIS_Z].junction_dev);
-	b_delta += square(b_unit[AXIS_A] * cm.a[AXIS_A].junction_dev);
-	b_delta += square(b_unit[AXIS_B] * cm.a[AXIS_B].junction_dev);
-	b_delta += square(b_unit[AXIS_C] * cm.a[AXIS_C].junction_dev);
-
-	float delta = (sqrt(a_delta) + sqrt(b_delta))/2;
-	float sintheta_over2 = sqrt((1 - costheta)/2);
+	float delta = (a->junction_delta + b->junction_delta)/2;
+	float sintheta_over2 = mp_sqrt((1 - costheta)/2);
 	float radius = delta * sintheta_over2 / (1-sintheta_over2);
-	float velocity = sqrt(radius * cm.junction_acceleration);
+	float velocity = mp_sqrt(radius * cm.junction_acceleration);
 //	printf ("v:%f\n", velocity);	//+++++
 	return (velocity);
 }
 
+/*
+ * _get_arc_junction_vmax() - junction velocity where one or both blocks are arc chords
+ *
+ *	Chords of an arc turn by the angle they subtend, 2*asin(L/2R), at every junction. The
+ *	junction model above only sees that angle, so it slows coarse chords of a large arc far
+ *	below what the arc allows, and passes fine chords of a small arc almost at full speed.
+ *	A junction that turns no more than an arc chord next to it does lies on the arc, and
+ *	takes the arc's own velocity limit (see _get_arc_vmax()) - running chords at that speed
+ *	gives the same centripetal acceleration on average as the arc. Sharper junctions are
+ *	real corners and keep the junction model. The cruise limit of the chords themselves
+ *	caps both ends anyway.
+ *
+ *	ARC_JUNCTION_MARGIN allows for rounding and for the shorter first and last chords.
+ */
+static float _get_arc_junction_vmax(const mpBuf_t *a, const mpBuf_t *b, float velocity)
+{
+	float cos_phi = 0;
+	for (uint8_t axis=0; axis<MOTION_AXES; axis++) {
+		cos_phi += a->unit[axis] * b->unit[axis];
+	}
+	float arc_vmax = 0;
+	const mpBuf_t *chord[2] = { a, b };
+	for (uint8_t i=0; i<2; i++) {
+		const mpBuf_t *bp = chord[i];
+		if (bp->arc_radius <= 0) { continue; }
+		float step = square(bp->length / bp->arc_radius) / 2;	// 1 - cos of the angle the chord subtends
+		if ((1 - cos_phi) <= step * ARC_JUNCTION_MARGIN) {
+			arc_vmax = max(arc_vmax, _get_arc_vmax(bp));
+		}
+	}
+	return ((arc_vmax > 0) ? arc_vmax : velocity);
+}
+
+/*
+ * _get_cruise_vmax() - cruise velocity requested for a block with the feed rate override applied
+ *
+ *	Traverses take the traverse factor, everything else the feed factor. Scaling up is
+ *	limited by the feed rate or velocity max of each axis in the move.
+ */
+static float _get_cruise_vmax(const mpBuf_t *bf, uint8_t motion_mode)
+{
+	float factor = (motion_mode == MOTION_MODE_STRAIGHT_TRAVERSE) ? mm.traverse_override : mm.feed_override;
+	float velocity = bf->cruise_vset * factor;
+
+	if (factor > 1) {
+		for (uint8_t axis=0; axis<MOTION_AXES; axis++) {
+			if (fp_ZERO(bf->unit[axis])) { continue; }
+			float axis_max = (motion_mode == MOTION_MODE_STRAIGHT_TRAVERSE) ?
+							 cm.a[axis].velocity_max : cm.a[axis].feedrate_max;
+			velocity = min(velocity, axis_max / fabs(bf->unit[axis]));
+		}
+		velocity = max(velocity, bf->cruise_vset);		// never slower than requested
+	}
+	if (bf->arc_radius > 0) {							// never faster than the arc allows
+		velocity = min(velocity, _get_arc_vmax(bf));
+	}
+	return (velocity);
+}
+
+/*
+ * _get_arc_vmax() - velocity limit for a chord of an arc from the arc radius
+ *
+ *	Running an arc of radius R at velocity V takes a centripetal acceleration of V^2/R
+ *	and a jerk of V^3/R^2. The limit is the lower of sqrt(a*R) and cbrt(J*R^2), where a
+ *	is the junction acceleration or the lowest acceleration limit of the axes in the
+ *	chord, and J the lowest jerk - the limits a G64 P corner blend runs at as well
+ *	(see _blend_corner()).
+ */
+static float _get_arc_vmax(const mpBuf_t *bf)
+{
+	float jerk = 8675309;								// an arbitrarily large jerk
+	float accel = cm.junction_acceleration;
+	for (uint8_t axis=0; axis<MOTION_AXES; axis++) {
+		if (fp_ZERO(bf->unit[axis])) { continue; }
+		jerk = min(jerk, cm.a[axis].jerk_max);
+		if (cm.a[axis].recip_accel > 0) {				// recip_accel has the ACCEL_MULTIPLIER in it
+			accel = min(accel, 1/cm.a[axis].recip_accel);
+		}
+	}
+	return (min(mp_sqrt(bf->arc_radius * accel),
+				mp_cbrt(jerk * JERK_MULTIPLIER * square(bf->arc_radius))));
+}
+
 /*************************************************************************
  * feedholds - functions for performing holds
  *
@@ -596,8 +1113,9 @@ static float _get_junction_vmax(const float a_unit[], const float b_unit[])
  *
  *	  - Hold state == PLAN tells the planner to replan the mr buffer, the current
  *		run buffer (bf), and any subsequent bf buffers as necessary to execute a
- *		hold. Hold planning replans the planner buffer queue down to zero and then
- *		back up from zero. Hold state is set to DECEL when planning is complete.
+ *		hold. Hold planning plans the deceleration down to zero and leaves the
+ *		blocks past the hold point to mp_end_hold(). Hold state is set to DECEL
+ *		when planning is complete.
  *
  *	  - Hold state == DECEL persists until the aline execution runs to zero
  *		velocity, at which point hold state transitions to HOLD.
@@ -608,9 +1126,10 @@ static float _get_junction_vmax(const float a_unit[], const float b_unit[])
  *		motion stops.
  *
  *	  - mp_end_hold() is executed from cm_feedhold_sequencing_callback() once the
- *		hold state == HOLD and a cycle_start has been requested.This sets the hold
- *		state to OFF which enables _exec_aline() to continue processing. Move
- *		execution begins with the first buffer after the hold.
+ *		hold state == HOLD and a cycle_start has been requested. It replans the
+ *		blocks after the hold up from zero and sets the hold state to OFF which
+ *		enables _exec_aline() to continue processing. Move execution begins with
+ *		the first buffer after the hold.
  *
  *	Terms used:
  *	 - mr is the runtime buffer. It was initially loaded from the bf buffer
@@ -624,6 +1143,27 @@ static float _get_junction_vmax(const float a_unit[], const float b_unit[])
  *		one buffer to go to zero, the other to replan up from zero. All buffers past
  *		that point are unaffected other than that they need to be replanned for velocity.
  *
+ *	Latency: the exec keeps running the old plan from the '!' until the segment after
+ *		the hold is planned, so the time to the first decelerating segment is about two
+ *		segments plus the time mp_plan_hold_callback() takes. That is kept bounded:
+ *
+ *	  - The braking length is closed form, L = dV^(3/2) / sqrt(Jm), and so is the
+ *		velocity each buffer sheds over its length, dV = L^(2/3) * Jm^(1/3) (see
+ *		mp_get_target_length() and mp_get_target_velocity()).
+ *	  - The buffers the decel runs through are walked once. Each becomes a pure tail
+ *		whose trapezoid is written directly - no mp_calculate_trapezoid() calls. The walk
+ *		stops at the buffer the decel ends in or at the end of the queue.
+ *	  - Nothing past the hold point is replanned here. The machine stands still until
+ *		mp_end_hold(), which plans those blocks up from zero.
+ *
+ *		The cost is a few square roots per buffer walked and does not depend on how deep
+ *		the queue is behind the hold. {pl:n} reports the worst case of both the plan
+ *		(plhp) and the request to first decel segment (plhl). host/hold_bench.c fires
+ *		holds at random points of a job and reports the distribution.
+ *
+ *		Building with PLAN_HOLD_FULL_REPLAN restores the previous planning, which replans
+ *		the whole queue with the hold in it before the decel can start.
+ *
  *	Note: There are multiple opportunities for more efficient organization of
  *		  code in this module, but the code is so complicated I just left it
  *		  organized for clarity and hoped for the best from compiler optimization.
@@ -647,36 +1187,160 @@ stat_t mp_plan_hold_callback()
 	mpBuf_t *bp; 				                // working buffer pointer
 	if ((bp = mp_get_run_buffer()) == NULL)
         return (STAT_NOOP);                     // Oops! nothing's running
+	if (mr.move_state == MOVE_OFF)
+		return (STAT_NOOP);						// between moves - bp is not loaded into mr yet
 
-	uint8_t mr_flag = true;                     // used to tell replan to account for mr buffer Vx
+	uint16_t plan_start = hw_get_plan_timer();
+	_plan_hold(bp);
+	mp_record_hold_plan_time(plan_start);
+	cm.hold_state = FEEDHOLD_DECEL;				// set state to decelerate and exit
+	return (STAT_OK);
+}
+
+#ifndef PLAN_HOLD_FULL_REPLAN
+
+/*
+ * _get_braking_velocity() - velocity left after braking from Vi over length L
+ *
+ *	The jerk term is the same from any velocity. The acceleration limit is taken as if
+ *	accelerating from Vi, which sheds no more than the limit allows on the way down.
+ */
+static float _get_braking_velocity(const float Vi, const float L, const mpBuf_t *bf)
+{
+	return (max(0, 2*Vi - mp_get_target_velocity(Vi, L, bf)));
+}
+
+/*
+ * _set_hold_tail() - make bf a pure tail from Vi to Vx over length L
+ */
+static void _set_hold_tail(mpBuf_t *bf, const float Vi, const float Vx, const float L)
+{
+	bf->length = L;
+	bf->entry_vmax = Vi;
+	bf->exit_vmax = Vx;
+	bf->entry_velocity = Vi;
+	bf->cruise_velocity = Vi;
+	bf->exit_velocity = Vx;
+	bf->head_length = 0;
+	bf->body_length = 0;
+	bf->tail_length = L;
+	bf->replannable = false;					// planned for good - mp_end_hold() starts after it
+}
+
+/*
+ * _get_mr_available_length() - length left in the move mr is running
+ *
+ *	Measured along the move. mr.position can sit off the line to mr.target by whatever
+ *	earlier moves left over (a move too short to run is dropped, not its target), and
+ *	the straight distance would count that as length along this move.
+ */
+static float _get_mr_available_length()
+{
+	float length = 0;
+	for (uint8_t axis=0; axis<MOTION_AXES; axis++) {
+		length += (mr.target[axis] - mr.position[axis]) * mr.unit[axis];
+	}
+	return (max(0, length));
+}
+
+/*
+ * _set_hold_restart() - make bf the rest of the move, to be planned up from zero
+ */
+static void _set_hold_restart(mpBuf_t *bf, const float length)
+{
+	bf->length = length;
+	bf->entry_vmax = 0;
+	bf->delta_vmax = mp_get_target_velocity(0, bf->length, bf);
+	bf->move_state = MOVE_NEW;					// tell _exec to re-use the bf buffer
+}
+
+static void _plan_hold(mpBuf_t *bp)
+{
 	float mr_available_length;                  // available length left in mr buffer for deceleration
 	float braking_velocity;                     // velocity left to shed to brake to zero
 	float braking_length;                       // distance required to brake to zero from braking_velocity
 
 	// examine and process mr buffer
-	mr_available_length = get_axis_vector_length(mr.target, mr.position);
+	mr_available_length = _get_mr_available_length();
+	braking_velocity = _compute_next_segment_velocity();
+	braking_length = mp_get_target_length(braking_velocity, 0, bp); // bp is OK to use here
 
-/*	mr_available_length =
-		(sqrt(square(mr.endpoint[AXIS_X] - mr.position[AXIS_X]) +
-			  square(mr.endpoint[AXIS_Y] - mr.position[AXIS_Y]) +
-			  square(mr.endpoint[AXIS_Z] - mr.position[AXIS_Z]) +
-			  square(mr.endpoint[AXIS_A] - mr.position[AXIS_A]) +
-			  square(mr.endpoint[AXIS_B] - mr.position[AXIS_B]) +
-			  square(mr.endpoint[AXIS_C] - mr.position[AXIS_C])));
+	// Hack to prevent Case 2 moves for perfect-fit decels. Happens in homing situations
+	// The braking velocity is the next segment's, which can be a hair above the one planned.
+	if ((braking_length > mr_available_length) && (fp_ZERO(bp->exit_velocity))) {
+		braking_length = mr_available_length;
+	}
 
-*/
+	// Case 1: deceleration fits entirely into the length remaining in mr buffer
+	if (braking_length <= mr_available_length) {
+		mr.exit_velocity = 0;					// set mr to a tail to perform the deceleration
+		mr.tail_length = braking_length;
+		mr.cruise_velocity = braking_velocity;
+		mr.section = SECTION_TAIL;
+		mr.section_state = SECTION_NEW;
+		_set_hold_restart(bp, mr_available_length - braking_length);	// bp+0 runs the rest
+		return;
+	}
+
+	// Case 2: deceleration exceeds length remaining in mr buffer
+	// Replan mr to the velocity it can reach, then walk the buffers behind it
+	mr.section = SECTION_TAIL;
+	mr.section_state = SECTION_NEW;
+	mr.tail_length = mr_available_length;
+	mr.cruise_velocity = braking_velocity;
+	mr.exit_velocity = _get_braking_velocity(braking_velocity, mr_available_length, bp);
+
+	// Each pass copies bp+1 into the redundant bp, so the one buffer left over at the
+	// end is where the move restarts. It is bounded by the buffers in the queue.
+	mpBuf_t *tail = NULL;						// last buffer made a tail (NULL = mr)
+	braking_velocity = mr.exit_velocity;
+	uint8_t stopped = fp_ZERO(mp_get_target_length(braking_velocity, 0, bp));
+	for (uint8_t i=0; i<mb.pool_size; i++) {
+		// Stop at the end of the last tail if what is left to shed would not make a move
+		// the exec runs (it skips zero length moves), or if the queue or the motion ends
+		// first. The queue was planned to stop there, so this only takes up rounding.
+		if ((stopped == true) || (bp->nx->move_state == MOVE_OFF) ||
+			(bp->nx->move_type != MOVE_TYPE_ALINE)) {
+			if (tail == NULL) {
+				mr.exit_velocity = 0;
+			} else {
+				tail->exit_vmax = 0;
+				tail->exit_velocity = 0;
+			}
+			_set_hold_restart(bp, 0);			// skip the leftover copy of the last move
+			return;
+		}
+		mp_copy_buffer(bp, bp->nx);				// copy bp+1 into bp+0 (and onward...)
+		braking_length = mp_get_target_length(braking_velocity, 0, bp);
+		if (braking_length <= bp->length) {		// decel ends in this buffer
+			float length = bp->length;
+			_set_hold_tail(bp, braking_velocity, 0, braking_length);
+			_set_hold_restart(mp_get_next_buffer(bp), length - braking_length);
+			return;
+		}
+		_set_hold_tail(bp, braking_velocity, _get_braking_velocity(braking_velocity, bp->length, bp), bp->length);
+		braking_velocity = bp->exit_velocity;	// braking velocity for next buffer
+		stopped = fp_ZERO(mp_get_target_length(braking_velocity, 0, bp));
+		tail = bp;
+		bp = mp_get_next_buffer(bp);
+	}
+}
 
-	// compute next_segment velocity
-//	braking_velocity = mr.segment_velocity;
-//	if (mr.section != SECTION_BODY) { braking_velocity += mr.forward_diff_1;}
+#else // PLAN_HOLD_FULL_REPLAN
+
+static void _plan_hold(mpBuf_t *bp)
+{
+	uint8_t mr_flag = true;                     // used to tell replan to account for mr buffer Vx
+	float mr_available_length;                  // available length left in mr buffer for deceleration
+	float braking_velocity;                     // velocity left to shed to brake to zero
+	float braking_length;                       // distance required to brake to zero from braking_velocity
+
+	// examine and process mr buffer
+	mr_available_length = get_axis_vector_length(mr.target, mr.position);
 	braking_velocity = _compute_next_segment_velocity();
 	braking_length = mp_get_target_length(braking_velocity, 0, bp); // bp is OK to use here
 
 	// Hack to prevent Case 2 moves for perfect-fit decels. Happens in homing situations
-	// The real fix: The braking velocity cannot simply be the mr.segment_velocity as this
-	// is the velocity of the last segment, not the one that's going to be executed next.
-	// The braking_velocity needs to be the velocity of the next segment that has not yet
-	// been computed. In the mean time, this hack will work.
 	if ((braking_length > mr_available_length) && (fp_ZERO(bp->exit_velocity))) {
 		braking_length = mr_available_length;
 	}
@@ -697,9 +1361,8 @@ stat_t mp_plan_hold_callback()
 		bp->move_state = MOVE_NEW;				// tell _exec to re-use the bf buffer
 
 		_reset_replannable_list();				// make it replan all the blocks
-		_plan_block_list(mp_get_last_buffer(), &mr_flag);
-		cm.hold_state = FEEDHOLD_DECEL;			// set state to decelerate and exit
-		return (STAT_OK);
+		_plan_block_list(mp_get_last_buffer(), &mr_flag, true);
+		return;
 	}
 
 	// Case 2: deceleration exceeds length remaining in mr buffer
@@ -714,7 +1377,7 @@ stat_t mp_plan_hold_callback()
 	// Find the point where deceleration reaches zero. This could span multiple buffers.
 	braking_velocity = mr.exit_velocity;		// adjust braking velocity downward
 	bp->move_state = MOVE_NEW;					// tell _exec to re-use buffer
-	for (uint8_t i=0; i<PLANNER_BUFFER_POOL_SIZE; i++) {// a safety to avoid wraparound
+	for (uint8_t i=0; i<mb.pool_size; i++) {// a safety to avoid wraparound
 		mp_copy_buffer(bp, bp->nx);				// copy bp+1 into bp+0 (and onward...)
 		if (bp->move_type != MOVE_TYPE_ALINE) {	// skip any non-move buffers
 			bp = mp_get_next_buffer(bp);		// point to next buffer
@@ -743,25 +1406,163 @@ stat_t mp_plan_hold_callback()
 	bp->exit_vmax = bp->delta_vmax;
 
 	_reset_replannable_list();					// make it replan all the blocks
-	_plan_block_list(mp_get_last_buffer(), &mr_flag);
-	cm.hold_state = FEEDHOLD_DECEL;				// set state to decelerate and exit
-	return (STAT_OK);
+	_plan_block_list(mp_get_last_buffer(), &mr_flag, true);
 }
 
+#endif // PLAN_HOLD_FULL_REPLAN
+
 /*
  * mp_end_hold() - end a feedhold
+ *
+ *	The blocks from the hold point on were left unplanned by mp_plan_hold_callback().
+ *	The exec is stopped in HOLD, so they can be planned up from zero here without racing it.
  */
 stat_t mp_end_hold()
 {
 	if (cm.hold_state == FEEDHOLD_END_HOLD) {
-		cm.hold_state = FEEDHOLD_OFF;
 		mpBuf_t *bf;
 		if ((bf = mp_get_run_buffer()) == NULL) {	// NULL means nothing's running
+			cm.hold_state = FEEDHOLD_OFF;
 			cm_set_motion_state(MOTION_STOP);
 			return (STAT_NOOP);
 		}
+		uint8_t mr_flag = true;					// plan the run buffer from its entry_vmax of zero
+		_reset_replannable_list();
+		_plan_block_list(mp_get_last_buffer(), &mr_flag, true);
+		cm.hold_state = FEEDHOLD_OFF;
 		cm.motion_state = MOTION_RUN;
 		st_request_exec_move();					// restart the steppers
 	}
 	return (STAT_OK);
 }
+
+/*************************************************************************
+ * feed rate override - rescale queued and running moves without a hold
+ *
+ * mp_feed_rate_override()	   - set new feed and traverse override factors
+ * mp_feed_override_callback() - apply them to the runtime and the queue
+ *
+ *	New blocks are planned with the current factors by _plan_line(). Blocks already in
+ *	the queue keep their requested velocity (cruise_vset) and junction limit
+ *	(junction_vmax) so their limits can be recomputed for any factor. Junction limits
+ *	are physical and are not scaled.
+ *
+ *	A change is applied in three steps, much like a feedhold:
+ *
+ *	  - The callback asks the exec to rescale the running move (OVERRIDE_SYNC). The
+ *		velocity only changes where acceleration is zero, so the exec waits until the
+ *		move is in its body. At the next body segment it replaces the rest of the move
+ *		with a new head from the current to the new cruise velocity, a body, and a tail
+ *		to the old exit velocity (or the new cruise velocity if that is lower). Both
+ *		velocity changes are jerk limited like any other head and tail. If the rest of
+ *		the move is too short for this, the move runs out as planned.
+ *
+ *	  - Once the exec has done so or given up, or the move has ended (OVERRIDE_PLAN),
+ *		the callback recomputes the velocity limits of every queued block and replans
+ *		them all. The running move is the anchor: the first queued block enters at its
+ *		exit velocity and may take that as cruise velocity where the new factor is lower.
+ *
+ *	  - Nothing is done while a feedhold is in progress. A pending change is applied
+ *		once the hold has ended.
+ */
+
+stat_t mp_feed_rate_override(float feed_factor, float traverse_factor)
+{
+	if ((feed_factor == mm.feed_override) && (traverse_factor == mm.traverse_override)) {
+		return (STAT_NOOP);
+	}
+	mm.feed_override = feed_factor;
+	mm.traverse_override = traverse_factor;
+	mm.override_pending = true;
+	return (STAT_OK);
+}
+
+stat_t mp_feed_override_callback()
+{
+	if (cm.hold_state != FEEDHOLD_OFF) {
+		return (STAT_NOOP);						// applied after the hold
+	}
+	if (mr.override_state == OVERRIDE_SYNC) {
+		if (mr.move_state == MOVE_RUN) {
+			return (STAT_NOOP);					// the exec still has it
+		}
+		mr.override_state = OVERRIDE_PLAN;		// nothing running to rescale
+	}
+	if (mr.override_state == OVERRIDE_PLAN) {
+		mr.override_state = OVERRIDE_OFF;
+		_replan_for_override();
+		return (STAT_OK);
+	}
+	if (mm.override_pending == false) {
+		return (STAT_NOOP);
+	}
+	mm.override_pending = false;
+	mr.override_state = (_request_runtime_override() == true) ? OVERRIDE_SYNC : OVERRIDE_PLAN;
+	return (STAT_OK);
+}
+
+/*
+ * _request_runtime_override() - set up the rescale of the running move for the exec
+ *
+ *	Returns false if there is nothing to rescale, or if either velocity change would be
+ *	shorter than one segment. The exec checks the remaining length itself.
+ */
+static uint8_t _request_runtime_override()
+{
+	mpBuf_t *bf = mp_get_run_buffer();
+	if ((bf == NULL) || (bf->move_type != MOVE_TYPE_ALINE)) {
+		return (false);
+	}
+	float velocity = _get_cruise_vmax(bf, bf->gm->motion_mode);
+	float exit_velocity = min(bf->exit_velocity, velocity);
+	bf->cruise_vmax = velocity;
+	if (fabs(velocity - bf->cruise_velocity) < TRAPEZOID_VELOCITY_TOLERANCE) {
+		return (false);
+	}
+	float head_length = mp_get_target_length(bf->cruise_velocity, velocity, bf);
+	float tail_length = mp_get_target_length(velocity, exit_velocity, bf);
+	if ((2*head_length < (bf->cruise_velocity + velocity) * MIN_SEGMENT_TIME) ||
+		(fp_NOT_ZERO(tail_length) && (2*tail_length < (velocity + exit_velocity) * MIN_SEGMENT_TIME))) {
+		return (false);
+	}
+	mr.override_bf = bf;
+	mr.override_entry = bf->cruise_velocity;
+	mr.override_velocity = velocity;
+	mr.override_exit = exit_velocity;
+	mr.override_head = head_length;
+	mr.override_tail = tail_length;
+	return (true);
+}
+
+/*
+ * _replan_for_override() - recompute the velocity limits of all queued blocks and replan them
+ *
+ *	This is a full replan. The planned-through watermark in _plan_block_list() would stop
+ *	the backward pass at the first block whose braking velocity comes out the same - the
+ *	first of two commands or dwells in a row works out to 0 either way - and leave every
+ *	block in front of it planned for the old factors.
+ */
+static void _replan_for_override()
+{
+	mpBuf_t *bf = mp_get_run_buffer();
+	mpBuf_t *last = mp_get_last_buffer();
+	uint8_t mr_flag = false;
+
+	if ((bf == NULL) || (bf == last)) { return; }	// nothing queued behind the running move
+
+	_reset_replannable_list();
+	bf->replannable = false;					// the running move is the anchor
+	float entry_velocity = bf->exit_velocity;
+	mpBuf_t *bp = bf;
+	do {
+		bp = mp_get_next_buffer(bp);
+		if (bp->move_type == MOVE_TYPE_ALINE) {
+			bp->cruise_vmax = max(_get_cruise_vmax(bp, bp->gm->motion_mode), entry_velocity);
+			bp->entry_vmax = min(bp->cruise_vmax, bp->junction_vmax);
+			bp->exit_vmax = (bp->gm->path_control == PATH_EXACT_STOP) ? 0 :
+							 min(bp->cruise_vmax, (bp->entry_vmax + bp->delta_vmax));
+		}
+		entry_velocity = 0;						// only the first block is tied to the runtime
+	} while (bp != last);
+	_plan_block_list(last, &mr_flag, true);
+}
@@ -0,0 +1,127 @@
+/*
+ * plan_math.c - fast float kernels for the planner
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/* See plan_math.h for the method and error bounds.
+ *
+ *	Seeds are the harmonic mean of the root at the ends of each table interval, which
+ *	puts the seed within 1% of the true root. Newton on an inverse root converges
+ *	quadratically (error goes ~1% -> 2e-4 -> 1e-7), so two steps reach float precision.
+ *
+ *	Exponent arithmetic is kept to 8 and 16 bit integer ops for the xmega:
+ *	  e = biased exponent - 127. For the cube root e + 129 = 3q + r is split with
+ *	  q = ((e + 129) * 171) >> 9, which is exact for every normal float exponent.
+ */
+#include "tinyg.h"
+#include "plan_math.h"
+
+#ifndef PLAN_MATH_LIBM
+
+typedef union {
+	float f;
+	uint32_t u;
+} mpFloatBits_t;
+
+// x^(-1/3) seeds for x in 2^r * [1 + i/16, 1 + (i+1)/16)
+static const float rcbrt_seed[3][16] PROGMEM = {
+	{ 0.9898962, 0.9706591, 0.9528357, 0.9362537, 0.9207691, 0.9062610, 0.8926263, 0.8797769,
+	  0.8676370, 0.8561407, 0.8452306, 0.8348563, 0.8249733, 0.8155424, 0.8065284, 0.7979003 },
+	{ 0.7856812, 0.7704126, 0.7562662, 0.7431050, 0.7308149, 0.7192998, 0.7084779, 0.6982794,
+	  0.6886439, 0.6795193, 0.6708600, 0.6626259, 0.6547817, 0.6472964, 0.6401420, 0.6332939 },
+	{ 0.6235956, 0.6114769, 0.6002489, 0.5898028, 0.5800482, 0.5709086, 0.5623193, 0.5542247,
+	  0.5465771, 0.5393349, 0.5324619, 0.5259265, 0.5197006, 0.5137595, 0.5080811, 0.5026457 }
+};
+
+// x^(-1/2) seeds for x in 2^r * [1 + i/16, 1 + (i+1)/16)
+static const float rsqrt_seed[2][16] PROGMEM = {
+	{ 0.9848450, 0.9562805, 0.9300661, 0.9058961, 0.8835179, 0.8627205, 0.8433261, 0.8251837,
+	  0.8081641, 0.7921561, 0.7770633, 0.7628016, 0.7492975, 0.7364861, 0.7243103, 0.7127191 },
+	{ 0.6963906, 0.6761924, 0.6576560, 0.6405653, 0.6247415, 0.6100355, 0.5963216, 0.5834930,
+	  0.5714583, 0.5601390, 0.5494667, 0.5393822, 0.5298333, 0.5207743, 0.5121647, 0.5039685 }
+};
+
+/*
+ * mp_rcbrt() - x^(-1/3) for x > 0
+ */
+float mp_rcbrt(float x)
+{
+	mpFloatBits_t b;
+
+	if (!(x > 0)) return (0);
+	b.f = x;
+	uint16_t n = (uint8_t)(b.u >> 23) + 2;			// e + 129
+	uint8_t q = (n * 171) >> 9;						// (e + 129) / 3
+	uint8_t r = n - 3*q;							// e mod 3
+	uint8_t i = (b.u >> 19) & 0x0F;					// top 4 mantissa bits
+
+	b.u = (uint32_t)(170 - q) << 23;				// 2^-(q-43)
+	float z = pgm_read_float(&rcbrt_seed[r][i]) * b.f;
+	float x_3 = x * (float)(1.0/3.0);
+
+	z = z * ((float)(4.0/3.0) - x_3 * z*z*z);		// Newton: z = z*(4 - x*z^3)/3
+	z = z * ((float)(4.0/3.0) - x_3 * z*z*z);
+	return (z);
+}
+
+/*
+ * mp_rsqrt() - x^(-1/2) for x > 0
+ */
+float mp_rsqrt(float x)
+{
+	mpFloatBits_t b;
+
+	if (!(x > 0)) return (0);
+	b.f = x;
+	uint8_t n = (uint8_t)(b.u >> 23) + 1;			// e + 128
+	uint8_t q = n >> 1;
+	uint8_t r = n & 1;
+	uint8_t i = (b.u >> 19) & 0x0F;
+
+	b.u = (uint32_t)(191 - q) << 23;				// 2^-(q-64)
+	float z = pgm_read_float(&rsqrt_seed[r][i]) * b.f;
+	float x_2 = x * (float)0.5;
+
+	z = z * ((float)1.5 - x_2 * z*z);				// Newton: z = z*(3 - x*z^2)/2
+	z = z * ((float)1.5 - x_2 * z*z);
+	return (z);
+}
+
+/*
+ * mp_pow23() - x^(2/3) for x >= 0
+ * mp_cbrt()  - x^(1/3)
+ * mp_sqrt()  - x^(1/2) for x >= 0
+ */
+float mp_pow23(float x)
+{
+	return (x * mp_rcbrt(x));
+}
+
+float mp_cbrt(float x)
+{
+	if (x < 0) return (-mp_cbrt(-x));
+	float z = mp_rcbrt(x);
+	return (x * z * z);
+}
+
+#ifndef __AVR_ARCH__
+float mp_sqrt(float x)
+{
+	return (x * mp_rsqrt(x));
+}
+#endif
+
+#endif // PLAN_MATH_LIBM
@@ -0,0 +1,62 @@
+/*
+ * plan_math.h - fast float kernels for the planner
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ * The planner needs L^(2/3) and Jm^(1/3) for every block. pow() and cbrt() are
+ * very slow in soft float, so these kernels work on the float bit pattern instead:
+ *
+ *	  - split x into 2^e * m, with m in [1,2)
+ *	  - seed the result from a 16 entry table over m (per residue of e)
+ *	  - refine with two Newton-Raphson steps that use only multiplies
+ *
+ * The inverse roots are the kernels; the others are one or two multiplies away:
+ *	  x^(2/3) = x * x^(-1/3)	cbrt(x) = x * x^(-1/3)^2	sqrt(x) = x * x^(-1/2)
+ *
+ * Error is bounded at a few ulps for positive normal floats (see host/math_bench.c).
+ * Zero and negative inputs return 0, except mp_cbrt() which keeps the sign.
+ * Denormals, inf and nan are not handled - the planner never produces them here.
+ *
+ * mp_sqrt() uses the library sqrt() on the xmega. avr-libc's sqrt is a hand coded
+ * bit-by-bit routine that beats two soft float Newton steps. Define PLAN_MATH_LIBM
+ * to route all four through libm, e.g. to compare planner results. mp_rsqrt(0)
+ * returns 0 in either build - mp_aline() relies on it for zero length moves.
+ */
+#ifndef PLAN_MATH_H_ONCE
+#define PLAN_MATH_H_ONCE
+
+#ifdef PLAN_MATH_LIBM
+static inline float mp_pow23(float x) { return (pow(x, 0.66666666));}
+static inline float mp_cbrt(float x)  { return (cbrt(x));}
+static inline float mp_sqrt(float x)  { return (sqrt(x));}
+static inline float mp_rsqrt(float x) { return ((x > 0) ? 1/sqrt(x) : 0);}
+#else
+
+float mp_rcbrt(float x);			// x^(-1/3)
+float mp_rsqrt(float x);			// x^(-1/2)
+float mp_pow23(float x);			// x^(2/3)
+float mp_cbrt(float x);				// x^(1/3)
+
+#ifdef __AVR_ARCH__
+#define mp_sqrt(x) ((float)sqrt(x))
+#else
+float mp_sqrt(float x);				// x^(1/2)
+#endif
+
+#endif // PLAN_MATH_LIBM
+
+#endif // End of include guard: PLAN_MATH_H_ONCE
@@ -29,6 +29,7 @@
 #include "tinyg.h"
 #include "config.h"
 #include "planner.h"
+#include "plan_math.h"
 #include "report.h"
 #include "util.h"
 
@@ -98,7 +99,7 @@
  *
  *	  Rate-Limited cases - Ve and Vx can be satisfied but Vt cannot
  *	  	HT	(Ve=Vx)<Vt	symmetric case. Split the length and compute Vt.
- *	  	HT'	(Ve!=Vx)<Vt	asymmetric case. Find H and T by successive approximation.
+ *	  	HT'	(Ve!=Vx)<Vt	asymmetric case. Solve for Vt with a fixed step solver.
  *		HBT'			body length < min body length - treated as an HT case
  *		H'				body length < min body length - subsume body into head length
  *		T'				body length < min body length - subsume body into tail length
@@ -113,6 +114,8 @@
  *	  shortest cases first and work up. Not only does this simplify the order of the tests,
  *	  but it reduces execution time when you need it most - when tons of pathologically
  *	  short Gcode blocks are being thrown at you.
+ *
+ *	Each outcome is counted in mps.zoid[] for the {pl:...} report (see mpZoidCase).
  */
 
 // The minimum lengths are dynamic and depend on the velocity
@@ -122,6 +125,9 @@
 #define MIN_TAIL_LENGTH (MIN_SEGMENT_TIME_PLUS_MARGIN * (bf->cruise_velocity + bf->exit_velocity))
 #define MIN_BODY_LENGTH (MIN_SEGMENT_TIME_PLUS_MARGIN * bf->cruise_velocity)
 
+static float _get_ht_cruise_velocity(const mpBuf_t *bf);
+static float _get_accel_cruise_velocity(const mpBuf_t *bf, const float velocity_max);
+
 void mp_calculate_trapezoid(mpBuf_t *bf)
 {
 	//********************************************
@@ -136,21 +142,22 @@ void mp_calculate_trapezoid(mpBuf_t *bf)
 	// Accept the entry velocity, limit the cruise, and go for the best exit velocity
 	// you can get given the delta_vmax (maximum velocity slew) supportable.
 
-	bf->naiive_move_time = 2 * bf->length / (bf->entry_velocity + bf->exit_velocity); // average
+	float naiive_move_time = 2 * bf->length / (bf->entry_velocity + bf->exit_velocity); // average
 
-	if (bf->naiive_move_time < MIN_SEGMENT_TIME_PLUS_MARGIN) {
+	if (naiive_move_time < MIN_SEGMENT_TIME_PLUS_MARGIN) {
 		bf->cruise_velocity = bf->length / MIN_SEGMENT_TIME_PLUS_MARGIN;
 		bf->exit_velocity = max(0.0, min(bf->cruise_velocity, (bf->entry_velocity - bf->delta_vmax)));
 		bf->body_length = bf->length;
 		bf->head_length = 0;
 		bf->tail_length = 0;
 		// We are violating the jerk value but since it's a single segment move we don't use it.
+		mps.zoid[ZOID_F]++;
 		return;
 	}
 
 	// B" case: Block is short, but fits into a single body segment
 
-	if (bf->naiive_move_time <= NOM_SEGMENT_TIME) {
+	if (naiive_move_time <= NOM_SEGMENT_TIME) {
 		bf->entry_velocity = bf->pv->exit_velocity;
 		if (fp_NOT_ZERO(bf->entry_velocity)) {
 			bf->cruise_velocity = bf->entry_velocity;
@@ -163,6 +170,7 @@ void mp_calculate_trapezoid(mpBuf_t *bf)
 		bf->head_length = 0;
 		bf->tail_length = 0;
 		// We are violating the jerk value but since it's a single segment move we don't use it.
+		mps.zoid[ZOID_B2]++;
 		return;
 	}
 
@@ -175,6 +183,7 @@ void mp_calculate_trapezoid(mpBuf_t *bf)
 		bf->body_length = bf->length;
 		bf->head_length = 0;
 		bf->tail_length = 0;
+		mps.zoid[ZOID_B]++;
 		return;
 	}
 
@@ -189,6 +198,9 @@ void mp_calculate_trapezoid(mpBuf_t *bf)
 		if (bf->entry_velocity > bf->exit_velocity)	{		// tail-only cases (short decelerations)
 			if (bf->length < minimum_length) { 				// T" (degraded case)
 				bf->entry_velocity = mp_get_target_velocity(bf->exit_velocity, bf->length, bf);
+				mps.zoid[ZOID_T2]++;
+			} else {
+				mps.zoid[ZOID_T]++;
 			}
 			bf->cruise_velocity = bf->entry_velocity;
 			bf->tail_length = bf->length;
@@ -199,6 +211,9 @@ void mp_calculate_trapezoid(mpBuf_t *bf)
 		if (bf->entry_velocity < bf->exit_velocity)	{		// head-only cases (short accelerations)
 			if (bf->length < minimum_length) { 				// H" (degraded case)
 				bf->exit_velocity = mp_get_target_velocity(bf->entry_velocity, bf->length, bf);
+				mps.zoid[ZOID_H2]++;
+			} else {
+				mps.zoid[ZOID_H]++;
 			}
 			bf->cruise_velocity = bf->exit_velocity;
 			bf->head_length = bf->length;
@@ -217,7 +232,9 @@ void mp_calculate_trapezoid(mpBuf_t *bf)
 	if (bf->length < (bf->head_length + bf->tail_length)) { // it's rate limited
 
 		// Symmetric rate-limited case (HT)
-		if (fabs(bf->entry_velocity - bf->exit_velocity) < TRAPEZOID_VELOCITY_TOLERANCE) {
+		// Not with an acceleration limit: splitting the length evenly shortchanges the larger
+		// of the two velocity changes, which then runs over the limit. HT' splits it properly.
+		if ((bf->accel == 0) && (fabs(bf->entry_velocity - bf->exit_velocity) < TRAPEZOID_VELOCITY_TOLERANCE)) {
 			bf->head_length = bf->length/2;
 			bf->tail_length = bf->head_length;
 			bf->cruise_velocity = min(bf->cruise_vmax, mp_get_target_velocity(bf->entry_velocity, bf->head_length, bf));
@@ -233,27 +250,36 @@ void mp_calculate_trapezoid(mpBuf_t *bf)
 				bf->entry_velocity = bf->cruise_velocity;
 				bf->exit_velocity = bf->cruise_velocity;
 			}
+			mps.zoid[ZOID_HT]++;
 			return;
 		}
 
-		// Asymmetric HT' rate-limited case. This is relatively expensive but it's not called very often
-		// iteration trap: uint8_t i=0;
-		// iteration trap: if (++i > TRAPEZOID_ITERATION_MAX) { fprintf_P(stderr,PSTR("_calculate_trapezoid() failed to converge"));}
-
+		// Asymmetric HT' rate-limited case. Fixed cost - see _get_ht_cruise_velocity()
+#ifndef PLAN_ZOID_ITERATIVE
+		float computed_velocity = _get_ht_cruise_velocity(bf);
+		if (bf->accel > 0) {
+			computed_velocity = _get_accel_cruise_velocity(bf, computed_velocity);
+		}
+#else	// previous successive approximation, kept for comparison (see host/zoid_bench.c)
 		float computed_velocity = bf->cruise_vmax;
-		do {
-			bf->cruise_velocity = computed_velocity;	// initialize from previous iteration
-			bf->head_length = mp_get_target_length(bf->entry_velocity, bf->cruise_velocity, bf);
-			bf->tail_length = mp_get_target_length(bf->exit_velocity, bf->cruise_velocity, bf);
-			if (bf->head_length > bf->tail_length) {
-				bf->head_length = (bf->head_length / (bf->head_length + bf->tail_length)) * bf->length;
-				computed_velocity = mp_get_target_velocity(bf->entry_velocity, bf->head_length, bf);
-			} else {
-				bf->tail_length = (bf->tail_length / (bf->head_length + bf->tail_length)) * bf->length;
-				computed_velocity = mp_get_target_velocity(bf->exit_velocity, bf->tail_length, bf);
-			}
-			// insert iteration trap here if needed
-		} while ((fabs(bf->cruise_velocity - computed_velocity) / computed_velocity) > TRAPEZOID_ITERATION_ERROR_PERCENT);
+		if (bf->accel > 0) {
+			computed_velocity = _get_accel_cruise_velocity(bf, bf->cruise_vmax);
+		} else {
+			do {
+				bf->cruise_velocity = computed_velocity;	// initialize from previous iteration
+				bf->head_length = mp_get_target_length(bf->entry_velocity, bf->cruise_velocity, bf);
+				bf->tail_length = mp_get_target_length(bf->exit_velocity, bf->cruise_velocity, bf);
+				if (bf->head_length > bf->tail_length) {
+					bf->head_length = (bf->head_length / (bf->head_length + bf->tail_length)) * bf->length;
+					computed_velocity = mp_get_target_velocity(bf->entry_velocity, bf->head_length, bf);
+				} else {
+					bf->tail_length = (bf->tail_length / (bf->head_length + bf->tail_length)) * bf->length;
+					computed_velocity = mp_get_target_velocity(bf->exit_velocity, bf->tail_length, bf);
+				}
+				// insert iteration trap here if needed
+			} while ((fabs(bf->cruise_velocity - computed_velocity) / computed_velocity) > TRAPEZOID_ITERATION_ERROR_PERCENT);
+		}
+#endif
 
 		// set velocity and clean up any parts that are too short
 		bf->cruise_velocity = computed_velocity;
@@ -267,10 +293,12 @@ void mp_calculate_trapezoid(mpBuf_t *bf)
 			bf->head_length = bf->length;			//...or all head
 			bf->tail_length = 0;
 		}
+		mps.zoid[ZOID_HT_ASYM]++;
 		return;
 	}
 
 	// Requested-fit cases: remaining of: HBT, HB, BT, BT, H, T, B, cases
+	mps.zoid[ZOID_HBT]++;
 	bf->body_length = bf->length - bf->head_length - bf->tail_length;
 
 	// If a non-zero body is < minimum length distribute it to the head and/or tail
@@ -296,6 +324,85 @@ void mp_calculate_trapezoid(mpBuf_t *bf)
 	}
 }
 
+/*
+ * _get_ht_cruise_velocity() - HT' cruise velocity from the jerk limit, at a fixed cost
+ *
+ *	Head and tail must add up to the move: (Vt-Ve)^(3/2) + (Vt-Vx)^(3/2) = L * sqrt(Jm).
+ *	Scaled by Vl = L^(2/3) * Jm^(1/3), the velocity a head over all of L would gain, with
+ *	d = |Ve-Vx|/Vl and u = (Vt - max(Ve,Vx))/Vl this is
+ *
+ *	  F(u) = u^(3/2) + (u+d)^(3/2) = 1		with 0 <= d < 1 here (H' and T' took the rest)
+ *
+ *	F is increasing and convex, and u lies in [max(0, c-d), c] with c = 2^(-2/3) (the root
+ *	for d = 0). On a convex function a Newton step from above stays above the root and a
+ *	chord from below stays below it, so two steps of each close the bracket from both ends.
+ *	The low end is returned, so the head and tail always fit.
+ *
+ *	Cost is 10 square roots and one mp_pow23(), every time. Over all d the result is at
+ *	most 5e-5 below the exact Vt, and above it by no more than float rounding (see
+ *	host/zoid_bench.c). The successive approximation this replaces stopped within 10%,
+ *	on either side, after a data dependent number of passes.
+ */
+#define HT_ROOT_D0			((float)0.62996052)		// 2^(-2/3)
+#define HT_SOLVER_STEPS		2
+
+static float _get_ht_length(const float u, const float d, float *slope)
+{
+	float su = mp_sqrt(u);
+	float sd = mp_sqrt(u + d);
+	*slope = 1.5 * (su + sd);						// F'(u)
+	return (u*su + (u + d)*sd);						// F(u)
+}
+
+static float _get_ht_cruise_velocity(const mpBuf_t *bf)
+{
+	float velocity_max = max(bf->entry_velocity, bf->exit_velocity);
+	float scale = mp_pow23(bf->length) * bf->cbrt_jerk;
+	float d = fabs(bf->entry_velocity - bf->exit_velocity) / scale;
+	if (d >= 1) { return (velocity_max); }			// guard - can't fit more than the velocity change
+
+	float slope, unused;
+	float hi = HT_ROOT_D0;
+	float lo = max(0, hi - d);
+	float F_hi = _get_ht_length(hi, d, &slope);
+	float F_lo = _get_ht_length(lo, d, &unused);
+
+	for (uint8_t i=0; i<HT_SOLVER_STEPS; i++) {
+		hi -= (F_hi - 1) / slope;					// Newton from above
+		F_hi = _get_ht_length(hi, d, &slope);
+		if (F_hi <= F_lo) { break; }				// bracket has closed to float precision
+		lo += (1 - F_lo) * (hi - lo) / (F_hi - F_lo);	// chord from below
+		if (i < HT_SOLVER_STEPS-1) { F_lo = _get_ht_length(lo, d, &unused); }
+	}
+	return (min(bf->cruise_vmax, velocity_max + lo * scale));
+}
+
+/*
+ * _get_accel_cruise_velocity() - HT' cruise velocity for a move with an acceleration limit
+ *
+ *	The acceleration limit only lengthens heads and tails, so the jerk-only velocity is an
+ *	upper bound. With the limit the lengths are no longer a power of dV, so bisect between
+ *	max(Ve,Vx) and that bound for the highest cruise velocity whose head and tail fit -
+ *	TRAPEZOID_ITERATION_MAX halvings, a fixed cost. The low end of the bracket is returned
+ *	so the tail is never shorter than it needs to be.
+ */
+static float _get_accel_cruise_velocity(const mpBuf_t *bf, const float velocity_max)
+{
+	float lo = max(bf->entry_velocity, bf->exit_velocity);
+	float hi = velocity_max;
+
+	for (uint8_t i=0; i<TRAPEZOID_ITERATION_MAX; i++) {
+		float velocity = (lo + hi) / 2;
+		if ((mp_get_target_length(bf->entry_velocity, velocity, bf) +
+			 mp_get_target_length(bf->exit_velocity, velocity, bf)) > bf->length) {
+			hi = velocity;
+		} else {
+			lo = velocity;
+		}
+	}
+	return (lo);
+}
+
 /*
  * mp_get_target_length()	  - derive accel/decel length from delta V and jerk
  * mp_get_target_velocity() - derive velocity achievable from delta V and length
@@ -337,12 +444,63 @@ void mp_calculate_trapezoid(mpBuf_t *bf)
  *
  *  FYI: Here's an expression that returns the jerk for a given deltaV and L:
  * 	return(cube(deltaV / (pow(L, 0.66666666))));
+ *
+ *	Acceleration limit (bf->accel = Am > 0):
+ *
+ *	The exec derives the section time from its length, T = 2*L/(Vi+Vf), and its S-curve
+ *	peaks at an acceleration of 1.875*dV/T (ACCEL_PEAK_FACTOR). When that is more than Am
+ *	the exec holds Am through the middle of the section - a 7-segment profile - which
+ *	needs T >= dV/Am + Am/Jm for the jerk phases at either end. So the section must last
+ *
+ *	 f)	Ta = min(1.875*dV, dV + Am^2/Jm) / Am
+ *
+ *	and the length is the larger of c') and the length covered in Ta:
+ *
+ *	 g)	L = max(dV * sqrt(dV/Jm), (Vi+Vf)/2 * Ta)
+ *
+ *	Both terms grow with dV. mp_get_target_velocity() inverts the jerk term c') as before
+ *	and the Am term of g) in _get_accel_velocity(), and takes the smaller of the two dV.
+ *	The Am term's section time f) is the shorter of two, so its dV is the larger of the
+ *	roots for each of them. With a high Am the jerk term always wins and the results are
+ *	the same as without the limit.
  */
 
 float mp_get_target_length(const float Vi, const float Vf, const mpBuf_t *bf)
 {
+	float delta_v = fabs(Vi-Vf);
 //	return (Vi + Vf) * sqrt(fabs(Vf - Vi) * bf->recip_jerk);		// new formula
-	return (fabs(Vi-Vf) * sqrt(fabs(Vi-Vf) * bf->recip_jerk));		// old formula
+	float length = delta_v * mp_sqrt(delta_v * bf->recip_jerk);	// old formula
+
+	if (bf->accel > 0) {
+		float accel_time = min(ACCEL_PEAK_FACTOR * delta_v, delta_v + square(bf->accel) * bf->recip_jerk) / bf->accel;
+		length = max(length, (Vi + Vf)/2 * accel_time);
+	}
+	return (length);
+}
+
+/*
+ * _get_accel_velocity() - velocity change allowed by the acceleration limit over length L
+ *
+ *	Solves g) for dV with each term of f) and returns the larger dV - the shorter section
+ *	time allows the larger velocity change. Both are quadratics in dV with one positive
+ *	root, taken in the form that does not cancel when Vi is large:
+ *
+ *	  S-curve only:	0.9375*dV^2 + 1.875*Vi*dV - Am*L = 0
+ *	  7-segment:	dV^2 + (2*Vi + R)*dV + 2*Vi*R - 2*Am*L = 0		R = Am^2/Jm
+ */
+static float _get_accel_velocity(const float Vi, const float L, const mpBuf_t *bf)
+{
+	float accel_length = bf->accel * L;
+	float b = ACCEL_PEAK_FACTOR * Vi;
+	float delta_v = 2*accel_length / (b + mp_sqrt(square(b) + 2*ACCEL_PEAK_FACTOR * accel_length));
+
+	float R = square(bf->accel) * bf->recip_jerk;
+	float c = 2 * (Vi*R - accel_length);
+	if (c < 0) {
+		b = 2*Vi + R;
+		delta_v = max(delta_v, -2*c / (b + mp_sqrt(square(b) - 4*c)));
+	}
+	return (delta_v);
 }
 
 /* Regarding mp_get_target_velocity:
@@ -393,7 +551,7 @@ float mp_get_target_length(const float Vi, const float Vf, const mpBuf_t *bf)
 float mp_get_target_velocity(const float Vi, const float L, const mpBuf_t *bf)
 {
     // 0 iterations (a reasonable estimate)
-    float estimate = pow(L, 0.66666666) * bf->cbrt_jerk + Vi;
+    float estimate = mp_pow23(L) * bf->cbrt_jerk + Vi;
 
 #if (GET_VELOCITY_ITERATIONS >= 1)
     // 1st iteration
@@ -409,5 +567,8 @@ float mp_get_target_velocity(const float Vi, const float L, const mpBuf_t *bf)
     J_d = (2*Vi*estimate - Vi_squared + 3*(estimate*estimate)) / L_squared;
     estimate = estimate - J_z/J_d;
 #endif
+	if (bf->accel > 0) {
+		estimate = min(estimate, Vi + _get_accel_velocity(Vi, L, bf));
+	}
     return estimate;
 }
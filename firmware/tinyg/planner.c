@@ -52,6 +52,7 @@
 #include "kinematics.h"
 #include "stepper.h"
 #include "encoder.h"
+#include "hardware.h"
 #include "report.h"
 #include "util.h"
 /*
@@ -61,32 +62,78 @@ extern "C"{
 */
 // 分配规划器结构体 
 
-mpBufferPool_t mb;				// move buffer queue 移动buffer队列
-mpMoveMasterSingleton_t mm;		// context for line planning 规划状态,当前规划到哪里了
-mpMoveRuntimeSingleton_t mr;	// context for line runtime 
+THREAD_LOCAL mpBufferPool_t mb;				// move buffer queue 移动buffer队列
+THREAD_LOCAL mpMoveMasterSingleton_t mm;		// context for line planning 规划状态,当前规划到哪里了
+THREAD_LOCAL mpMoveRuntimeSingleton_t mr;	// context for line runtime 
+THREAD_LOCAL mpPlannerStats_t mps;			// planner statistics
+#ifndef PLANNER_HEAP_POOL
+static THREAD_LOCAL mpBuf_t mp_pool[PLANNER_BUFFER_POOL_SIZE];	// static buffer storage - caps the pool size
+static THREAD_LOCAL mpGCodeState_t mp_pool_gm[PLANNER_BUFFER_POOL_SIZE];	// Gcode state side ring storage
+#endif
+
+#ifdef __AVR_XMEGA__	// the default pool and the merge state must fit in the RAM of 32 buffers that each embed a GCodeState_t
+_Static_assert(PLANNER_BUFFER_POOL_DEFAULT * (sizeof(mpBuf_t) + sizeof(mpGCodeState_t)) +
+			   sizeof(mm.merge_point) + sizeof(mm.merge_gs) <=
+			   32 * (sizeof(mpBuf_t) - sizeof(mpGCodeState_t *) + sizeof(GCodeState_t)),
+			   "PLANNER_BUFFER_POOL_DEFAULT buffers and the G64 P merge state take more RAM than 32 buffers with a GCodeState_t");
+#endif
 
 /*
  * Local Scope Data and Functions
  */
-#define _bump(a) ((a<PLANNER_BUFFER_POOL_SIZE-1)?(a+1):0) // buffer incr & wrap
+#define _bump(a) ((a<mb.pool_size-1)?(a+1):0) // buffer incr & wrap
 #define spindle_speed move_time	// local alias for spindle_speed to the time variable
-#define value_vector gm.target	// alias for vector of values
+#define value_vector gm->target	// alias for vector of values
 #define flag_vector unit		// alias for vector of flags
 
 // execution routines (NB: These are all called from the LO interrupt)
 //回调函数，用于执行dwell（停留）和用户定义的功能函数。
 static stat_t _exec_dwell(mpBuf_t *bf);
 static stat_t _exec_command(mpBuf_t *bf);
+static void _queue_command(cm_exec_t cm_exec, float *value, float *flag);
 
 /*
- * planner_init()
+ * planner_init() - init the planner and size the buffer pool
+ *
+ *	pool_size is the number of planner buffers. It is raised to PLANNER_BUFFER_POOL_MIN
+ *	and on the AVR limited to the static storage (PLANNER_BUFFER_POOL_SIZE).
+ *	The size holds until the next planner_init() - flushes keep it.
+ *
+ *	A heap pool (PLANNER_HEAP_POOL, see planner.h) that can't be resized keeps the
+ *	buffers it had. If that is less than the minimum - there was no pool before - it
+ *	raises a hard alarm and leaves the planner without buffers.
  */
-void planner_init()
+void planner_init(uint8_t pool_size)
 {
 // If you know all memory has been zeroed by a hard reset you don't need these next 2 lines
 	memset(&mr, 0, sizeof(mr));	// clear all values, pointers and status
 	memset(&mm, 0, sizeof(mm));	// clear all values, pointers and status
 	planner_init_assertions();
+	mm.feed_override = 1;
+	mm.traverse_override = 1;
+	mp_clear_stats();
+
+	pool_size = max(pool_size, PLANNER_BUFFER_POOL_MIN);
+#ifndef PLANNER_HEAP_POOL
+	mb.bf = mp_pool;
+	mb.gm = mp_pool_gm;
+	mb.pool_size = min(pool_size, PLANNER_BUFFER_POOL_SIZE);
+#else
+	mpBuf_t *bf = (mpBuf_t *)realloc(mb.bf, pool_size * sizeof(mpBuf_t));
+	if (bf != NULL) { mb.bf = bf;}
+	mpGCodeState_t *gm = (mpGCodeState_t *)realloc(mb.gm, pool_size * sizeof(mpGCodeState_t));
+	if (gm != NULL) { mb.gm = gm;}
+
+	if ((bf == NULL) || (gm == NULL)) {				// a failed realloc() leaves the old array
+		pool_size = min(pool_size, mb.pool_size);
+		if (pool_size < PLANNER_BUFFER_POOL_MIN) {
+			mb.pool_size = 0;
+			cm_hard_alarm(STAT_MEMORY_FAULT);
+			return;
+		}
+	}
+	mb.pool_size = pool_size;
+#endif // PLANNER_HEAP_POOL
 	mp_init_buffers();
 }
 
@@ -110,6 +157,123 @@ stat_t planner_test_assertions()
 	return (STAT_OK);
 }
 
+/*
+ * mp_clear_stats() 	 - zero the planner statistics ({clp:1}, see report.c)
+ * mp_record_plan_time() - count a planned block and the time since start
+ *
+ *	Counters are bumped where the events happen: trapezoid cases in plan_zoid.c, blocks,
+ *	minimum time moves and non-replannable marks in plan_line.c, starvation in
+ *	mp_free_run_buffer(). Planning time is taken per block - one mp_aline() call unless
+ *	G64 P merges or blends lines. Times are in hw_get_plan_timer() ticks of PLAN_TIMER_USEC.
+ *	The timer is 16 bits so a block that takes longer than ~130 ms on the xmega wraps.
+ *
+ * mp_record_hold_plan_time() - count a planned feedhold and the time since start
+ * mp_start_hold_timer() - stamp a feedhold request (called from the RX ISR via cm_request_feedhold)
+ * mp_record_hold_time() - time from the request to the first decelerating segment of the hold
+ */
+void mp_clear_stats()
+{
+	memset(&mps, 0, sizeof(mps));
+	mps.plan_ticks_min = 0xFFFF;
+}
+
+void mp_record_plan_time(uint16_t start)
+{
+	uint16_t ticks = hw_get_plan_timer() - start;
+
+	mps.blocks++;
+	mps.plan_ticks += ticks;
+	if (ticks < mps.plan_ticks_min) { mps.plan_ticks_min = ticks;}
+	if (ticks > mps.plan_ticks_max) { mps.plan_ticks_max = ticks;}
+}
+
+void mp_record_hold_plan_time(uint16_t start)
+{
+	uint16_t ticks = hw_get_plan_timer() - start;
+
+	mps.holds++;
+	if (ticks > mps.hold_plan_ticks_max) { mps.hold_plan_ticks_max = ticks;}
+}
+
+void mp_start_hold_timer()
+{
+	mps.hold_start = hw_get_plan_timer();
+	mps.hold_timing = true;
+}
+
+void mp_record_hold_time()
+{
+	uint16_t ticks = hw_get_plan_timer() - mps.hold_start;
+
+	mps.hold_timing = false;
+	if (ticks > mps.hold_ticks_max) { mps.hold_ticks_max = ticks;}
+}
+
+/*
+ * mp_trace_header() - record the settings planning depends on (see planner.h)
+ * mp_trace_line()	 - record an mp_aline() input before mp_aline() changes it
+ * mp_trace_block()	 - record a line block as the exec takes it
+ * mp_trace_event()	 - record a dwell, command, merge release or freed run buffer
+ */
+#ifdef __PLANNER_TRACE
+void mp_trace_header()
+{
+	mpTraceHeader_t th;
+
+	memset(&th, 0, sizeof(th));
+	th.magic = TRACE_MAGIC;
+	th.version = TRACE_VERSION;
+	th.axes = AXES;
+	th.pool_size = mb.pool_size;
+	th.junction_acceleration = cm.junction_acceleration;
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		th.a[axis].feedrate_max = cm.a[axis].feedrate_max;
+		th.a[axis].velocity_max = cm.a[axis].velocity_max;
+		th.a[axis].jerk_max = cm.a[axis].jerk_max;
+		th.a[axis].recip_jerk = cm.a[axis].recip_jerk;
+		th.a[axis].recip_accel = cm.a[axis].recip_accel;
+		th.a[axis].junction_dev = cm.a[axis].junction_dev;
+	}
+	mp_trace_write(TRACE_HEADER, &th, sizeof(th));
+}
+
+void mp_trace_line(const GCodeState_t *gm)
+{
+	mpTraceLine_t tl;
+
+	memset(&tl, 0, sizeof(tl));
+	tl.linenum = gm->linenum;
+	copy_vector(tl.target, gm->target);
+	tl.feed_rate = gm->feed_rate;
+	tl.path_tolerance = cm.gmx.path_tolerance;
+	tl.arc_radius = gm->arc_radius;
+	tl.motion_mode = gm->motion_mode;
+	tl.feed_rate_mode = gm->feed_rate_mode;
+	tl.path_control = gm->path_control;
+	mp_trace_write(TRACE_LINE, &tl, sizeof(tl));
+}
+
+void mp_trace_block(const mpBuf_t *bf)
+{
+	mpTraceBlock_t tb;
+
+	tb.linenum = bf->gm->linenum;
+	tb.length = bf->length;
+	tb.entry_velocity = bf->entry_velocity;
+	tb.cruise_velocity = bf->cruise_velocity;
+	tb.exit_velocity = bf->exit_velocity;
+	tb.head_length = bf->head_length;
+	tb.body_length = bf->body_length;
+	tb.tail_length = bf->tail_length;
+	mp_trace_write(TRACE_BLOCK, &tb, sizeof(tb));
+}
+
+void mp_trace_event(uint8_t type, float value)
+{
+	mp_trace_write(type, &value, (type == TRACE_DWELL) ? sizeof(value) : 0);
+}
+#endif // __PLANNER_TRACE
+
 /*
  * mp_flush_planner() - 清除所有planner中的移动和所有曲线。 
  *
@@ -121,6 +285,14 @@ stat_t planner_test_assertions()
 void mp_flush_planner()
 {
 	cm_abort_arc();
+	mm.merge_count = 0;				// discard a held G64 P line
+	mm.carry = false;				// ...and a line carried as too short
+	mm.carry_time = 0;
+	mm.blend_vmax = 0;
+	mm.override_pending = false;	// new blocks are planned with the current factors
+	mm.sync_func = NULL;			// discard a command waiting for the next line block
+	st_pre.sync_func = NULL;		// ...and one not yet queued for the loader with a segment
+	mr.override_state = OVERRIDE_OFF;
 	mp_init_buffers();
 	cm_set_motion_state(MOTION_STOP);
 }
@@ -169,6 +341,7 @@ void mp_set_steps_to_runtime_position()
 
 /************************************************************************************
  * mp_queue_command() - 将一个同步M代码，程序控制或者其他命令入队到队列里。
+ * _queue_command()	  - put the command in a command buffer
  * _exec_command() 	  - 执行命令的回调函数。
  *
  *	How this works:
@@ -190,6 +363,16 @@ void mp_set_steps_to_runtime_position()
  */
 
 void mp_queue_command(void(*cm_exec)(float[], float[]), float *value, float *flag)
+{
+#ifdef __PLANNER_TRACE
+	mp_trace_event(TRACE_COMMAND, 0);
+#endif
+	mp_release_merge();									// a held line must run first
+	mp_release_sync_command();							// ...and a command waiting for the next line
+	_queue_command(cm_exec, value, flag);
+}
+
+static void _queue_command(cm_exec_t cm_exec, float *value, float *flag)
 {
 	mpBuf_t *bf;
 
@@ -224,6 +407,43 @@ stat_t mp_runtime_command(mpBuf_t *bf)
 	return (STAT_OK);
 }
 
+/*
+ * mp_queue_sync_command()	 - queue a command that runs with the next line block
+ * mp_release_sync_command() - give a waiting command a command buffer of its own
+ *
+ *	For single value commands that don't need motion to stop (S, M7, M8, M9). The
+ *	command waits in mm and _plan_line() attaches it to the next block it commits, so
+ *	the planner never sees it. mp_exec_aline() hands it to the prep queue when the block
+ *	starts and the loader runs it with the first segment, as it would a command buffer
+ *	(the callback gets a one value vector as both arguments).
+ *
+ *	Only one command waits at a time. Before a second one, or anything else that is
+ *	queued behind it, the waiting one is released into a command buffer, which keeps the
+ *	order and the stop it had before. mp_merge_callback() does the same when the queue
+ *	runs short, so a command sent while idle doesn't wait for motion that never comes.
+ */
+
+void mp_queue_sync_command(cm_exec_t cm_exec, float value)
+{
+#ifdef __PLANNER_TRACE
+	mp_trace_event(TRACE_SYNC, 0);
+#endif
+	mp_release_merge();									// a held line must start first
+	mp_release_sync_command();
+	mm.sync_func = cm_exec;
+	mm.sync_value = value;
+}
+
+void mp_release_sync_command()
+{
+	if (mm.sync_func == NULL) { return; }
+
+	float value[AXES] = { mm.sync_value, 0,0,0,0,0 };
+	cm_exec_t cm_exec = mm.sync_func;
+	mm.sync_func = NULL;
+	_queue_command(cm_exec, value, value);				// second vector is not used
+}
+
 /*************************************************************************
  * mp_dwell() 	 - queue a dwell
  * _exec_dwell() - dwell execution
@@ -236,11 +456,16 @@ stat_t mp_dwell(float seconds)
 {
 	mpBuf_t *bf;
 
+#ifdef __PLANNER_TRACE
+	mp_trace_event(TRACE_DWELL, seconds);
+#endif
+	mp_release_merge();									// a held line must run first
+	mp_release_sync_command();
 	if ((bf = mp_get_write_buffer()) == NULL)			// get write buffer or fail
 		return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));	// not ever supposed to fail
 
 	bf->bf_func = _exec_dwell;							// 注册dwell开始的回调函数（本函数下面的那个）。
-	bf->gm.move_time = seconds;							// in seconds, not minutes
+	bf->move_time = seconds;							// in seconds, not minutes
 	bf->move_state = MOVE_NEW;
 	mp_commit_write_buffer(MOVE_TYPE_DWELL);			// must be final operation before exit
 	return (STAT_OK);
@@ -250,7 +475,7 @@ stat_t mp_dwell(float seconds)
 //
 static stat_t _exec_dwell(mpBuf_t *bf)
 {
-	st_prep_dwell((uint32_t)(bf->gm.move_time * 1000000));// convert seconds to uSec
+	st_prep_dwell((uint32_t)(bf->move_time * 1000000));// convert seconds to uSec
 	if (mp_free_run_buffer()) cm_cycle_end();			// free buffer & perform cycle_end if planner is empty
 	return (STAT_OK);
 }
@@ -277,6 +502,16 @@ static stat_t _exec_dwell(mpBuf_t *bf)
  *
  * mp_get_planner_buffers_available()  返回当前可以使用的buffer数量。
  *
+ * mp_get_planner_queue_time()	返回队列中在运行移动之后的ALINE移动时间总和(分钟)。
+ *							Returns optimal move time of the moves queued behind the
+ *							running move, in minutes. The running move is left out so
+ *							a long move never holds off the move that follows it.
+ *							The committed and freed sums each have a single writer, so
+ *							the ISR and the main loop never race on a read-modify-write.
+ *							A read can tear on the AVR while the exec frees a buffer;
+ *							that is one wrong answer, not a drift, and the headroom
+ *							check still holds.
+ *
  * mp_init_buffers()		初始化或者复位buffer.
  *
  * mp_get_write_buffer()	获得指向下一个可以使用的写buffer的指针。
@@ -309,25 +544,125 @@ static stat_t _exec_dwell(mpBuf_t *bf)
 
 uint8_t mp_get_planner_buffers_available(void) { return (mb.buffers_available);}
 
+float mp_get_planner_queue_time(void)
+{
+	float queue_time = mb.time_committed - mb.time_freed;
+	mpBuf_t *r = mb.r;
+
+	if ((r->buffer_state == MP_BUFFER_RUNNING) && (r->move_type == MOVE_TYPE_ALINE)) {
+		queue_time -= r->move_time;
+	}
+	return (queue_time);
+}
+
+/*
+ * mp_record_line_arrival() - time a line received from the RX path (called by the controller)
+ * mp_prime_exec()			- true while the exec should hold a start from standstill (see PLANNER_PRIME_MSEC)
+ * mp_prime_callback()		- keep the exec asking while a start is held
+ * mp_throttle_exec()		- true while a dry run exec should leave the queue to the controller
+ *
+ *	Lines are only timed while less than the priming maximum is queued. Past that the
+ *	planner, not the sender, sets the pace. Gaps are clamped to the maximum so a pause
+ *	between jobs does not throw off the average. SysTick runs in 10 ms steps on the
+ *	xmega; the smoothing evens that out.
+ *
+ *	mp_prime_exec() runs in the exec (LO interrupt) before a line is started. The move
+ *	before it froze it against replanning (Note 2 in plan_exec.c). A held line is made
+ *	replannable again so the lines that come in can raise its exit velocity. That is
+ *	safe as the exec only asks again from the main loop - at a commit, which follows the
+ *	replan, or from mp_prime_callback(). Once it holds, no new line may come to request
+ *	the exec, so mp_prime_callback() keeps asking until the hold ends.
+ *
+ *	mp_throttle_exec() paces the exec in dry run (see PLANNER_INPUT_IDLE_MSEC). Homing,
+ *	probing, jogging and feedholds are never held, as for priming.
+ */
+
+void mp_record_line_arrival()
+{
+	uint32_t tick = SysTickTimer_getValue();
+
+	if ((mb.time_committed - mb.time_freed) * (MICROSECONDS_PER_MINUTE / 1000) < PLANNER_PRIME_MAX_MSEC) {
+		float interval = min((float)(tick - mb.line_tick), PLANNER_PRIME_MAX_MSEC);
+		mb.line_interval += (interval - mb.line_interval) / 8;
+	}
+	mb.line_tick = tick;
+}
+
+uint8_t mp_prime_exec(mpBuf_t *bf)
+{
+	if ((cm.cycle_state != CYCLE_MACHINING) ||		// homing, probing and jogging start at once
+		(cm.hold_state != FEEDHOLD_OFF) ||			// a feedhold needs the move started to stop it
+		(fp_NOT_ZERO(bf->entry_velocity))) {		// running on from the move before
+		mb.priming = false;
+		return (false);
+	}
+	uint32_t tick = SysTickTimer_getValue();
+	float prime_msec = min(max(mb.line_interval * PLANNER_PRIME_LINES, PLANNER_PRIME_MSEC), PLANNER_PRIME_MAX_MSEC);
+
+	if (mb.priming == false) {
+		mb.prime_tick = tick;
+	}
+	if (((mb.time_committed - mb.time_freed) * (MICROSECONDS_PER_MINUTE / 1000) < prime_msec) &&
+		((float)(tick - mb.prime_tick) < prime_msec) &&
+		(mb.buffers_available >= PLANNER_BUFFER_HEADROOM)) {
+		if (mb.priming == false) {
+			mb.priming = true;
+			mps.primes++;
+		}
+		bf->replannable = true;
+		return (true);
+	}
+	mb.priming = false;
+	return (false);
+}
+
+stat_t mp_prime_callback()
+{
+	if (mb.priming == true) {
+		st_request_exec_move();
+	}
+	return (STAT_OK);
+}
+
+uint8_t mp_throttle_exec()
+{
+	if ((cm.cycle_state != CYCLE_MACHINING) ||
+		(cm.hold_state != FEEDHOLD_OFF) ||
+		(mb.buffers_available < PLANNER_BUFFER_HEADROOM) ||		// the controller is waiting on the exec
+		(mp_get_planner_queue_time() >= PLANNER_LOOKAHEAD_TIME)) {
+		return (false);
+	}
+	return ((float)(SysTickTimer_getValue() - mb.line_tick) < PLANNER_INPUT_IDLE_MSEC);
+}
+
 void mp_init_buffers(void)
 {
+	mpBuf_t *bf = mb.bf;			// storage and size survive a flush
+	mpGCodeState_t *gm = mb.gm;
+	uint8_t pool_size = mb.pool_size;
 	mpBuf_t *pv;
 	uint8_t i;
 
 	memset(&mb, 0, sizeof(mb));		// clear all values, pointers and status
+	memset(bf, 0, pool_size * sizeof(mpBuf_t));
+	memset(gm, 0, pool_size * sizeof(mpGCodeState_t));
+	mb.bf = bf;
+	mb.gm = gm;
+	mb.pool_size = pool_size;
 	mb.magic_start = MAGICNUM;
 	mb.magic_end = MAGICNUM;
 
 	mb.w = &mb.bf[0];				// 初始化写和读指针，指向开头0
 	mb.q = &mb.bf[0];
 	mb.r = &mb.bf[0];
-	pv = &mb.bf[PLANNER_BUFFER_POOL_SIZE-1];
-	for (i=0; i < PLANNER_BUFFER_POOL_SIZE; i++) { // setup ring pointers
+	pv = &mb.bf[mb.pool_size-1];
+	for (i=0; i < mb.pool_size; i++) { // setup ring pointers
 		mb.bf[i].nx = &mb.bf[_bump(i)];
 		mb.bf[i].pv = pv;
+		mb.bf[i].gm = &mb.gm[i];
 		pv = &mb.bf[i];
 	}
-	mb.buffers_available = PLANNER_BUFFER_POOL_SIZE;
+	mb.buffers_available = mb.pool_size;
 }
 
 //函数名称：获取下一个可以写入的buffer指针
@@ -339,10 +674,16 @@ mpBuf_t * mp_get_write_buffer() 				// get & clear a buffer
 		mpBuf_t *w = mb.w;
 		mpBuf_t *nx = mb.w->nx;					// save linked list pointers
 		mpBuf_t *pv = mb.w->pv;
-		memset(mb.w, 0, sizeof(mpBuf_t));		// clear all values
+		mpGCodeState_t *gm = mb.w->gm;
+		memset(mb.w, 0, sizeof(mpBuf_t));		// clear all values (the Gcode state is written in full by its user)
 		w->nx = nx;								// restore pointers
 		w->pv = pv;
+		w->gm = gm;
 		w->buffer_state = MP_BUFFER_LOADING;
+		if (mb.buffers_available == mb.pool_size) {	// queue is empty so the exec can't be freeing:
+			mb.time_committed = 0;				// rebase the time sums before they lose precision
+			mb.time_freed = 0;
+		}
 		mb.buffers_available--;
 		mb.w = w->nx;
 		return (w);
@@ -368,6 +709,9 @@ void mp_commit_write_buffer(const uint8_t move_type)
 	mb.q->move_type = move_type;
 	mb.q->move_state = MOVE_NEW;
 	mb.q->buffer_state = MP_BUFFER_QUEUED;
+	if (move_type == MOVE_TYPE_ALINE) {
+		mb.time_committed += mb.q->move_time;
+	}
 	mb.q = mb.q->nx;							// advance the queued buffer pointer
 	/*TODO:看懂这个什么意思*/qr_request_queue_report(+1);				// request a QR and add to the "added buffers" count
 	st_request_exec_move();						// requests an exec if the runtime is not busy
@@ -391,6 +735,14 @@ mpBuf_t * mp_get_run_buffer()
 
 uint8_t mp_free_run_buffer()					// EMPTY current run buf & adv to next
 {
+	uint8_t move_type = mb.r->move_type;
+
+#ifdef __PLANNER_TRACE
+	mp_trace_event(TRACE_FREE, 0);
+#endif
+	if (move_type == MOVE_TYPE_ALINE) {
+		mb.time_freed += mb.r->move_time;
+	}
 	mp_clear_buffer(mb.r);						// clear it out (& reset replannable)
 //	mb.r->buffer_state = MP_BUFFER_EMPTY;		// redundant after the clear, above
 	mb.r = mb.r->nx;							// advance to next run buffer
@@ -399,7 +751,11 @@ uint8_t mp_free_run_buffer()					// EMPTY current run buf & adv to next
 	}
 	mb.buffers_available++;
 	qr_request_queue_report(-1);				// request a QR and add to the "removed buffers" count
-	return ((mb.w == mb.r) ? true : false); 	// return true if the queue emptied
+	if (mb.w != mb.r) { return (false);}
+	if ((move_type == MOVE_TYPE_ALINE) && (cm.cycle_state != CYCLE_OFF)) {
+		mps.starved++;							// a line ran out with nothing behind it
+	}
+	return (true); 								// return true if the queue emptied
 }
 
 mpBuf_t * mp_get_first_buffer(void)
@@ -430,18 +786,63 @@ void mp_clear_buffer(mpBuf_t *bf)
 {
 	mpBuf_t *nx = bf->nx;			// save pointers
 	mpBuf_t *pv = bf->pv;
+	mpGCodeState_t *gm = bf->gm;
 	memset(bf, 0, sizeof(mpBuf_t));
 	bf->nx = nx;					// restore pointers
 	bf->pv = pv;
+	bf->gm = gm;
 }
 
 void mp_copy_buffer(mpBuf_t *bf, const mpBuf_t *bp)
 {
 	mpBuf_t *nx = bf->nx;			// save pointers
 	mpBuf_t *pv = bf->pv;
+	mpGCodeState_t *gm = bf->gm;
  	memcpy(bf, bp, sizeof(mpBuf_t));
+	memcpy(gm, bp->gm, sizeof(mpGCodeState_t));
 	bf->nx = nx;					// restore pointers
 	bf->pv = pv;
+	bf->gm = gm;
+}
+
+/*
+ * mp_save_gcode_state() - copy the Gcode model state a move carries into its side ring entry
+ * mp_load_gcode_state() - restore it into a full Gcode state for the runtime
+ *
+ *	Fields not carried (spindle, coolant, P word, minimum time...) are left as they
+ *	are in the runtime state. Nothing reports them from the runtime.
+ */
+
+void mp_save_gcode_state(mpGCodeState_t *gs, const GCodeState_t *gm)
+{
+	gs->linenum = gm->linenum;
+	copy_vector(gs->target, gm->target);
+	copy_vector(gs->work_offset, gm->work_offset);
+	gs->feed_rate = gm->feed_rate;
+	gs->motion_mode = gm->motion_mode;
+	gs->feed_rate_mode = gm->feed_rate_mode;
+	gs->select_plane = gm->select_plane;
+	gs->units_mode = gm->units_mode;
+	gs->coord_system = gm->coord_system;
+	gs->path_control = gm->path_control;
+	gs->distance_mode = gm->distance_mode;
+	gs->tool = gm->tool;
+}
+
+void mp_load_gcode_state(GCodeState_t *gm, const mpGCodeState_t *gs)
+{
+	gm->linenum = gs->linenum;
+	copy_vector(gm->target, gs->target);
+	copy_vector(gm->work_offset, gs->work_offset);
+	gm->feed_rate = gs->feed_rate;
+	gm->motion_mode = gs->motion_mode;
+	gm->feed_rate_mode = gs->feed_rate_mode;
+	gm->select_plane = gs->select_plane;
+	gm->units_mode = gs->units_mode;
+	gm->coord_system = gs->coord_system;
+	gm->path_control = gs->path_control;
+	gm->distance_mode = gs->distance_mode;
+	gm->tool = gs->tool;
 }
 
 /*
@@ -67,13 +67,36 @@ enum sectionState {
 	SECTION_2nd_HALF		// second half of S curve or running a BODY (cruise)
 };
 
+enum mpOverrideState {		// mr.override_state - see mp_feed_override_callback()
+	OVERRIDE_OFF = 0,		// no override change in progress
+	OVERRIDE_SYNC,			// waiting for the exec to rescale the running move
+	OVERRIDE_PLAN			// exec is done with it - replan the queue behind the running move
+};
+
+enum mpZoidCase {			// mp_calculate_trapezoid() outcomes counted in mps.zoid[] (see plan_zoid.c)
+	ZOID_F = 0,				// F	too short for one segment
+	ZOID_B2,				// B"	fits into a single body segment
+	ZOID_B,					// B	velocities all match
+	ZOID_T2,				// T"	degraded tail-only
+	ZOID_T,					// T'	tail-only
+	ZOID_H2,				// H"	degraded head-only
+	ZOID_H,					// H'	head-only
+	ZOID_HT,				// HT	symmetric rate-limited
+	ZOID_HT_ASYM,			// HT'	asymmetric rate-limited
+	ZOID_HBT,				// requested fit: HBT, HB, BT and their reductions
+	ZOID_CASES
+};
+
 /*** 大部分因子都是大量设计考虑后的结果。更改的时候要小心***/
 
 #define ARC_SEGMENT_LENGTH      ((float)0.1)		// Arc segment size (mm).(0.03)
 #define MIN_ARC_RADIUS          ((float)0.1)
+#define ARC_JUNCTION_MARGIN     ((float)1.25)		// a junction turning up to this times an arc chord's own angle is on the arc
 
 #define JERK_MULTIPLIER         ((float)1000000)
 #define JERK_MATCH_PRECISION    ((float)1000)		// precision to which jerk must match to be considered effectively the same
+#define ACCEL_MULTIPLIER        ((float)1000)		// axis acceleration is set in mm/min^2 divided by 1000
+#define ACCEL_PEAK_FACTOR       ((float)1.875)		// peak acceleration of the exec's S-curve is 1.875 * dV/T
 
 #define NOM_SEGMENT_USEC        ((float)5000)		// nominal segment time
 #define MIN_SEGMENT_USEC        ((float)2500)		// minimum segment time / minimum move time
@@ -87,25 +110,144 @@ enum sectionState {
 
 #define MIN_SEGMENT_TIME_PLUS_MARGIN ((MIN_SEGMENT_USEC+1) / MICROSECONDS_PER_MINUTE)
 
-/* PLANNER_STARTUP_DELAY_SECONDS
- *	Used to introduce a short dwell before planning an idle machine.
- *  If you don't do this the first block will always plan to zero as it will
- *	start executing before the next block arrives from the serial port.
- *	This causes the machine to stutter once on startup.
+/* Segment times per section
+ *	The exec slices each section of a move on its own (see _get_section_segments()).
+ *	Heads and tails are sliced at NOM_SEGMENT_USEC, but a short one gets at least
+ *	ACCEL_SECTION_SEGMENTS segments, down to MIN_SEGMENT_USEC, so that a steep velocity
+ *	change is not taken in a few coarse steps. Bodies run at one velocity, so longer
+ *	segments lose nothing and save exec passes. They are bounded by feedhold latency -
+ *	a hold waits out the segment running and the PREP_QUEUE_DEPTH prepared behind it, up
+ *	to PREP_QUEUE_DEPTH+1 body segments - and by the DDA substep range, which is sized
+ *	for MAX_SEGMENT_TIME.
+ *	host/segment_bench reports both the hold latency and the DDA position error.
+ *
+ *	BODY_SEGMENT_USEC=NOM_SEGMENT_USEC and ACCEL_SECTION_SEGMENTS=1 give back the fixed
+ *	NOM_SEGMENT_USEC slicing (host/segment_bench_fixed is built that way).
+ */
+#ifndef BODY_SEGMENT_USEC
+#define BODY_SEGMENT_USEC       ((float)10000)		// body segment time (not less than NOM_SEGMENT_USEC)
+#endif
+#ifndef ACCEL_SECTION_SEGMENTS
+#define ACCEL_SECTION_SEGMENTS  ((float)8)			// least segments in a head or tail
+#endif
+#define MAX_SEGMENT_TIME        (BODY_SEGMENT_USEC / MICROSECONDS_PER_MINUTE)	// longest segment the exec prepares
+
+/* PLANNER_PRIME_MSEC
+ *	Start-up priming. A line that starts from standstill is not started right away. If
+ *	it were, it would plan to zero as it starts executing before the next block arrives
+ *	from the serial port - a stutter on startup, and again every time a slow sender lets
+ *	the queue run down to its last block, which then runs to a stop on its own. The exec
+ *	holds the line until this much motion is queued, or as long has passed, whichever
+ *	comes first.
+ *
+ *	The threshold follows the time between lines measured on the RX path (see
+ *	mp_record_line_arrival()): the queued motion must outlast the wait for the next
+ *	line, so it is PLANNER_PRIME_LINES intervals, clamped to PLANNER_PRIME_MSEC and
+ *	PLANNER_PRIME_MAX_MSEC. A fast sender starts at once, a slow one gets a deeper queue
+ *	and a sender that has stopped holds off the start no longer than the maximum.
+ *	A full queue starts at once. Homing, probing, jogging and feedholds are never held.
+ *	Set PLANNER_PRIME_MAX_MSEC to 0 to turn priming off.
  */
-//#define PLANNER_STARTUP_DELAY_SECONDS ((float)0.05)	// in seconds
+#define PLANNER_PRIME_MSEC		((float)50)		// least motion to queue before starting (ms)
+#ifndef PLANNER_PRIME_MAX_MSEC
+#define PLANNER_PRIME_MAX_MSEC	((float)250)	// most motion to queue and longest hold (ms)
+#endif
+#define PLANNER_PRIME_LINES		((float)3)		// line intervals to queue
 
 /* PLANNER_BUFFER_POOL_SIZE
  *	Should be at least the number of buffers requires to support optimal
  *	planning in the case of very short lines or arc segments.
- *	Suggest 12 min. Limit is 255
+ *	Suggest 12 min. Limit is 255. Can be overridden on the compiler command line.
+ *
+ *	The pool is sized at runtime by planner_init(). On the AVR this is the size of
+ *	the static buffer storage and caps the runtime size. The ARM build allocates
+ *	the pool at init (PLANNER_HEAP_POOL), so the size passed to planner_init() is used
+ *	as given. It comes from the {pool:n} setting and takes effect at the next reset.
+ *	Define PLANNER_HEAP_POOL to build the heap pool for any target - the host harness
+ *	does for planner_bench_heap.
+ *
+ *	The buffers keep their Gcode state in a side ring of compact mpGCodeState_t entries
+ *	instead of a full GCodeState_t each. PLANNER_BUFFER_POOL_DEFAULT is as many buffers
+ *	as fit, together with the G64 P merge state in mm, in the xmega RAM that 32 buffers
+ *	took with an embedded GCodeState_t. planner.c checks this with sizeof() on xmega
+ *	builds - lower the default or PLANNER_MERGE_POINTS if it fails.
  */
-#define PLANNER_BUFFER_POOL_SIZE 32
+#define PLANNER_BUFFER_POOL_DEFAULT 35
+#ifndef PLANNER_BUFFER_POOL_SIZE
+#define PLANNER_BUFFER_POOL_SIZE PLANNER_BUFFER_POOL_DEFAULT
+#endif
 #define PLANNER_BUFFER_HEADROOM 4			// buffers to reserve in planner before processing new input line
+#define PLANNER_BUFFER_POOL_MIN (PLANNER_BUFFER_HEADROOM + 4) // smallest pool planner_init() will set up
+#if defined(__ARM) && !defined(PLANNER_HEAP_POOL)
+#define PLANNER_HEAP_POOL					// pool storage comes from realloc() in planner_init()
+#endif
+
+/* PLANNER_LOOKAHEAD_USEC
+ *	Planned motion to keep queued behind the running move. _sync_to_planner() stops
+ *	taking new input once the optimal move times of the queued moves add up to this,
+ *	even if buffers are free. Dense toolpaths fill the pool before reaching it, so a
+ *	large pool buys lookahead where it is needed without over-queuing long moves.
+ *	PLANNER_BUFFER_HEADROOM is always enforced as well.
+ *
+ *	Optimal move time understates short jerk-limited moves by a lot, so keep this
+ *	generous. Below ~5 seconds it starts costing cycle time on the sample files.
+ */
+#ifndef PLANNER_LOOKAHEAD_USEC
+#define PLANNER_LOOKAHEAD_USEC	((float)10000000)	// 10 seconds of motion
+#endif
+#define PLANNER_LOOKAHEAD_TIME	(PLANNER_LOOKAHEAD_USEC / MICROSECONDS_PER_MINUTE)
+
+/* PLANNER_INPUT_IDLE_MSEC
+ *	Dry run pacing ({sim:1}, see mp_throttle_exec()). With no step timers to wait on, the
+ *	exec would take each block as soon as it is committed and plan every one to a stop.
+ *	It only takes from the queue once _sync_to_planner() would hold off the next line -
+ *	so blocks see the lookahead of a sender that keeps up - or no line has come in for
+ *	this long, which is the end of the input.
+ */
+#define PLANNER_INPUT_IDLE_MSEC	((float)100)	// no line for this long ends the input (ms)
+
+/* PLANNER_MERGE_POINTS
+ *	G64 P sets a tolerance for folding runs of nearly collinear G1 lines into one block
+ *	(see mp_aline()). The newest line is held back while later lines may still extend it.
+ *	This is the most interior vertices a held chord may have before it is released,
+ *	which is one less than the number of lines it can fold. Each costs MOTION_AXES floats
+ *	of RAM, which counts against the planner pool (see PLANNER_BUFFER_POOL_DEFAULT).
+ *
+ * PLANNER_MERGE_RELEASE_USEC
+ *	The held line is released as soon as less than this much motion is queued behind
+ *	the running move, so holding it can never starve the runtime.
+ *
+ * PLANNER_CARRY_RELEASE_USEC
+ *	Same for a line carried because it was too short to plan (see mp_aline()). Flushing
+ *	it costs a slow single segment block, so it waits until the queue is nearly dry.
+ */
+#ifndef PLANNER_MERGE_POINTS
+#define PLANNER_MERGE_POINTS	8
+#endif
+#define PLANNER_MERGE_RELEASE_USEC	((float)50000)	// 50 ms of motion
+#define PLANNER_MERGE_RELEASE_TIME	(PLANNER_MERGE_RELEASE_USEC / MICROSECONDS_PER_MINUTE)
+#define PLANNER_CARRY_RELEASE_USEC	((float)10000)	// 10 ms of motion
+#define PLANNER_CARRY_RELEASE_TIME	(PLANNER_CARRY_RELEASE_USEC / MICROSECONDS_PER_MINUTE)
+
+/* PLANNER_BLEND_SEGMENTS
+ *	Corners between G64 P lines are replaced by a blend arc (see _blend_corner()).
+ *	This is the most chords the arc is split into to stay within the tolerance: 1, 2 or 4.
+ */
+#define PLANNER_BLEND_SEGMENTS	4
+
+/* Synchronous commands inside continuous motion
+ *	Spindle speed (S) and coolant (M7, M8, M9) don't need motion to stop. They are queued
+ *	with mp_queue_sync_command(), which holds one in mm and attaches it to the next line
+ *	block instead of giving it a buffer of its own, which the planner would have to stop
+ *	at. The loader runs it with the first segment of that block. A command that can't be
+ *	attached - a second one before the next line, or one followed by a command, a dwell
+ *	or nothing - gets a command buffer as before (see mp_release_sync_command()).
+ *	Spindle start, stop and reverse (M3, M4, M5) keep their stop.
+ */
 
 /* Some parameters for _generate_trapezoid()
- * TRAPEZOID_ITERATION_MAX	 				Max iterations for convergence in the HT asymmetric case.
- * TRAPEZOID_ITERATION_ERROR_PERCENT		Error percentage for iteration convergence. As percent - 0.01 = 1%
+ * TRAPEZOID_ITERATION_MAX	 				Bisection steps in the HT asymmetric case with an acceleration limit
+ * TRAPEZOID_ITERATION_ERROR_PERCENT		Convergence of the old HT asymmetric iteration (PLAN_ZOID_ITERATIVE)
  * TRAPEZOID_LENGTH_FIT_TOLERANCE			Tolerance for "exact fit" for H and T cases
  * TRAPEZOID_VELOCITY_TOLERANCE				Adaptive velocity tolerance term
  */
@@ -134,22 +276,38 @@ enum mpBufferState {				// bf->buffer_state values
 	MP_BUFFER_RUNNING				// current running buffer
 };
 
+/*
+ * mpGCodeState_t - Gcode model state carried from the model to the runtime
+ *
+ *	This is the part of GCodeState_t the runtime reports from (see mp_load_gcode_state()),
+ *	plus the move target. It lives in a side ring with one entry per planner buffer and
+ *	is only written by mp_aline() / mp_queue_command() and read by the exec, so the
+ *	backward and forward planning passes never touch it.
+ *
+ *	The modal groups are packed into bit fields sized to their enums. Widen a field if
+ *	its enum (canonical_machine.h) outgrows it.
+ */
+typedef struct mpGCodeState {		// compact Gcode model state - one per planner buffer
+	uint32_t linenum;				// Gcode block line number
+	float target[AXES];				// XYZABC where the move should go (value vector for commands)
+	float work_offset[AXES];		// offset from the work coordinate system (for reporting only)
+	float feed_rate;				// F - normalized to millimeters/minute or in inverse time mode
+	uint8_t motion_mode		:4;		// Group1: G0, G1, G2, G3... (cmMotionMode)
+	uint8_t feed_rate_mode	:2;		// See cmFeedRateMode for settings
+	uint8_t select_plane	:2;		// G17,G18,G19
+	uint8_t units_mode		:2;		// G20,G21
+	uint8_t coord_system	:3;		// G53-G59
+	uint8_t path_control	:2;		// G61... EXACT_PATH, EXACT_STOP, CONTINUOUS
+	uint8_t distance_mode	:1;		// G90,G91
+	uint8_t tool;					// M6 tool
+} mpGCodeState_t;
+
 typedef struct mpBuffer {			// See Planning Velocity Notes for variable usage
 	struct mpBuffer *pv;			// static pointer to previous buffer
 	struct mpBuffer *nx;			// static pointer to next buffer
-	stat_t (*bf_func)(struct mpBuffer *bf); // callback to buffer exec function
-	cm_exec_t cm_func;				// callback to canonical machine execution function
-
-	float naiive_move_time;
 
-	uint8_t buffer_state;			// used to manage queuing/dequeuing
-	uint8_t move_type;				// used to dispatch to run routine
-	uint8_t move_code;				// byte that can be used by used exec functions
-	uint8_t move_state;				// move state machine sequence
+	// planning fields - kept together so the planning passes stay in as few cache lines as possible
 	uint8_t replannable;			// TRUE if move can be re-planned
-
-	float unit[AXES];				// unit vector for axis scaling & planning
-
 	float length;					// total length of line or helix in mm
 	float head_length;
 	float body_length;
@@ -161,26 +319,49 @@ typedef struct mpBuffer {			// See Planning Velocity Notes for variable usage
 
 	float entry_vmax;				// max junction velocity at entry of this move
 	float cruise_vmax;				// max cruise velocity requested for move
+	float cruise_vset;				// cruise velocity set by the Gcode, before feed override
+	float junction_vmax;			// max entry velocity allowed by the junction, before feed override
 	float exit_vmax;				// max exit velocity possible (redundant)
 	float delta_vmax;				// max velocity difference for this move
 	float braking_velocity;			// current value for braking velocity
 
-	uint8_t jerk_axis;				// rate limiting axis used to compute jerk for the move
 	float jerk;						// maximum linear jerk term for this move
 	float recip_jerk;				// 1/Jm used for planning (computed and cached)
 	float cbrt_jerk;				// cube root of Jm used for planning (computed and cached)
+	float accel;					// maximum linear acceleration for this move (0 = limited by jerk only)
+	float move_time;				// optimal move time (min) - dwell time (sec) for dwells
 
-	GCodeState_t gm;				// Gode model state - passed from model, used by planner and runtime
+	// setup and dispatch fields
+	stat_t (*bf_func)(struct mpBuffer *bf); // callback to buffer exec function
+	cm_exec_t cm_func;				// callback to canonical machine execution function (or attached command)
+	float sync_value;				// argument of the command attached to a line block
+	uint8_t buffer_state;			// used to manage queuing/dequeuing
+	uint8_t move_type;				// used to dispatch to run routine
+	uint8_t move_code;				// byte that can be used by used exec functions
+	uint8_t move_state;				// move state machine sequence
+	uint8_t jerk_axis;				// rate limiting axis used to compute jerk for the move
+	float unit[AXES];				// unit vector for axis scaling & planning
+	float junction_delta;			// fused junction deviation for this move's unit vector (cached)
+	float arc_radius;				// radius of the arc this block is a chord of (0 = not an arc chord)
 
+	mpGCodeState_t *gm;				// static pointer to this buffer's entry in the Gcode state ring
 } mpBuf_t;
 
 typedef struct mpBufferPool {		// ring buffer for sub-moves
 	magic_t magic_start;			// 用于测试内存完整性的magic number。
 	uint8_t buffers_available;		// 有多少buffer可以使用。running count of available buffers
+	uint8_t pool_size;				// number of buffers in the ring, set by planner_init()
+	float time_committed;			// sum of ALINE move times committed (minutes) - written by planning only
+	float time_freed;				// sum of ALINE move times freed (minutes) - written by the exec only
 	mpBuf_t *w;						// get_write_buffer pointer
 	mpBuf_t *q;						// queue_write_buffer pointer
 	mpBuf_t *r;						// get/end_run_buffer pointer
-	mpBuf_t bf[PLANNER_BUFFER_POOL_SIZE];// buffer storage
+	mpBuf_t *bf;					// buffer storage
+	mpGCodeState_t *gm;				// Gcode state side ring - bf[i].gm points to gm[i]
+	uint8_t priming;				// true while the exec holds an idle start (see PLANNER_PRIME_MSEC)
+	uint32_t prime_tick;			// SysTick when the hold started
+	uint32_t line_tick;				// SysTick of the last line received
+	float line_interval;			// smoothed time between received lines (ms)
 	magic_t magic_end;
 } mpBufferPool_t;
 
@@ -192,6 +373,20 @@ typedef struct mpMoveMasterSingleton { // common variables for planning (move ma
 	float recip_jerk;
 	float cbrt_jerk;
 
+	uint8_t merge_count;			// G1 lines folded into the held line (0 = none held)
+	float merge_point[PLANNER_MERGE_POINTS][MOTION_AXES];	// interior vertices of the held chord
+	mpGCodeState_t merge_gs;		// Gcode state of the held line. Its target is the chord end
+	float blend_vmax;				// entry velocity of the next line, which starts on a blend (0 = none)
+	uint8_t carry;					// merge_gs holds a line rejected as too short - mm.position is its start
+	float carry_time;				// G93 time of the carried line, taken by the next G93 line
+
+	float feed_override;			// feed rate override factor applied to feed moves (1.0 = off)
+	float traverse_override;		// feed rate override factor applied to traverses
+	uint8_t override_pending;		// factors changed - queue and runtime still to be rescaled
+
+	cm_exec_t sync_func;			// command waiting to be attached to the next line block (NULL = none)
+	float sync_value;				// ...and its argument
+
 	magic_t magic_end;
 } mpMoveMasterSingleton_t;
 
@@ -227,6 +422,7 @@ typedef struct mpMoveRuntimeSingleton {	// persistent runtime variables
 	float segment_velocity;			// computed velocity for aline segment
 	float segment_time;				// actual time increment per aline segment
 	float jerk;						// max linear jerk
+	float accel;					// max linear acceleration (0 = limited by jerk only)
 
 #ifdef __JERK_EXEC					// values used exclusively by computed jerk acceleration
 	float jerk_div2;				// cached value for efficiency
@@ -241,6 +437,8 @@ typedef struct mpMoveRuntimeSingleton {	// persistent runtime variables
 	float forward_diff_3;			// forward difference level 3
 	float forward_diff_4;			// forward difference level 4
 	float forward_diff_5;			// forward difference level 5
+	uint32_t accel_segments;		// segments left to hold at the midpoint acceleration (7-segment profile)
+	uint32_t accel_start;			// segment_count at which the hold starts
 #ifdef __KAHAN
 	float forward_diff_1_c;			// forward difference level 1 floating-point compensation
 	float forward_diff_2_c;			// forward difference level 2 floating-point compensation
@@ -250,23 +448,141 @@ typedef struct mpMoveRuntimeSingleton {	// persistent runtime variables
 #endif
 #endif
 
+	uint8_t override_state;			// feed override handshake with the exec (see mpOverrideState)
+	struct mpBuffer *override_bf;	// running move the override is for
+	float override_entry;			// cruise velocity it was computed from
+	float override_velocity;		// new cruise velocity
+	float override_exit;			// new exit velocity
+	float override_head;			// length to change from the old to the new cruise velocity
+	float override_tail;			// length to change from the new cruise to the exit velocity
+
 	GCodeState_t gm;				// gcode model state currently executing
 
 	magic_t magic_end;
 } mpMoveRuntimeSingleton_t;
 
+typedef struct mpPlannerStats {		// planner instrumentation - reported as {"pl":...} (see report.c)
+	uint32_t zoid[ZOID_CASES];		// mp_calculate_trapezoid() outcomes by case (see mpZoidCase)
+	uint32_t blocks;				// line blocks planned
+	uint32_t optimal;				// blocks marked non-replannable by the forward pass
+	uint32_t min_time_moves;		// lines rejected with STAT_MINIMUM_TIME_MOVE
+	uint32_t starved;				// queue ran empty under a line while in cycle
+	uint32_t plan_ticks;			// sum of block planning times, in PLAN_TIMER_USEC ticks
+	uint16_t plan_ticks_min;
+	uint16_t plan_ticks_max;
+	uint32_t holds;					// feedholds planned
+	uint16_t hold_plan_ticks_max;	// longest mp_plan_hold_callback()
+	uint16_t hold_ticks_max;		// longest feedhold request to first decelerating segment
+	uint16_t hold_start;			// timestamp of the pending feedhold request
+	uint8_t hold_timing;			// true until the pending request reaches its first decel segment
+	uint32_t primes;				// starts from standstill held to prime the queue
+	uint32_t sync_commands;			// commands run inside a line block instead of stopping for them
+} mpPlannerStats_t;
+
 // Reference global scope structures
-extern mpBufferPool_t mb;				// move buffer queue
-extern mpMoveMasterSingleton_t mm;		// context for line planning
-extern mpMoveRuntimeSingleton_t mr;		// context for line runtime
+extern THREAD_LOCAL mpBufferPool_t mb;				// move buffer queue
+extern THREAD_LOCAL mpMoveMasterSingleton_t mm;		// context for line planning
+extern THREAD_LOCAL mpMoveRuntimeSingleton_t mr;		// context for line runtime
+extern THREAD_LOCAL mpPlannerStats_t mps;			// planner statistics
+
+/*
+ * Planner trace (compile with __PLANNER_TRACE)
+ *
+ *	Records what goes into the planner and what comes out, as a stream of one byte
+ *	record types each followed by its fixed size record:
+ *
+ *	  TRACE_HEADER	settings the planner reads from cm (first record, see mp_trace_header())
+ *	  TRACE_LINE	mp_aline() input - target, feed, path control, G64 P tolerance and arc radius
+ *	  TRACE_DWELL	mp_dwell() input
+ *	  TRACE_COMMAND	mp_queue_command() - a synchronous command took a buffer
+ *	  TRACE_RELEASE	mp_merge_callback() planned a held or carried line or queued a waiting command
+ *	  TRACE_BLOCK	a line block as planned, taken when the exec starts running it
+ *	  TRACE_FREE	the exec freed the run buffer
+ *	  TRACE_SYNC	mp_queue_sync_command() - a command waits for the next line block
+ *
+ *	BLOCK and FREE also fix where the exec ran relative to the inputs, so feeding the
+ *	inputs back and running the exec to the same points replans the job exactly (see
+ *	host/plan_trace.c). Records are written through mp_trace_write(), which the build
+ *	that defines __PLANNER_TRACE supplies. Feedholds, overrides and queue flushes are
+ *	not recorded - a trace is only replayable up to the first of them.
+ */
+#define TRACE_MAGIC		0x54504754		// "TGPT"
+#define TRACE_VERSION	3
+
+enum mpTraceType {
+	TRACE_HEADER = 1,
+	TRACE_LINE,
+	TRACE_DWELL,
+	TRACE_COMMAND,
+	TRACE_RELEASE,
+	TRACE_BLOCK,
+	TRACE_FREE,
+	TRACE_SYNC,
+	TRACE_TYPES
+};
+
+typedef struct mpTraceAxis {		// per axis settings used by planning
+	float feedrate_max;
+	float velocity_max;
+	float jerk_max;
+	float recip_jerk;
+	float recip_accel;
+	float junction_dev;
+} mpTraceAxis_t;
+
+typedef struct mpTraceHeader {
+	uint32_t magic;
+	float junction_acceleration;
+	mpTraceAxis_t a[AXES];
+	uint8_t version;
+	uint8_t axes;
+	uint8_t pool_size;				// planner queue depth
+	uint8_t reserved;
+} mpTraceHeader_t;
+
+typedef struct mpTraceLine {
+	uint32_t linenum;
+	float target[AXES];
+	float feed_rate;
+	float path_tolerance;			// G64 P in effect
+	float arc_radius;				// radius for arc chords
+	uint8_t motion_mode;
+	uint8_t feed_rate_mode;
+	uint8_t path_control;
+	uint8_t reserved;
+} mpTraceLine_t;
+
+typedef struct mpTraceBlock {
+	uint32_t linenum;				// of the last line in the block
+	float length;
+	float entry_velocity;
+	float cruise_velocity;
+	float exit_velocity;
+	float head_length;
+	float body_length;
+	float tail_length;
+} mpTraceBlock_t;
 
 /*
  * Global Scope Functions
  */
 
-void planner_init(void); //main.c planner.c 
+void planner_init(uint8_t pool_size); //main.c planner.c 
 void planner_init_assertions(void); //planner.c
 stat_t planner_test_assertions(void);//planner.c
+void mp_clear_stats(void);//planner.c report.c
+void mp_record_plan_time(uint16_t start);//plan_line.c
+void mp_start_hold_timer(void);//canonical_machine.c
+void mp_record_hold_plan_time(uint16_t start);//plan_line.c
+void mp_record_hold_time(void);//plan_exec.c
+
+#ifdef __PLANNER_TRACE
+void mp_trace_write(uint8_t type, const void *record, uint8_t size);	// supplied by the build
+void mp_trace_header(void);
+void mp_trace_line(const GCodeState_t *gm);
+void mp_trace_block(const mpBuf_t *bf);
+void mp_trace_event(uint8_t type, float value);	// DWELL (seconds), COMMAND, RELEASE, FREE, SYNC
+#endif
 
 void mp_flush_planner(void);//cycle_homing.c cycle_jogging.c cycle_probing.c planner.c
 void mp_set_planner_position(uint8_t axis, const float position);//planner.c canonical_machine.c
@@ -275,18 +591,28 @@ void mp_set_steps_to_runtime_position(void);//stepper.c canonical_machine.c plan
 
 void mp_queue_command(void(*cm_exec_t)(float[], float[]), float *value, float *flag);////stepper.c canonical_machine.c spildle.c
 stat_t mp_runtime_command(mpBuf_t *bf);//stepper.c  planner.c
+void mp_queue_sync_command(cm_exec_t cm_exec, float value);//canonical_machine.c spindle.c
+void mp_release_sync_command(void);//planner.c plan_line.c
 
 stat_t mp_dwell(const float seconds);//canonical_machiec.c planner.c 
 void mp_end_dwell(void);//canonical_machine.c planner.c 
 
 stat_t mp_aline(GCodeState_t *gm_in); //canonical_machine.c plan_arc.c plan_line.c 
+void mp_release_merge(void);//planner.c plan_line.c
+stat_t mp_merge_callback(void);//controller.c
 
 stat_t mp_plan_hold_callback(void);//controler.c plan_line.c
 stat_t mp_end_hold(void);//canonical_machine.c plan_line.c
-stat_t mp_feed_rate_override(uint8_t flag, float parameter); //canonical_machine.c
+stat_t mp_feed_rate_override(float feed_factor, float traverse_factor);//canonical_machine.c
+stat_t mp_feed_override_callback(void);//controller.c
 
 // ****planner buffer handlers ****
 uint8_t mp_get_planner_buffers_available(void);//canonical_machine.c controller.c plan_arc.c planner.c report.c
+float mp_get_planner_queue_time(void);//controller.c
+void mp_record_line_arrival(void);//controller.c
+uint8_t mp_prime_exec(mpBuf_t *bf);//plan_exec.c
+stat_t mp_prime_callback(void);//controller.c
+uint8_t mp_throttle_exec(void);//stepper.c
 void mp_init_buffers(void);//planner.c 
 mpBuf_t * mp_get_write_buffer(void);//planner.c plan_line.c
 void mp_unget_write_buffer(void);//planner.c
@@ -304,6 +630,8 @@ mpBuf_t * mp_get_last_buffer(void);//planner.c plan_line.c
 
 void mp_clear_buffer(mpBuf_t *bf);//planner.c
 void mp_copy_buffer(mpBuf_t *bf, const mpBuf_t *bp);//planner.c plan_line.c
+void mp_save_gcode_state(mpGCodeState_t *gs, const GCodeState_t *gm);//plan_line.c
+void mp_load_gcode_state(GCodeState_t *gm, const mpGCodeState_t *gs);//plan_exec.c
 
 // plan_line.c functions
 float mp_get_runtime_velocity(void); //canonical_machine.c plan_line.c 
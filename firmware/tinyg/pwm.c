@@ -42,7 +42,7 @@ extern "C"{
 
 /***** PWM定义，结构体和内存分配 *****/
 
-pwmSingleton_t pwm;
+THREAD_LOCAL pwmSingleton_t pwm;
 
 // 为所有PWM通道定义通用参数
 //#define PWM_TIMER_TYPE	TC1_struct	// PWM uses TC1's
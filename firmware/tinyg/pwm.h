@@ -57,7 +57,7 @@ typedef struct pwmSingleton {
 	pwmChannel_t 		p[PWMS];	// PWM通道数组
 } pwmSingleton_t;
 
-extern pwmSingleton_t pwm;
+extern THREAD_LOCAL pwmSingleton_t pwm;
 
 /*** 函数原型 ***/
 
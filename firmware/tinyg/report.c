@@ -32,6 +32,7 @@
 #include "json_parser.h"
 #include "text_parser.h"
 #include "planner.h"
+#include "hardware.h"
 #include "settings.h"
 #include "util.h"
 #include "xio.h"
@@ -594,6 +595,102 @@ stat_t qo_get(nvObj_t *nv)
 	return (STAT_OK);
 }
 
+/*****************************************************************************
+ * Planner Reports
+ *
+ *	{"pl":n} returns the planner statistics kept in mps (see planner.h):
+ *	  - plf .. plhbt	mp_calculate_trapezoid() outcomes by case (F, B", B, T", T', H", H',
+ *						HT, HT' and the requested-fit HBT family - see plan_zoid.c)
+ *	  - plbk	line blocks planned
+ *	  - plrp	trapezoid calculations per planned block (1.0 = never replanned)
+ *	  - plnr	blocks the forward pass marked non-replannable (optimally planned)
+ *	  - plmt	lines rejected as STAT_MINIMUM_TIME_MOVE
+ *	  - plst	starvation - the queue ran empty under a line while in cycle. A job
+ *				that does not end with M2/M30 counts one for its last line
+ *	  - plmin, plavg, plmax	planning time per block in microseconds
+ *	  - plhd	feedholds planned
+ *	  - plhp	longest mp_plan_hold_callback() in microseconds
+ *	  - plhl	longest feedhold latency in microseconds - from the '!' (or any other
+ *				cm_request_feedhold()) to the first decelerating segment
+ *	  - plpr	starts from standstill held to prime the queue (see PLANNER_PRIME_MSEC)
+ *	  - plsc	S and coolant commands run with a line block instead of stopping for them
+ *	  - plli	smoothed time between received lines in milliseconds, which sets how
+ *				deep the queue is primed. Not cleared by {clp:n}
+ *
+ *	Counters run from power-up or the last {clp:n}, which clears them like st_clc().
+ *
+ *	{"et":n} returns the exec and load timing kept in st_tm (see stepper.h), against the
+ *	budgets EXEC_BUDGET_USEC and LOAD_BUDGET_USEC:
+ *	  - etemn, etemx	exec passes that prepped a segment, dwell or command, in microseconds
+ *	  - etpmn, etpmx	st_prep_line() alone, in microseconds
+ *	  - etlmn, etlmx	line segment loads, in microseconds
+ *	  - ete0 .. ete5	exec passes by quarter of the budget: under 1/4, 1/4 to 1/2 ... ete5
+ *						is 5/4 of the budget and over
+ *	  - etl0 .. etl5	loads, the same way
+ *	  - eteo, etlo	exec passes and loads over budget. The first one since power-up or
+ *				the last {clt:n} is sent as an exception report (st_timing_callback())
+ */
+/*
+ * pl_get_rp() 	- trapezoid calculations per planned block
+ * pl_get_min() - shortest block planning time (us)
+ * pl_get_avg() - average block planning time (us)
+ * pl_get_max() - longest block planning time (us)
+ * pl_get_hp()	- longest feedhold planning time (us)
+ * pl_get_hl()	- longest feedhold latency (us)
+ * pl_clear()	- clear planner statistics (get or set)
+ */
+stat_t pl_get_rp(nvObj_t *nv)
+{
+	uint32_t zoids = 0;
+	for (uint8_t i=0; i<ZOID_CASES; i++) { zoids += mps.zoid[i];}
+	nv->value = (mps.blocks != 0) ? (float)zoids / mps.blocks : 0;
+	nv->precision = 2;
+	nv->valuetype = TYPE_FLOAT;
+	return (STAT_OK);
+}
+
+stat_t pl_get_min(nvObj_t *nv)
+{
+	nv->value = (mps.blocks != 0) ? (float)mps.plan_ticks_min * PLAN_TIMER_USEC : 0;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+stat_t pl_get_avg(nvObj_t *nv)
+{
+	nv->value = (mps.blocks != 0) ? (float)mps.plan_ticks * PLAN_TIMER_USEC / mps.blocks : 0;
+	nv->precision = 0;
+	nv->valuetype = TYPE_FLOAT;
+	return (STAT_OK);
+}
+
+stat_t pl_get_max(nvObj_t *nv)
+{
+	nv->value = (float)mps.plan_ticks_max * PLAN_TIMER_USEC;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+stat_t pl_get_hp(nvObj_t *nv)
+{
+	nv->value = (float)mps.hold_plan_ticks_max * PLAN_TIMER_USEC;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+stat_t pl_get_hl(nvObj_t *nv)
+{
+	nv->value = (float)mps.hold_ticks_max * PLAN_TIMER_USEC;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+stat_t pl_clear(nvObj_t *nv)
+{
+	mp_clear_stats();
+	return (STAT_OK);
+}
+
 /*****************************************************************************
  * JOB ID REPORTS
  *
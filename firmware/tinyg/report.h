@@ -131,6 +131,14 @@ stat_t qr_get(nvObj_t *nv);
 stat_t qi_get(nvObj_t *nv);
 stat_t qo_get(nvObj_t *nv);
 
+stat_t pl_get_rp(nvObj_t *nv);
+stat_t pl_get_min(nvObj_t *nv);
+stat_t pl_get_avg(nvObj_t *nv);
+stat_t pl_get_max(nvObj_t *nv);
+stat_t pl_get_hp(nvObj_t *nv);
+stat_t pl_get_hl(nvObj_t *nv);
+stat_t pl_clear(nvObj_t *nv);
+
 #ifdef __TEXT_MODE
 
 	void sr_print_sr(nvObj_t *nv);
@@ -103,9 +103,14 @@
 
 /**** MACHINE PROFILES ******************************************************/
 
-// machine default profiles - choose only one:
+// machine default profiles - choose only one, or name one on the command line:
+// -DSETTINGS_FILE='"settings/settings_shapeoko2.h"' (host tools: make PROFILE=shapeoko2)
 
+#ifdef SETTINGS_FILE
+#include SETTINGS_FILE
+#else
 #include "settings/settings_default.h"				// Default settings for release
+#endif
 //#include "settings/settings_cnc3040.h"
 //#include "settings/settings_test.h"					// Settings for testing - not for release
 //#include "settings/settings_openpnp.h"				// OpenPnP
@@ -117,6 +122,26 @@
 
 /*** Handle optional modules that may not be in every machine ***/
 
+// If a profile does not set axis acceleration limits the moves are limited by jerk only
+#ifndef X_ACCEL_MAX
+#define X_ACCEL_MAX						0					// xac		mm/min^2 divided by 1000 (0 = off)
+#endif
+#ifndef Y_ACCEL_MAX
+#define Y_ACCEL_MAX						0
+#endif
+#ifndef Z_ACCEL_MAX
+#define Z_ACCEL_MAX						0
+#endif
+#ifndef A_ACCEL_MAX
+#define A_ACCEL_MAX						0
+#endif
+#ifndef B_ACCEL_MAX
+#define B_ACCEL_MAX						0
+#endif
+#ifndef C_ACCEL_MAX
+#define C_ACCEL_MAX						0
+#endif
+
 // If PWM_1 is not defined fill it with default values
 #ifndef	P1_PWM_FREQUENCY
 
@@ -30,6 +30,7 @@
 #include "spindle.h"
 #include "gpio.h"
 #include "planner.h"
+#include "stepper.h"
 #include "hardware.h"
 #include "pwm.h"
 
@@ -100,6 +101,7 @@ static void _exec_spindle_control(float *value, float *flag)
 {
 	uint8_t spindle_mode = (uint8_t)value[0];
 	cm_set_spindle_mode(MODEL, spindle_mode);
+	if (st_sim.enable == true) return;		// dry run: model only, the spindle stays off
 
  #ifdef __AVR
 	if (spindle_mode == SPINDLE_CW) {
@@ -129,7 +131,7 @@ static void _exec_spindle_control(float *value, float *flag)
 }
 
 /*
- * cm_set_spindle_speed() 	- queue the S parameter to the planner buffer
+ * cm_set_spindle_speed() 	- queue the S parameter to run with the next line block
  * cm_exec_spindle_speed() 	- execute the S command (called from the planner buffer)
  * _exec_spindle_speed()	- spindle speed callback from planner queue
  */
@@ -138,8 +140,7 @@ stat_t cm_set_spindle_speed(float speed)
 //	if (speed > cfg.max_spindle speed)
 //        return (STAT_MAX_SPINDLE_SPEED_EXCEEDED);
 
-	float value[AXES] = { speed, 0,0,0,0,0 };
-	mp_queue_command(_exec_spindle_speed, value, value);
+	mp_queue_sync_command(_exec_spindle_speed, speed);	// no stop for it (see planner.h)
 	return (STAT_OK);
 }
 
@@ -151,6 +152,7 @@ void cm_exec_spindle_speed(float speed)
 static void _exec_spindle_speed(float *value, float *flag)
 {
 	cm_set_spindle_speed_parameter(MODEL, value[0]);
+	if (st_sim.enable == true) return;		// dry run
 	pwm_set_duty(PWM_1, cm_get_spindle_pwm(cm.gm.spindle_mode) ); // update spindle speed if we're running
 }
 
@@ -37,20 +37,28 @@
 #include "encoder.h"
 #include "planner.h"
 #include "report.h"
+#include "json_parser.h"
 #include "hardware.h"
 #include "text_parser.h"
 #include "util.h"
 
 /**** 分配机构体 ****/
 
-stConfig_t st_cfg;
-stPrepSingleton_t st_pre;
+THREAD_LOCAL stConfig_t st_cfg;
+THREAD_LOCAL stPrepSingleton_t st_pre;
+THREAD_LOCAL stSimSingleton_t st_sim;
+THREAD_LOCAL stTimingSingleton_t st_tm;
 static stRunSingleton_t st_run;
 
 /**** 设置静态函数 ****/
 
 static void _load_move(void);
+static void _load_sim_move(stSegment_t *seg);
+static void _free_prep_segment(void);
 static void _request_load_move(void);
+static void _clear_timing(void);
+static void _record_exec_time(uint16_t start);
+static void _record_load_time(uint16_t start);
 #ifdef __ARM
 static void _set_motor_power_level(const uint8_t motor, const float power_level);
 #endif
@@ -93,6 +101,10 @@ void stepper_init()
 {
 	memset(&st_run, 0, sizeof(st_run));			// 清除所有值，指针和状态 
 	stepper_init_assertions();
+	_clear_timing();
+	st_pre.prep_index = 0;						// empty prep queue
+	st_pre.load_index = 0;
+	st_pre.command_queued = false;
 
 #ifdef __AVR
 	// 配置虚拟端口 
@@ -126,7 +138,6 @@ void stepper_init()
 	TIMER_EXEC.INTCTRLA = TIMER_EXEC_INTLVL;	// 中断模式
 	TIMER_EXEC.PER = EXEC_TIMER_PERIOD;			// 设置周期
 
-	st_pre.buffer_state = PREP_BUFFER_OWNED_BY_EXEC;
 	st_reset();									// 复位步进电机模块到确切的状态
 #endif // __AVR
 
@@ -143,7 +154,6 @@ void stepper_init()
 
 	// setup software interrupt exec timer & initial condition
 	exec_timer.setInterrupts(kInterruptOnSoftwareTrigger | kInterruptPriorityLowest);
-	st_pre.buffer_state = PREP_BUFFER_OWNED_BY_EXEC;
 
 	// setup motor power levels and apply power level to stepper drivers
 	for (uint8_t motor=0; motor<MOTORS; motor++) {
@@ -199,7 +209,7 @@ uint8_t st_runtime_isbusy()
 void st_reset()
 {
 	for (uint8_t motor=0; motor<MOTORS; motor++) {
-		st_pre.mot[motor].prev_direction = STEP_INITIAL_DIRECTION;
+		st_run.mot[motor].prev_direction = STEP_INITIAL_DIRECTION;
 		st_run.mot[motor].substep_accumulator = 0;	// will become max negative during per-motor setup;
 		st_pre.mot[motor].corrected_steps = 0;		// 只用于诊断 - 没有实际的动作影响
 	}
@@ -216,6 +226,179 @@ stat_t st_clc(nvObj_t *nv)	// clear diagnostic counters, reset stepper prep
 	return(STAT_OK);
 }
 
+/*
+ * st_set_sim() 			- enter or leave dry run mode ({sim:1} / {sim:0})
+ * st_get_simt()			- motion and dwell time consumed in dry run (seconds)
+ * st_sim_report_callback() - send the sim report once the program has ended
+ * st_sim_callback()		- ask for the exec again once a held dry run may go on
+ * _sim_exec_held()			- true if the exec is to wait for the controller (exec ISR)
+ *
+ *	Only accepted with no cycle running - the loader must not switch between stepping
+ *	and counting in the middle of a move. Setting it either way clears the counters
+ *	and the planner statistics, so {"sim":n} after M2/M30 covers exactly one program.
+ *	The report goes out as {"sim":{...}} when the program end executes.
+ *
+ *	Left to itself the exec and loader would chain each other through every block as
+ *	it is committed, planning each one to a stop and keeping the main loop from the
+ *	next line. A held exec leaves the queue to the controller until mp_throttle_exec()
+ *	lets go, so blocks are planned against a full queue and the controller parses
+ *	between them. The end of the input is only seen by the clock, so st_sim_callback()
+ *	keeps asking, as mp_prime_callback() does for priming.
+ */
+
+static void _clear_sim(void)
+{
+	st_sim.held = false;
+	st_sim.segments = 0;
+	st_sim.seconds = 0;
+	st_sim.dda_ticks = 0;
+	st_sim.dwell_ticks = 0;
+	mp_clear_stats();
+}
+
+stat_t st_set_sim(nvObj_t *nv)
+{
+	if (cm_get_cycle_state() != CYCLE_OFF) {
+		return (STAT_COMMAND_NOT_ACCEPTED);
+	}
+	st_sim.enable = ((uint8_t)nv->value != 0) ? true : false;
+	st_sim.report_requested = false;
+	_clear_sim();
+	if (st_sim.enable == true) {
+		st_deenergize_motors();
+	}
+	return (STAT_OK);
+}
+
+stat_t st_get_simt(nvObj_t *nv)
+{
+	nv->value = st_sim.seconds + (st_sim.dda_ticks / FREQUENCY_DDA) + (st_sim.dwell_ticks / FREQUENCY_DWELL);
+	nv->precision = 3;
+	nv->valuetype = TYPE_FLOAT;
+	return (STAT_OK);
+}
+
+stat_t st_sim_report_callback()
+{
+	if (st_sim.report_requested == false) {
+		return (STAT_NOOP);
+	}
+	st_sim.report_requested = false;
+
+	nvObj_t *nv = nv_reset_nv_list();
+	strcpy(nv->token, "sim");
+	nv->index = nv_get_index((const char_t *)"", nv->token);
+	get_grp(nv);
+	nv_print_list(STAT_OK, TEXT_MULTILINE_FORMATTED, JSON_OBJECT_FORMAT);
+	_clear_sim();
+	return (STAT_OK);
+}
+
+stat_t st_sim_callback()
+{
+	if ((st_sim.held == true) && (mp_throttle_exec() == false)) {
+		st_request_exec_move();
+	}
+	return (STAT_OK);
+}
+
+static uint8_t _sim_exec_held(void)
+{
+	if (st_sim.enable == false) {
+		return (false);
+	}
+	return (st_sim.held = mp_throttle_exec());
+}
+
+/*
+ * st_clt() 			 - clear the exec and load timing ({clt:n}, get or set)
+ * st_get_et()			 - a min or max time from st_tm, in microseconds
+ * st_timing_callback()	 - send the exception report for the first overrun
+ *
+ *	The ISRs cannot send the report themselves (see rpt_exception()), so the first
+ *	overrun leaves its status in st_tm.exception for the controller. Later overruns are
+ *	only counted until the timing is cleared, so a stuttering job gets one report.
+ *
+ * _get_timing_bucket()	 - the quarter of the budget a time falls in
+ * _record_exec_time()	 - time an exec pass from start (exec ISR, LO)
+ * _record_load_time()	 - time a line segment load from start (loader, HI)
+ *
+ *	The buckets are found by adding up quarters rather than by dividing, which would
+ *	take a good part of the load's budget on the xmega.
+ */
+
+static void _clear_timing(void)
+{
+	memset(&st_tm, 0, sizeof(st_tm));
+	st_tm.exec_min = 0xFFFF;
+	st_tm.prep_min = 0xFFFF;
+	st_tm.load_min = 0xFFFF;
+}
+
+stat_t st_clt(nvObj_t *nv)
+{
+	_clear_timing();
+	return (STAT_OK);
+}
+
+stat_t st_get_et(nvObj_t *nv)
+{
+	uint16_t ticks = *((uint16_t *)GET_TABLE_WORD(target));
+
+	nv->value = (ticks == 0xFFFF) ? 0 : (float)ticks * PLAN_TIMER_USEC;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+stat_t st_timing_callback()
+{
+	if ((st_tm.exception == STAT_OK) || (st_tm.reported == true)) {
+		return (STAT_NOOP);
+	}
+	st_tm.reported = true;
+	rpt_exception(st_tm.exception);
+	return (STAT_OK);
+}
+
+static uint8_t _get_timing_bucket(uint16_t ticks, uint16_t budget)
+{
+	uint32_t quarters = (uint32_t)ticks << 2;
+	uint32_t limit = budget;
+	uint8_t bucket = 0;
+
+	while ((bucket < TIMING_BUCKETS-1) && (quarters >= limit)) {
+		limit += budget;
+		bucket++;
+	}
+	return (bucket);
+}
+
+static void _record_exec_time(uint16_t start)
+{
+	uint16_t ticks = hw_get_plan_timer() - start;
+
+	if (ticks < st_tm.exec_min) { st_tm.exec_min = ticks;}
+	if (ticks > st_tm.exec_max) { st_tm.exec_max = ticks;}
+	st_tm.exec_bucket[_get_timing_bucket(ticks, EXEC_BUDGET_TICKS)]++;
+	if (ticks > EXEC_BUDGET_TICKS) {
+		st_tm.exec_overruns++;
+		if (st_tm.exception == STAT_OK) { st_tm.exception = STAT_EXEC_OVER_BUDGET;}
+	}
+}
+
+static void _record_load_time(uint16_t start)
+{
+	uint16_t ticks = hw_get_plan_timer() - start;
+
+	if (ticks < st_tm.load_min) { st_tm.load_min = ticks;}
+	if (ticks > st_tm.load_max) { st_tm.load_max = ticks;}
+	st_tm.load_bucket[_get_timing_bucket(ticks, LOAD_BUDGET_TICKS)]++;
+	if (ticks > LOAD_BUDGET_TICKS) {
+		st_tm.load_overruns++;
+		if (st_tm.exception == STAT_OK) { st_tm.exception = STAT_LOAD_OVER_BUDGET;}
+	}
+}
+
 /*
  * 电机电源管理功能 
  *
@@ -529,16 +712,67 @@ MOTATE_TIMER_INTERRUPT(dwell_timer_num)
 } // namespace Motate
 #endif
 
+/****************************************************************************************
+ * Prep queue (see PREP_QUEUE_DEPTH in stepper.h)
+ *
+ * _prep_queue_is_free()  - true if the exec may prep an entry: there is room, and no
+ *							command queued that it has to wait for
+ * _get_prep_segment()	  - the entry the exec fills next
+ * _commit_prep_segment() - hand the filled entry to the loader (exec side)
+ * _free_prep_segment()	  - hand the entry just loaded back to the exec (loader side)
+ *
+ *	An entry is filled before the index that hands it over moves. _prep_barrier() keeps
+ *	the compiler from sinking the stores to the entry past the store to the index, which
+ *	is all it takes with the exec and loader on one core.
+ */
+
+#define _prep_barrier() __asm__ __volatile__ ("" ::: "memory")
+
+static uint8_t _prep_queue_is_free()
+{
+	uint8_t queued = st_pre.prep_index - st_pre.load_index;
+
+	if ((st_pre.command_queued == true) && (queued != 0)) {
+		return (false);
+	}
+	return (queued < PREP_QUEUE_DEPTH);
+}
+
+static stSegment_t *_get_prep_segment()
+{
+	return (&st_pre.seg[st_pre.prep_index & PREP_QUEUE_MASK]);
+}
+
+static void _commit_prep_segment(stSegment_t *seg, uint8_t move_type)
+{
+	seg->move_type = move_type;
+	seg->sync_func = st_pre.sync_func;					// S or coolant command set by mp_exec_aline()
+	seg->sync_value = st_pre.sync_value;
+	st_pre.sync_func = NULL;
+	st_pre.command_queued = (move_type == MOVE_TYPE_COMMAND);
+	_prep_barrier();
+	st_pre.prep_index++;
+}
+
+static void _free_prep_segment()
+{
+	_prep_barrier();
+	st_pre.load_index++;
+}
+
 /****************************************************************************************
  * 执行顺序代码		- 计算并准备下一段加载segment
  * st_request_exec_move()	- 用于请求执行运动的开关中断
  * exec_timer interrupt		- 调用执行函数的中断处理器
+ *
+ *	The exec asks for itself again after every pass that did something, so it runs
+ *	ahead of the loader until the prep queue is full.
  */
 
 #ifdef __AVR
 void st_request_exec_move()
 {
-	if (st_pre.buffer_state == PREP_BUFFER_OWNED_BY_EXEC) {// bother interrupting
+	if (_prep_queue_is_free() == true) {				// bother interrupting
 		TIMER_EXEC.PER = EXEC_TIMER_PERIOD;
 		TIMER_EXEC.CTRLA = EXEC_TIMER_ENABLE;				// 触发一个低优先级中断 
 	}
@@ -548,10 +782,12 @@ ISR(TIMER_EXEC_ISR_vect) {								// exec move SW interrupt
 	TIMER_EXEC.CTRLA = EXEC_TIMER_DISABLE;				// disable SW interrupt timer
 
 	// exec_move
-	if (st_pre.buffer_state == PREP_BUFFER_OWNED_BY_EXEC) {
+	if ((_prep_queue_is_free() == true) && (_sim_exec_held() == false)) {
+		uint16_t start = hw_get_plan_timer();
 		if (mp_exec_move() != STAT_NOOP) {
-			st_pre.buffer_state = PREP_BUFFER_OWNED_BY_LOADER; // flip it back
+			_record_exec_time(start);
 			_request_load_move();
+			st_request_exec_move();						// prep the next one while there is room
 		}
 	}
 }
@@ -560,7 +796,7 @@ ISR(TIMER_EXEC_ISR_vect) {								// exec move SW interrupt
 #ifdef __ARM
 void st_request_exec_move()
 {
-	if (st_pre.buffer_state == PREP_BUFFER_OWNED_BY_EXEC) {// bother interrupting
+	if (_prep_queue_is_free() == true) {				// bother interrupting
 		exec_timer.setInterruptPending();
 	}
 }
@@ -569,10 +805,12 @@ namespace Motate {	// Define timer inside Motate namespace
 	MOTATE_TIMER_INTERRUPT(exec_timer_num)				// exec move SW interrupt
 	{
 		exec_timer.getInterruptCause();					// clears the interrupt condition
-		if (st_pre.buffer_state == PREP_BUFFER_OWNED_BY_EXEC) {
+		if ((_prep_queue_is_free() == true) && (_sim_exec_held() == false)) {
+			uint16_t start = hw_get_plan_timer();
 			if (mp_exec_move() != STAT_NOOP) {
-				st_pre.buffer_state = PREP_BUFFER_OWNED_BY_LOADER; // flip it back
+				_record_exec_time(start);
 				_request_load_move();
+				st_request_exec_move();					// prep the next one while there is room
 			}
 		}
 	}
@@ -596,7 +834,7 @@ static void _request_load_move()
 	if (st_runtime_isbusy()) {
 		return;													// don't request a load if the runtime is busy
 	}
-	if (st_pre.buffer_state == PREP_BUFFER_OWNED_BY_LOADER) {	// bother interrupting
+	if (st_pre.load_index != st_pre.prep_index) {				// bother interrupting
 		TIMER_LOAD.PER = LOAD_TIMER_PERIOD;
 		TIMER_LOAD.CTRLA = LOAD_TIMER_ENABLE;					// trigger a HI interrupt
 	}
@@ -614,7 +852,7 @@ static void _request_load_move()
 	if (st_runtime_isbusy()) {
 		return;													// don't request a load if the runtime is busy
 	}
-	if (st_pre.buffer_state == PREP_BUFFER_OWNED_BY_LOADER) {	// bother interrupting
+	if (st_pre.load_index != st_pre.prep_index) {				// bother interrupting
 		load_timer.setInterruptPending();
 	}
 }
@@ -635,6 +873,14 @@ namespace Motate {	// Define timer inside Motate namespace
  *	higher level as the DDA or dwell ISR. A software interrupt has been
  *	provided to allow a non-ISR to request a load (see st_request_load_move())
  *
+ *	It takes the oldest entry of the prep queue and hands it back to the exec by advancing
+ *	load_index once it is done with it - after a command has run, so the exec cannot
+ *	reuse the entry or the command's buffer early.
+ *
+ *	A line segment is timed from here to the DDA timer start, which is the gap it leaves
+ *	in the pulse train. Dwells, commands and dry run loads are not timed. An S or coolant
+ *	command riding on the segment runs once the DDA is started, outside that window.
+ *
  *	In aline() code:
  *	 - All axes must set steps and compensate for out-of-range pulse phasing.
  *	 - If axis has 0 steps the direction setting can be omitted
@@ -649,19 +895,29 @@ static void _load_move()
 	if (st_runtime_isbusy()) {
 		return;													// 当运行时处于繁忙的时候退出
 	}
-	if (st_pre.buffer_state != PREP_BUFFER_OWNED_BY_LOADER) {	// 如果没有运动需要加载....
+	if (st_pre.load_index == st_pre.prep_index) {				// 如果没有运动需要加载....
 //		for (uint8_t motor = MOTOR_1; motor < MOTORS; motor++) {
 //			st_run.mot[motor].power_state = MOTOR_POWER_TIMEOUT_START;	// ...start motor power timeouts
 //		}
 		return;
 	}
+	uint16_t start = hw_get_plan_timer();
+	stSegment_t *seg = &st_pre.seg[st_pre.load_index & PREP_QUEUE_MASK];
+
+	if (st_sim.enable == true) {								// dry run - nothing reaches the hardware
+		if (seg->sync_func != NULL) {
+			seg->sync_func(&seg->sync_value, &seg->sync_value);
+		}
+		_load_sim_move(seg);
+		return;
+	}
 	// 首先处理线段加载（大多数为该类型）
-	if (st_pre.move_type == MOVE_TYPE_ALINE) {
+	if (seg->move_type == MOVE_TYPE_ALINE) {
 
 		//**** 设置新的segment ****
 
-		st_run.dda_ticks_downcount = st_pre.dda_ticks;
-		st_run.dda_ticks_X_substeps = st_pre.dda_ticks_X_substeps;
+		st_run.dda_ticks_downcount = seg->dda_ticks;
+		st_run.dda_ticks_X_substeps = seg->dda_ticks_X_substeps;
 
 		//**** MOTOR_1 加载 ****
 
@@ -669,30 +925,29 @@ static void _load_move()
 		// is supposed to take < 10 uSec (Xmega). Be careful if you mess with this.
 
 		// the following if() statement sets the runtime substep increment value or zeroes it
-		if ((st_run.mot[MOTOR_1].substep_increment = st_pre.mot[MOTOR_1].substep_increment) != 0) {
+		if ((st_run.mot[MOTOR_1].substep_increment = seg->mot[MOTOR_1].substep_increment) != 0) {
 
 			// NB: If motor has 0 steps the following is all skipped. This ensures that state comparisons
 			//	   always operate on the last segment actually run by this motor, regardless of how many
 			//	   segments it may have been inactive in between.
 
 			// Apply accumulator correction if the time base has changed since previous segment
-			if (st_pre.mot[MOTOR_1].accumulator_correction_flag == true) {
-				st_pre.mot[MOTOR_1].accumulator_correction_flag = false;
-				st_run.mot[MOTOR_1].substep_accumulator *= st_pre.mot[MOTOR_1].accumulator_correction;
+			if (seg->mot[MOTOR_1].accumulator_correction_flag == true) {
+				st_run.mot[MOTOR_1].substep_accumulator *= seg->mot[MOTOR_1].accumulator_correction;
 			}
 
 			// Detect direction change and if so:
 			//	- Set the direction bit in hardware.
 			//	- Compensate for direction change by flipping substep accumulator value about its midpoint.
 
-			if (st_pre.mot[MOTOR_1].direction != st_pre.mot[MOTOR_1].prev_direction) {
-				st_pre.mot[MOTOR_1].prev_direction = st_pre.mot[MOTOR_1].direction;
+			if (seg->mot[MOTOR_1].direction != st_run.mot[MOTOR_1].prev_direction) {
+				st_run.mot[MOTOR_1].prev_direction = seg->mot[MOTOR_1].direction;
 				st_run.mot[MOTOR_1].substep_accumulator = -(st_run.dda_ticks_X_substeps + st_run.mot[MOTOR_1].substep_accumulator);
-				if (st_pre.mot[MOTOR_1].direction == DIRECTION_CW)
+				if (seg->mot[MOTOR_1].direction == DIRECTION_CW)
 				PORT_MOTOR_1_VPORT.OUT &= ~DIRECTION_BIT_bm; else
 				PORT_MOTOR_1_VPORT.OUT |= DIRECTION_BIT_bm;
 			}
-			SET_ENCODER_STEP_SIGN(MOTOR_1, st_pre.mot[MOTOR_1].step_sign);
+			SET_ENCODER_STEP_SIGN(MOTOR_1, seg->mot[MOTOR_1].step_sign);
 
 			// 使能stepper 并启动电机电源管理
 			if (st_cfg.mot[MOTOR_1].power_mode != MOTOR_DISABLED) {
@@ -711,19 +966,18 @@ static void _load_move()
 		ACCUMULATE_ENCODER(MOTOR_1);
 
 #if (MOTORS >= 2)	//**** MOTOR_2 LOAD ****
-		if ((st_run.mot[MOTOR_2].substep_increment = st_pre.mot[MOTOR_2].substep_increment) != 0) {
-			if (st_pre.mot[MOTOR_2].accumulator_correction_flag == true) {
-				st_pre.mot[MOTOR_2].accumulator_correction_flag = false;
-				st_run.mot[MOTOR_2].substep_accumulator *= st_pre.mot[MOTOR_2].accumulator_correction;
+		if ((st_run.mot[MOTOR_2].substep_increment = seg->mot[MOTOR_2].substep_increment) != 0) {
+			if (seg->mot[MOTOR_2].accumulator_correction_flag == true) {
+				st_run.mot[MOTOR_2].substep_accumulator *= seg->mot[MOTOR_2].accumulator_correction;
 			}
-			if (st_pre.mot[MOTOR_2].direction != st_pre.mot[MOTOR_2].prev_direction) {
-				st_pre.mot[MOTOR_2].prev_direction = st_pre.mot[MOTOR_2].direction;
+			if (seg->mot[MOTOR_2].direction != st_run.mot[MOTOR_2].prev_direction) {
+				st_run.mot[MOTOR_2].prev_direction = seg->mot[MOTOR_2].direction;
 				st_run.mot[MOTOR_2].substep_accumulator = -(st_run.dda_ticks_X_substeps + st_run.mot[MOTOR_2].substep_accumulator);
-				if (st_pre.mot[MOTOR_2].direction == DIRECTION_CW)
+				if (seg->mot[MOTOR_2].direction == DIRECTION_CW)
 				PORT_MOTOR_2_VPORT.OUT &= ~DIRECTION_BIT_bm; else
 				PORT_MOTOR_2_VPORT.OUT |= DIRECTION_BIT_bm;
 			}
-			SET_ENCODER_STEP_SIGN(MOTOR_2, st_pre.mot[MOTOR_2].step_sign);
+			SET_ENCODER_STEP_SIGN(MOTOR_2, seg->mot[MOTOR_2].step_sign);
 			if (st_cfg.mot[MOTOR_2].power_mode != MOTOR_DISABLED) {
 				PORT_MOTOR_2_VPORT.OUT &= ~MOTOR_ENABLE_BIT_bm;
 				st_run.mot[MOTOR_2].power_state = MOTOR_POWER_TIMEOUT_START;
@@ -737,19 +991,18 @@ static void _load_move()
 		ACCUMULATE_ENCODER(MOTOR_2);
 #endif
 #if (MOTORS >= 3)	//**** MOTOR_3 LOAD ****
-		if ((st_run.mot[MOTOR_3].substep_increment = st_pre.mot[MOTOR_3].substep_increment) != 0) {
-			if (st_pre.mot[MOTOR_3].accumulator_correction_flag == true) {
-				st_pre.mot[MOTOR_3].accumulator_correction_flag = false;
-				st_run.mot[MOTOR_3].substep_accumulator *= st_pre.mot[MOTOR_3].accumulator_correction;
+		if ((st_run.mot[MOTOR_3].substep_increment = seg->mot[MOTOR_3].substep_increment) != 0) {
+			if (seg->mot[MOTOR_3].accumulator_correction_flag == true) {
+				st_run.mot[MOTOR_3].substep_accumulator *= seg->mot[MOTOR_3].accumulator_correction;
 			}
-			if (st_pre.mot[MOTOR_3].direction != st_pre.mot[MOTOR_3].prev_direction) {
-				st_pre.mot[MOTOR_3].prev_direction = st_pre.mot[MOTOR_3].direction;
+			if (seg->mot[MOTOR_3].direction != st_run.mot[MOTOR_3].prev_direction) {
+				st_run.mot[MOTOR_3].prev_direction = seg->mot[MOTOR_3].direction;
 				st_run.mot[MOTOR_3].substep_accumulator = -(st_run.dda_ticks_X_substeps + st_run.mot[MOTOR_3].substep_accumulator);
-				if (st_pre.mot[MOTOR_3].direction == DIRECTION_CW)
+				if (seg->mot[MOTOR_3].direction == DIRECTION_CW)
 				PORT_MOTOR_3_VPORT.OUT &= ~DIRECTION_BIT_bm; else
 				PORT_MOTOR_3_VPORT.OUT |= DIRECTION_BIT_bm;
 			}
-			SET_ENCODER_STEP_SIGN(MOTOR_3, st_pre.mot[MOTOR_3].step_sign);
+			SET_ENCODER_STEP_SIGN(MOTOR_3, seg->mot[MOTOR_3].step_sign);
 			if (st_cfg.mot[MOTOR_3].power_mode != MOTOR_DISABLED) {
 				PORT_MOTOR_3_VPORT.OUT &= ~MOTOR_ENABLE_BIT_bm;
 				st_run.mot[MOTOR_3].power_state = MOTOR_POWER_TIMEOUT_START;
@@ -763,19 +1016,18 @@ static void _load_move()
 		ACCUMULATE_ENCODER(MOTOR_3);
 #endif
 #if (MOTORS >= 4)  //**** MOTOR_4 LOAD ****
-		if ((st_run.mot[MOTOR_4].substep_increment = st_pre.mot[MOTOR_4].substep_increment) != 0) {
-			if (st_pre.mot[MOTOR_4].accumulator_correction_flag == true) {
-				st_pre.mot[MOTOR_4].accumulator_correction_flag = false;
-				st_run.mot[MOTOR_4].substep_accumulator *= st_pre.mot[MOTOR_4].accumulator_correction;
+		if ((st_run.mot[MOTOR_4].substep_increment = seg->mot[MOTOR_4].substep_increment) != 0) {
+			if (seg->mot[MOTOR_4].accumulator_correction_flag == true) {
+				st_run.mot[MOTOR_4].substep_accumulator *= seg->mot[MOTOR_4].accumulator_correction;
 			}
-			if (st_pre.mot[MOTOR_4].direction != st_pre.mot[MOTOR_4].prev_direction) {
-				st_pre.mot[MOTOR_4].prev_direction = st_pre.mot[MOTOR_4].direction;
+			if (seg->mot[MOTOR_4].direction != st_run.mot[MOTOR_4].prev_direction) {
+				st_run.mot[MOTOR_4].prev_direction = seg->mot[MOTOR_4].direction;
 				st_run.mot[MOTOR_4].substep_accumulator = -(st_run.dda_ticks_X_substeps + st_run.mot[MOTOR_4].substep_accumulator);
-				if (st_pre.mot[MOTOR_4].direction == DIRECTION_CW)
+				if (seg->mot[MOTOR_4].direction == DIRECTION_CW)
 				PORT_MOTOR_4_VPORT.OUT &= ~DIRECTION_BIT_bm; else
 				PORT_MOTOR_4_VPORT.OUT |= DIRECTION_BIT_bm;
 			}
-			SET_ENCODER_STEP_SIGN(MOTOR_4, st_pre.mot[MOTOR_4].step_sign);
+			SET_ENCODER_STEP_SIGN(MOTOR_4, seg->mot[MOTOR_4].step_sign);
 			if (st_cfg.mot[MOTOR_4].power_mode != MOTOR_DISABLED) {
 				PORT_MOTOR_4_VPORT.OUT &= ~MOTOR_ENABLE_BIT_bm;
 				st_run.mot[MOTOR_4].power_state = MOTOR_POWER_TIMEOUT_START;
@@ -789,21 +1041,20 @@ static void _load_move()
 		ACCUMULATE_ENCODER(MOTOR_4);
 #endif
 #if (MOTORS >= 5)	//**** MOTOR_5 LOAD ****
-		if ((st_run.mot[MOTOR_5].substep_increment = st_pre.mot[MOTOR_5].substep_increment) != 0) {
-			if (st_pre.mot[MOTOR_5].accumulator_correction_flag == true) {
-				st_pre.mot[MOTOR_5].accumulator_correction_flag = false;
-				st_run.mot[MOTOR_5].substep_accumulator *= st_pre.mot[MOTOR_5].accumulator_correction;
+		if ((st_run.mot[MOTOR_5].substep_increment = seg->mot[MOTOR_5].substep_increment) != 0) {
+			if (seg->mot[MOTOR_5].accumulator_correction_flag == true) {
+				st_run.mot[MOTOR_5].substep_accumulator *= seg->mot[MOTOR_5].accumulator_correction;
 			}
-			if (st_pre.mot[MOTOR_5].direction != st_pre.mot[MOTOR_5].prev_direction) {
-				st_pre.mot[MOTOR_5].prev_direction = st_pre.mot[MOTOR_5].direction;
+			if (seg->mot[MOTOR_5].direction != st_run.mot[MOTOR_5].prev_direction) {
+				st_run.mot[MOTOR_5].prev_direction = seg->mot[MOTOR_5].direction;
 				st_run.mot[MOTOR_5].substep_accumulator = -(st_run.dda_ticks_X_substeps + st_run.mot[MOTOR_5].substep_accumulator);
-				if (st_pre.mot[MOTOR_5].direction == DIRECTION_CW)
+				if (seg->mot[MOTOR_5].direction == DIRECTION_CW)
 				PORT_MOTOR_5_VPORT.OUT &= ~DIRECTION_BIT_bm; else
 				PORT_MOTOR_5_VPORT.OUT |= DIRECTION_BIT_bm;
 			}
 			PORT_MOTOR_5_VPORT.OUT &= ~MOTOR_ENABLE_BIT_bm;
 			st_run.mot[MOTOR_5].power_state = MOTOR_POWER_TIMEOUT_START;
-			SET_ENCODER_STEP_SIGN(MOTOR_5, st_pre.mot[MOTOR_5].step_sign);
+			SET_ENCODER_STEP_SIGN(MOTOR_5, seg->mot[MOTOR_5].step_sign);
 		} else {
 			if (st_cfg.mot[MOTOR_5].power_mode == MOTOR_POWERED_IN_CYCLE) {
 				PORT_MOTOR_5_VPORT.OUT &= ~MOTOR_ENABLE_BIT_bm;
@@ -813,21 +1064,20 @@ static void _load_move()
 		ACCUMULATE_ENCODER(MOTOR_5);
 #endif
 #if (MOTORS >= 6)	//**** MOTOR_6 LOAD ****
-		if ((st_run.mot[MOTOR_6].substep_increment = st_pre.mot[MOTOR_6].substep_increment) != 0) {
-			if (st_pre.mot[MOTOR_6].accumulator_correction_flag == true) {
-				st_pre.mot[MOTOR_6].accumulator_correction_flag = false;
-				st_run.mot[MOTOR_6].substep_accumulator *= st_pre.mot[MOTOR_6].accumulator_correction;
+		if ((st_run.mot[MOTOR_6].substep_increment = seg->mot[MOTOR_6].substep_increment) != 0) {
+			if (seg->mot[MOTOR_6].accumulator_correction_flag == true) {
+				st_run.mot[MOTOR_6].substep_accumulator *= seg->mot[MOTOR_6].accumulator_correction;
 			}
-			if (st_pre.mot[MOTOR_6].direction != st_pre.mot[MOTOR_6].prev_direction) {
-				st_pre.mot[MOTOR_6].prev_direction = st_pre.mot[MOTOR_6].direction;
+			if (seg->mot[MOTOR_6].direction != st_run.mot[MOTOR_6].prev_direction) {
+				st_run.mot[MOTOR_6].prev_direction = seg->mot[MOTOR_6].direction;
 				st_run.mot[MOTOR_6].substep_accumulator = -(st_run.dda_ticks_X_substeps + st_run.mot[MOTOR_6].substep_accumulator);
-				if (st_pre.mot[MOTOR_6].direction == DIRECTION_CW)
+				if (seg->mot[MOTOR_6].direction == DIRECTION_CW)
 				PORT_MOTOR_6_VPORT.OUT &= ~DIRECTION_BIT_bm; else
 				PORT_MOTOR_6_VPORT.OUT |= DIRECTION_BIT_bm;
 			}
 			PORT_MOTOR_6_VPORT.OUT &= ~MOTOR_ENABLE_BIT_bm;
 			st_run.mot[MOTOR_6].power_state = MOTOR_POWER_TIMEOUT_START;
-			SET_ENCODER_STEP_SIGN(MOTOR_6, st_pre.mot[MOTOR_6].step_sign);
+			SET_ENCODER_STEP_SIGN(MOTOR_6, seg->mot[MOTOR_6].step_sign);
 		} else {
 			if (st_cfg.mot[MOTOR_6].power_mode == MOTOR_POWERED_IN_CYCLE) {
 				PORT_MOTOR_6_VPORT.OUT &= ~MOTOR_ENABLE_BIT_bm;
@@ -838,26 +1088,58 @@ static void _load_move()
 #endif
 		//**** do this last ****
 
-		TIMER_DDA.PER = st_pre.dda_period;
+		TIMER_DDA.PER = seg->dda_period;
 		TIMER_DDA.CTRLA = STEP_TIMER_ENABLE;			// enable the DDA timer
+		_record_load_time(start);
 
 	// 处理dwell 
-	} else if (st_pre.move_type == MOVE_TYPE_DWELL) {
-		st_run.dda_ticks_downcount = st_pre.dda_ticks;
-		TIMER_DWELL.PER = st_pre.dda_period;			// load dwell timer period
+	} else if (seg->move_type == MOVE_TYPE_DWELL) {
+		st_run.dda_ticks_downcount = seg->dda_ticks;
+		TIMER_DWELL.PER = seg->dda_period;				// load dwell timer period
 		TIMER_DWELL.CTRLA = STEP_TIMER_ENABLE;			// enable the dwell timer
 
 	// 处理同步命令 
-	} else if (st_pre.move_type == MOVE_TYPE_COMMAND) {
-		mp_runtime_command(st_pre.bf);
+	} else if (seg->move_type == MOVE_TYPE_COMMAND) {
+		mp_runtime_command(seg->bf);
 	}
 
 	// all other cases drop to here (e.g. Null moves after Mcodes skip to here)
-	st_pre.move_type = MOVE_TYPE_NULL;
-	st_pre.buffer_state = PREP_BUFFER_OWNED_BY_EXEC;	// we are done with the prep buffer - flip the flag back
+	if (seg->sync_func != NULL) {						// S or coolant command riding on this load
+		seg->sync_func(&seg->sync_value, &seg->sync_value);
+	}
+	_free_prep_segment();								// we are done with the entry - hand it back to the exec
 	st_request_exec_move();								// exec and prep next move
 }
 
+/*
+ * _load_sim_move() - _load_move() for dry run: count the segment and give the entry back
+ *
+ *	The DDA and dwell timers are never started, so the runtime is never busy and the
+ *	exec is asked for the next segment right away, unless it is held (see st_set_sim()).
+ *	Commands still run so the model follows the program (M-code exec functions test
+ *	st_sim.enable themselves).
+ */
+
+static void _load_sim_move(stSegment_t *seg)
+{
+	if (seg->move_type == MOVE_TYPE_ALINE) {
+		st_sim.segments++;
+		st_sim.dda_ticks += seg->dda_ticks;
+		while (st_sim.dda_ticks >= (uint32_t)FREQUENCY_DDA) {	// segments are milliseconds long
+			st_sim.dda_ticks -= (uint32_t)FREQUENCY_DDA;
+			st_sim.seconds++;
+		}
+	} else if (seg->move_type == MOVE_TYPE_DWELL) {
+		st_sim.dwell_ticks += seg->dda_ticks;
+		st_sim.seconds += st_sim.dwell_ticks / (uint32_t)FREQUENCY_DWELL;
+		st_sim.dwell_ticks %= (uint32_t)FREQUENCY_DWELL;
+	} else if (seg->move_type == MOVE_TYPE_COMMAND) {
+		mp_runtime_command(seg->bf);
+	}
+	_free_prep_segment();
+	st_request_exec_move();
+}
+
 /***********************************************************************************
  * st_prep_line() - 为loader加载下一段运动
  *
@@ -885,8 +1167,10 @@ static void _load_move()
 
 stat_t st_prep_line(float travel_steps[], float following_error[], float segment_time)
 {
+	uint16_t start = hw_get_plan_timer();
+
 	// trap conditions that would prevent queueing the line
-	if (st_pre.buffer_state != PREP_BUFFER_OWNED_BY_EXEC) {
+	if (_prep_queue_is_free() != true) {
 		return (cm_hard_alarm(STAT_INTERNAL_ERROR));
 	} else if (isinf(segment_time)) { return (cm_hard_alarm(STAT_PREP_LINE_MOVE_TIME_IS_INFINITE));	// never supposed to happen
 	} else if (isnan(segment_time)) { return (cm_hard_alarm(STAT_PREP_LINE_MOVE_TIME_IS_NAN));		// never supposed to happen
@@ -896,9 +1180,10 @@ stat_t st_prep_line(float travel_steps[], float following_error[], float segment
 	// - dda_ticks is the integer number of DDA clock ticks needed to play out the segment
 	// - ticks_X_substeps is the maximum depth of the DDA accumulator (as a negative number)
 
-	st_pre.dda_period = _f_to_period(FREQUENCY_DDA);
-	st_pre.dda_ticks = (int32_t)(segment_time * 60 * FREQUENCY_DDA);// NB:转化分钟到秒 
-	st_pre.dda_ticks_X_substeps = st_pre.dda_ticks * DDA_SUBSTEPS;
+	stSegment_t *seg = _get_prep_segment();
+	seg->dda_period = _f_to_period(FREQUENCY_DDA);
+	seg->dda_ticks = (int32_t)(segment_time * 60 * FREQUENCY_DDA);// NB:转化分钟到秒 
+	seg->dda_ticks_X_substeps = seg->dda_ticks * DDA_SUBSTEPS;
 
 	// setup motor parameters
 
@@ -906,27 +1191,28 @@ stat_t st_prep_line(float travel_steps[], float following_error[], float segment
 	for (uint8_t motor=0; motor<MOTORS; motor++) {	// I want to remind myself that this is motors, not axes
 
 		// Skip this motor if there are no new steps. Leave all other values intact.
-		if (fp_ZERO(travel_steps[motor])) { st_pre.mot[motor].substep_increment = 0; continue;}
+		if (fp_ZERO(travel_steps[motor])) { seg->mot[motor].substep_increment = 0; continue;}
 
 		// Setup the direction, compensating for polarity.
 		// Set the step_sign which is used by the stepper ISR to accumulate step position
 
 		if (travel_steps[motor] >= 0) {					// positive direction
-			st_pre.mot[motor].direction = DIRECTION_CW ^ st_cfg.mot[motor].polarity;
-			st_pre.mot[motor].step_sign = 1;
+			seg->mot[motor].direction = DIRECTION_CW ^ st_cfg.mot[motor].polarity;
+			seg->mot[motor].step_sign = 1;
 		} else {
-			st_pre.mot[motor].direction = DIRECTION_CCW ^ st_cfg.mot[motor].polarity;
-			st_pre.mot[motor].step_sign = -1;
+			seg->mot[motor].direction = DIRECTION_CCW ^ st_cfg.mot[motor].polarity;
+			seg->mot[motor].step_sign = -1;
 		}
 
 		// Detect segment time changes and setup the accumulator correction factor and flag.
 		// Putting this here computes the correct factor even if the motor was dormant for some
 		// number of previous moves. Correction is computed based on the last segment time actually used.
 
+		seg->mot[motor].accumulator_correction_flag = false;
 		if (fabs(segment_time - st_pre.mot[motor].prev_segment_time) > 0.0000001) { // highly tuned FP != compare
 			if (fp_NOT_ZERO(st_pre.mot[motor].prev_segment_time)) {					// special case to skip first move
-				st_pre.mot[motor].accumulator_correction_flag = true;
-				st_pre.mot[motor].accumulator_correction = segment_time / st_pre.mot[motor].prev_segment_time;
+				seg->mot[motor].accumulator_correction_flag = true;
+				seg->mot[motor].accumulator_correction = segment_time / st_pre.mot[motor].prev_segment_time;
 			}
 			st_pre.mot[motor].prev_segment_time = segment_time;
 		}
@@ -954,21 +1240,24 @@ stat_t st_prep_line(float travel_steps[], float following_error[], float segment
 		// Rounding is performed to eliminate a negative bias in the uint32 conversion
 		// that results in long-term negative drift. (fabs/round order doesn't matter)
 
-		st_pre.mot[motor].substep_increment = round(fabs(travel_steps[motor] * DDA_SUBSTEPS));
+		seg->mot[motor].substep_increment = round(fabs(travel_steps[motor] * DDA_SUBSTEPS));
 	}
-	st_pre.move_type = MOVE_TYPE_ALINE;
-	st_pre.buffer_state = PREP_BUFFER_OWNED_BY_LOADER;	// signal that prep buffer is ready
+	_commit_prep_segment(seg, MOVE_TYPE_ALINE);			// signal that the entry is ready
+
+	uint16_t ticks = hw_get_plan_timer() - start;
+	if (ticks < st_tm.prep_min) { st_tm.prep_min = ticks;}
+	if (ticks > st_tm.prep_max) { st_tm.prep_max = ticks;}
 	return (STAT_OK);
 }
 
 /*
  * st_prep_null() - Keeps the loader happy. Otherwise performs no action
+ *
+ *	Nothing is queued, so the prep queue is left as it is.
  */
 
 void st_prep_null()
 {
-	st_pre.move_type = MOVE_TYPE_NULL;
-	st_pre.buffer_state = PREP_BUFFER_OWNED_BY_EXEC;	// signal that prep buffer is empty
 }
 
 /*
@@ -977,9 +1266,9 @@ void st_prep_null()
 
 void st_prep_command(void *bf)
 {
-	st_pre.move_type = MOVE_TYPE_COMMAND;
-	st_pre.bf = (mpBuf_t *)bf;
-	st_pre.buffer_state = PREP_BUFFER_OWNED_BY_LOADER;	// signal that prep buffer is ready
+	stSegment_t *seg = _get_prep_segment();
+	seg->bf = (mpBuf_t *)bf;
+	_commit_prep_segment(seg, MOVE_TYPE_COMMAND);		// signal that the entry is ready
 }
 
 /*
@@ -988,10 +1277,10 @@ void st_prep_command(void *bf)
 
 void st_prep_dwell(float microseconds)
 {
-	st_pre.move_type = MOVE_TYPE_DWELL;
-	st_pre.dda_period = _f_to_period(FREQUENCY_DWELL);
-	st_pre.dda_ticks = (uint32_t)((microseconds/1000000) * FREQUENCY_DWELL);
-	st_pre.buffer_state = PREP_BUFFER_OWNED_BY_LOADER;	// signal that prep buffer is ready
+	stSegment_t *seg = _get_prep_segment();
+	seg->dda_period = _f_to_period(FREQUENCY_DWELL);
+	seg->dda_ticks = (uint32_t)((microseconds/1000000) * FREQUENCY_DWELL);
+	_commit_prep_segment(seg, MOVE_TYPE_DWELL);			// signal that the entry is ready
 }
 
 /*
@@ -1066,8 +1355,17 @@ static void _set_motor_steps_per_unit(nvObj_t *nv)
  * st_set_mi() - 设置电机细分
  * st_set_pm() - 设置电机电源模式
  * st_set_pl() - 设置电机电源等级
+ * st_set_ma() - set the axis a motor is mapped to (only axes the build computes, see MOTION_AXES)
  */
 
+stat_t st_set_ma(nvObj_t *nv)			// motor map
+{
+	if ((uint8_t)nv->value >= MOTION_AXES)
+		return (STAT_INPUT_VALUE_RANGE_ERROR);
+	set_ui8(nv);
+	return (STAT_OK);
+}
+
 stat_t st_set_sa(nvObj_t *nv)			// 电机步进角 
 {
 	set_flt(nv);
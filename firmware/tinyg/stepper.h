@@ -159,7 +159,7 @@
  *		- the "segment", usually 5ms worth of pulses
  *
  *	  - When the current segment is finished the stepper interrupt LOADs the next segment
- *		from the prep buffer, reloads the timers, and starts the next segment. At the end
+ *		from the prep queue, reloads the timers, and starts the next segment. At the end
  *		of the load the stepper interrupt routine requests an "exec" of the next move in
  *		order to prepare for the next load operation. It does this by calling the exec
  *		using a software interrupt (actually a timer, since that's all we've got).
@@ -176,7 +176,7 @@
  *
  *	  - Once the segment has been computed the exec handler finshes up by running the
  *		PREP routine in stepper.c. This computes the DDA values and gets the segment
- *		into the prep buffer - and ready for the next LOAD operation.
+ *		into the prep queue - and ready for the next LOAD operation.
  *
  *	  - The main loop runs in background to receive gcode blocks, parse them, and send
  *		them to the planner in order to keep the planner queue full so that when the
@@ -249,11 +249,6 @@
  *********************************/
 //See hardware.h for platform specific stepper definitions
 
-enum prepBufferState {
-	PREP_BUFFER_OWNED_BY_LOADER = 0,	// staging buffer is ready for load
-	PREP_BUFFER_OWNED_BY_EXEC			// staging buffer is being loaded
-};
-
 // Currently there is no distinction between IDLE and OFF (DEENERGIZED)
 // In the future IDLE will be powered at a low, torque-maintaining current
 
@@ -298,14 +293,14 @@ enum cmMotorPowerMode {
  *
  *		MAX_LONG == 2^31, maximum signed long (depth of accumulator. NB: accumulator values are negative)
  *		FREQUENCY_DDA == DDA clock rate in Hz.
- *		NOM_SEGMENT_TIME == upper bound of segment time in minutes
+ *		MAX_SEGMENT_TIME == upper bound of segment time in minutes (body segments, see planner.h)
  *		0.90 == a safety factor used to reduce the result from theoretical maximum
  *
- *	The number is about 8.5 million for the Xmega running a 50 KHz DDA with 5 millisecond segments
- *	The ARM is about 1/4 that (or less) as the DDA clock rate is 4x higher. Decreasing the nominal
- *	segment time increases the number precision.
+ *	The number is about 3.9 million for the Xmega running a 50 KHz DDA with 10 millisecond body
+ *	segments. The ARM is about 1/4 that (or less) as the DDA clock rate is 4x higher. Decreasing
+ *	the longest segment time increases the number precision.
  */
-#define DDA_SUBSTEPS ((MAX_LONG * 0.90) / (FREQUENCY_DDA * (NOM_SEGMENT_TIME * 60)))
+#define DDA_SUBSTEPS ((MAX_LONG * 0.90) / (FREQUENCY_DDA * (MAX_SEGMENT_TIME * 60)))
 
 /* Step correction settings
  *	Step correction settings determine how the encoder error is fed back to correct position errors.
@@ -321,6 +316,43 @@ enum cmMotorPowerMode {
 #define STEP_CORRECTION_HOLDOFF		 	 	  5		// minimum number of segments to wait between error correction
 #define STEP_INITIAL_DIRECTION		DIRECTION_CW
 
+/* Exec and load time budgets
+ *	The exec ISR and the loader time themselves against the budgets in the timing
+ *	illustration above (see st_tm below). Times are taken from the free running plan timer
+ *	(hw_get_plan_timer(), PLAN_TIMER_USEC ticks) and are wall time, so an exec includes
+ *	the DDA, load and serial interrupts that cut into it - which is what the next load
+ *	waits on. At 2 uSec a tick a load reads about 5 ticks: coarse, but one over budget shows.
+ */
+#ifndef EXEC_BUDGET_USEC
+#define EXEC_BUDGET_USEC			400		// exec and prep of a segment
+#endif
+#ifndef LOAD_BUDGET_USEC
+#define LOAD_BUDGET_USEC			10		// load of a line segment
+#endif
+#define EXEC_BUDGET_TICKS			(EXEC_BUDGET_USEC / PLAN_TIMER_USEC)
+#define LOAD_BUDGET_TICKS			(LOAD_BUDGET_USEC / PLAN_TIMER_USEC)
+#define TIMING_BUCKETS				6		// quarters of the budget. The last is 5/4 and over
+
+/* Prep queue
+ *	The exec hands prepped segments, dwells and commands to the loader through a ring of
+ *	PREP_QUEUE_DEPTH entries (st_pre.seg). The exec is the only writer of prep_index and
+ *	the loader of load_index, so neither side locks the other out. The indexes run free
+ *	over 8 bits and are masked into the ring, which is why the depth is a power of 2.
+ *
+ *	With room in the ring the exec runs ahead of the loader, so an exec pass that costs
+ *	more than a segment time - the first segment of a new block, a feedhold replan - eats
+ *	into the queued segments instead of starving the DDA. The other side of that is
+ *	feedhold latency: the first decelerating segment runs after the ones already queued,
+ *	up to a segment time (5 to 10 ms) later for every entry of depth past the first.
+ *
+ *	The exec stops behind a queued command until the loader has run it, as the command's
+ *	planner buffer is the run buffer until mp_runtime_command() frees it.
+ */
+#ifndef PREP_QUEUE_DEPTH
+#define PREP_QUEUE_DEPTH			2		// segments the exec may prep ahead. 1, 2, 4 ... 128
+#endif
+#define PREP_QUEUE_MASK				(PREP_QUEUE_DEPTH-1)
+
 /*
  * Stepper control structures
  *
@@ -365,6 +397,7 @@ typedef struct stConfig {				// 步进电机配置
 typedef struct stRunMotor {				// one per controlled motor
 	uint32_t substep_increment;			// total steps in axis times substeps factor
 	int32_t substep_accumulator;		// DDA 相位角累加器 
+	uint8_t prev_direction;				// 当前电机前一段segment的电机运行方向
 	uint8_t power_state;				// 用于管理电机电源的状态机
 	uint32_t power_systick;				// sys_tick for next motor power state transition
 	float power_level_dynamic;			// power level for this segment of idle (ARM only)
@@ -378,43 +411,92 @@ typedef struct stRunSingleton {			// 步进机静态值和轴参数
 	uint16_t magic_end;
 } stRunSingleton_t;
 
-// Motor prep structure. Used by exec/prep ISR (MED) and read-only during load
-// Must be careful about volatiles in this one
+// Prep queue entry, per motor. Written by the exec/prep ISR (MED), read-only during load
 
-typedef struct stPrepMotor {
-	uint32_t substep_increment;	 		// total steps in axis times substep factor
+typedef struct stSegmentMotor {
+	uint32_t substep_increment;	 		// total steps in axis times substep factor. 0 = motor idle
 
 	// direction and direction change
 	int8_t direction;					// travel direction corrected for polarity
-	uint8_t prev_direction;				// 当前电机前一段segment的电机运行方向
 	int8_t step_sign;					// set to +1 or -1 for encoders
 
-	// following error correction
-	int32_t correction_holdoff;			// count down segments between corrections
-	float corrected_steps;				// accumulated correction steps for the cycle (for diagnostic display only)
-
 	// accumulator phase correction
-	float prev_segment_time;			// segment time from previous segment run for this motor
 	float accumulator_correction;		// factor for adjusting accumulator between segments
 	uint8_t accumulator_correction_flag;// signals accumulator needs correction
+} stSegmentMotor_t;
 
-} stPrepMotor_t;
-
-typedef struct stPrepSingleton {
-	uint16_t magic_start;				// “魔法数”  用于测试内存完整性 
-	volatile uint8_t buffer_state;		// 预备缓冲状态 - 属于exec定时器或者loader定时器
+typedef struct stSegment {				// one prepped segment, dwell or command
 	struct mpBuffer *bf;				// 静态指针，指向相关的buffer
 	uint8_t move_type;					// 运动类型(线段运动，同步命令或者dwell)
+	void (*sync_func)(float[], float[]);	// command to run with this load, ahead of it (see mp_queue_sync_command())
+	float sync_value;					// ...and its argument
 
 	uint16_t dda_period;				// DDA或者Dwell时钟周期设置
 	uint32_t dda_ticks;					// DDA or dwell ticks for the move
 	uint32_t dda_ticks_X_substeps;		// DDA ticks scaled by substep factor
+	stSegmentMotor_t mot[MOTORS];
+} stSegment_t;
+
+// Motor prep structure. Prep state carried from segment to segment - exec/prep ISR (MED) only
+
+typedef struct stPrepMotor {
+	// following error correction
+	int32_t correction_holdoff;			// count down segments between corrections
+	float corrected_steps;				// accumulated correction steps for the cycle (for diagnostic display only)
+
+	// accumulator phase correction
+	float prev_segment_time;			// segment time from previous segment run for this motor
+} stPrepMotor_t;
+
+typedef struct stPrepSingleton {
+	uint16_t magic_start;				// “魔法数”  用于测试内存完整性 
+	volatile uint8_t prep_index;		// next entry the exec fills - written by the exec only
+	volatile uint8_t load_index;		// next entry the loader takes - written by the loader only
+	uint8_t command_queued;				// the last entry prepped is a command (see PREP_QUEUE_DEPTH)
+	void (*sync_func)(float[], float[]);	// command for the next entry prepped (set by mp_exec_aline())
+	float sync_value;					// ...and its argument
 	stPrepMotor_t mot[MOTORS];			// prep time motor structs
+	stSegment_t seg[PREP_QUEUE_DEPTH];	// the prep queue
 	uint16_t magic_end;
 } stPrepSingleton_t;
 
-extern stConfig_t st_cfg;				// config struct is exposed. The rest are private
-extern stPrepSingleton_t st_pre;		// only used by config_app diagnostics
+// Dry run ({sim:1}). The loader takes each prepped segment, adds it up and hands the
+// queue entry straight back to the exec, so a program plans and executes at CPU speed
+// with the motors, spindle and coolant left off. The exec is paced by the controller
+// instead of the step timers (see mp_throttle_exec()). Time is kept as whole seconds
+// plus a remainder in timer ticks so long programs add up exactly.
+typedef struct stSimSingleton {
+	uint8_t enable;						// true = segments and dwells are counted, not run
+	volatile uint8_t held;				// true while the exec waits for the controller to fill the queue
+	volatile uint8_t report_requested;	// send the sim report - set at program end (M2/M30)
+	uint32_t segments;					// segments consumed
+	uint32_t seconds;					// whole seconds of motion and dwell consumed
+	uint32_t dda_ticks;					// remainder in DDA ticks
+	uint32_t dwell_ticks;				// remainder in dwell ticks
+} stSimSingleton_t;
+
+// Exec and load timing ({et:n}, cleared by {clt:n}). Kept by the exec ISR (LO) and the
+// loader (HI), read by the controller. Times are plan timer ticks; a min of 0xFFFF means
+// nothing has been timed yet. The first pass over budget is sent as an exception report.
+typedef struct stTimingSingleton {
+	uint16_t exec_min;					// mp_exec_move() passes that prepped a segment, dwell or command
+	uint16_t exec_max;
+	uint16_t prep_min;					// st_prep_line() on its own (part of the exec)
+	uint16_t prep_max;
+	uint16_t load_min;					// _load_move() of a line segment
+	uint16_t load_max;
+	uint32_t exec_bucket[TIMING_BUCKETS];	// exec passes by quarter of EXEC_BUDGET_USEC
+	uint32_t load_bucket[TIMING_BUCKETS];	// loads by quarter of LOAD_BUDGET_USEC
+	uint32_t exec_overruns;				// exec passes over budget
+	uint32_t load_overruns;				// loads over budget
+	volatile uint8_t exception;			// status of the first overrun since the clear, 0 if none
+	uint8_t reported;					// true once st_timing_callback() has sent it
+} stTimingSingleton_t;
+
+extern THREAD_LOCAL stConfig_t st_cfg;				// config struct is exposed. The rest are private
+extern THREAD_LOCAL stPrepSingleton_t st_pre;		// only used by config_app diagnostics
+extern THREAD_LOCAL stSimSingleton_t st_sim;		// tested by the spindle and coolant exec functions
+extern THREAD_LOCAL stTimingSingleton_t st_tm;		// only used by config_app diagnostics
 
 /**** FUNCTION PROTOTYPES ****/
 
@@ -427,6 +509,13 @@ void st_reset(void);
 void st_cycle_start(void);
 void st_cycle_end(void);
 stat_t st_clc(nvObj_t *nv);
+stat_t st_set_sim(nvObj_t *nv);
+stat_t st_get_simt(nvObj_t *nv);
+stat_t st_sim_report_callback(void);
+stat_t st_sim_callback(void);
+stat_t st_clt(nvObj_t *nv);
+stat_t st_get_et(nvObj_t *nv);
+stat_t st_timing_callback(void);
 
 void st_energize_motors(void);
 void st_deenergize_motors(void);
@@ -439,6 +528,7 @@ void st_prep_command(void *bf);		// use a void pointer since we don't know about
 void st_prep_dwell(float microseconds);
 stat_t st_prep_line(float travel_steps[], float following_error[], float segment_time);
 
+stat_t st_set_ma(nvObj_t *nv);
 stat_t st_set_sa(nvObj_t *nv);
 stat_t st_set_tr(nvObj_t *nv);
 stat_t st_set_mi(nvObj_t *nv);
@@ -45,7 +45,7 @@
 /****** 修订 ******/
 
 #ifndef TINYG_FIRMWARE_BUILD
-#define TINYG_FIRMWARE_BUILD        440.20	// arc test
+#define TINYG_FIRMWARE_BUILD        440.22	// new config table rows - NVM reloads defaults
 
 #endif
 #define TINYG_FIRMWARE_VERSION		0.97					// 主固件版本 
@@ -179,6 +179,17 @@ typedef char char_t;			// In the ARM/GCC++ version char_t is typedef'd to uint8_
 
 #endif // __ARM
 
+/*********************
+ * Host builds *
+ *********************/
+/* THREAD_LOCAL marks the singletons the planning and exec path runs on (cm, mb, mm, mr,
+ * arc...). The firmware has one of each and the macro is empty. Host tools (see host/)
+ * build with THREAD_LOCAL=__thread so every thread owns an independent planner.
+ */
+#ifndef THREAD_LOCAL
+#define THREAD_LOCAL
+#endif
+
 /******************************************************************************
  ***** TINYG 应用定义 ******************************************
  ******************************************************************************/
@@ -213,6 +224,21 @@ typedef uint16_t magic_t;		// “魔法数”的大小
 #define MOTOR_5		4
 #define MOTOR_6		5
 
+/* MOTION_AXES
+ *	Axes the planner, exec and kinematics compute with - the first MOTION_AXES of XYZABC.
+ *	Set it on the compiler command line (-DMOTION_AXES=3) to build for a machine that
+ *	never moves the rotaries: the axis loops on the line planning and segment paths
+ *	then run a fixed 3 wide. Config, Gcode model and reports keep all AXES. Setting an
+ *	axis past MOTION_AXES to any mode but disabled, or mapping a motor to one, returns
+ *	STAT_INPUT_VALUE_RANGE_ERROR (see cm_set_am() and st_set_ma()).
+ */
+#ifndef MOTION_AXES
+#define MOTION_AXES	AXES
+#endif
+#if ((MOTION_AXES < 3) || (MOTION_AXES > AXES))
+#error MOTION_AXES must take in XYZ and no more than AXES
+#endif
+
 #define PWM_1		0
 #define PWM_2		1
 
@@ -245,10 +271,10 @@ typedef uint16_t magic_t;		// “魔法数”的大小
  */
 
 typedef uint8_t stat_t;
-extern stat_t status_code;				// 在 main.c 中分配了
+extern THREAD_LOCAL stat_t status_code;				// 在 main.c 中分配了
 
 #define MESSAGE_LEN 80					// 全局信息字符串存储
-extern char global_string_buf[];				// 在main.c中分配了
+extern THREAD_LOCAL char global_string_buf[];				// 在main.c中分配了
 
 char *get_status_message(stat_t status);
 
@@ -296,8 +322,8 @@ char *get_status_message(stat_t status);
 #define	STAT_FLOAT_IS_NAN 33
 #define	STAT_PERSISTENCE_ERROR 34
 #define	STAT_BAD_STATUS_REPORT_SETTING 35
-#define	STAT_ERROR_36 36
-#define	STAT_ERROR_37 37
+#define	STAT_EXEC_OVER_BUDGET 36		// exec and prep of a segment took longer than EXEC_BUDGET_USEC
+#define	STAT_LOAD_OVER_BUDGET 37		// segment load took longer than LOAD_BUDGET_USEC
 #define	STAT_ERROR_38 38
 #define	STAT_ERROR_39 39
 
@@ -49,7 +49,7 @@ extern "C"{
  * set_vector_by_axis()		- load a single value into a zero vector
  */
 
-float vector[AXES];	// statically allocated global for vector utilities
+THREAD_LOCAL float vector[AXES];	// statically allocated global for vector utilities
 
 /*
 void copy_vector(float dst[], const float src[])
@@ -180,7 +180,7 @@ uint8_t isnumber(char_t c)
 	if (c == '.') { return (true); }
 	if (c == '-') { return (true); }
 	if (c == '+') { return (true); }
-	return (isdigit(c));
+	return (isdigit(c) != 0);		// isdigit() is only non-zero - glibc's doesn't fit a uint8_t
 }
 
 char_t *escape_string(char_t *dst, char_t *src)
@@ -51,7 +51,7 @@ extern "C"{
 
 //*** vector utilities ***
 
-extern float vector[AXES]; // vector of axes for passing to subroutines
+extern THREAD_LOCAL float vector[AXES]; // vector of axes for passing to subroutines
 
 #define clear_vector(a) (memset(a,0,sizeof(a)))
 #define	copy_vector(d,s) (memcpy(d,s,sizeof(d)))
@@ -25,7 +25,7 @@
 #include "../switch.h"
 #include "xmega_rtc.h"
 
-rtClock_t rtc;		// allocate clock control struct
+THREAD_LOCAL rtClock_t rtc;		// allocate clock control struct
 
 /*
  * rtc_init() - initialize and start the clock
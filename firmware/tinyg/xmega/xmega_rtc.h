@@ -34,7 +34,7 @@ typedef struct rtClock {
 	uint16_t magic_end;								// magic number is read directly
 } rtClock_t;
 
-extern rtClock_t rtc;
+extern THREAD_LOCAL rtClock_t rtc;
 
 void rtc_init(void);								// initialize and start general timer
 
@@ -0,0 +1,246 @@
+(override_commands - feed override test: command pairs queued between lines)
+N1 G17 G21 G90
+N2 G92 X0 Y0 Z0
+N3 F1200
+N4 G1 X20.0 Y1.5
+N5 G1 X0.0 Y3.0
+N6 G1 X20.0 Y4.5
+N7 G1 X0.0 Y6.0
+N8 M3 S1000
+N9 G4 P0.05
+N10 G1 X20.0 Y7.5
+N11 G1 X0.0 Y9.0
+N12 G1 X20.0 Y10.5
+N13 G1 X0.0 Y12.0
+N14 M5
+N15 M3 S800
+N16 G1 X20.0 Y13.5
+N17 G1 X0.0 Y15.0
+N18 G1 X20.0 Y16.5
+N19 G1 X0.0 Y18.0
+N20 M3 S1000
+N21 G4 P0.05
+N22 G1 X20.0 Y19.5
+N23 G1 X0.0 Y21.0
+N24 G1 X20.0 Y22.5
+N25 G1 X0.0 Y24.0
+N26 M5
+N27 M3 S800
+N28 G1 X20.0 Y25.5
+N29 G1 X0.0 Y27.0
+N30 G1 X20.0 Y28.5
+N31 G1 X0.0 Y30.0
+N32 M3 S1000
+N33 G4 P0.05
+N34 G1 X20.0 Y31.5
+N35 G1 X0.0 Y33.0
+N36 G1 X20.0 Y34.5
+N37 G1 X0.0 Y36.0
+N38 M5
+N39 M3 S800
+N40 G1 X20.0 Y37.5
+N41 G1 X0.0 Y39.0
+N42 G1 X20.0 Y40.5
+N43 G1 X0.0 Y42.0
+N44 M3 S1000
+N45 G4 P0.05
+N46 G1 X20.0 Y43.5
+N47 G1 X0.0 Y45.0
+N48 G1 X20.0 Y46.5
+N49 G1 X0.0 Y48.0
+N50 M5
+N51 M3 S800
+N52 G1 X20.0 Y49.5
+N53 G1 X0.0 Y51.0
+N54 G1 X20.0 Y52.5
+N55 G1 X0.0 Y54.0
+N56 M3 S1000
+N57 G4 P0.05
+N58 G1 X20.0 Y55.5
+N59 G1 X0.0 Y57.0
+N60 G1 X20.0 Y58.5
+N61 G1 X0.0 Y60.0
+N62 M5
+N63 M3 S800
+N64 G1 X20.0 Y61.5
+N65 G1 X0.0 Y63.0
+N66 G1 X20.0 Y64.5
+N67 G1 X0.0 Y66.0
+N68 M3 S1000
+N69 G4 P0.05
+N70 G1 X20.0 Y67.5
+N71 G1 X0.0 Y69.0
+N72 G1 X20.0 Y70.5
+N73 G1 X0.0 Y72.0
+N74 M5
+N75 M3 S800
+N76 G1 X20.0 Y73.5
+N77 G1 X0.0 Y75.0
+N78 G1 X20.0 Y76.5
+N79 G1 X0.0 Y78.0
+N80 M3 S1000
+N81 G4 P0.05
+N82 G1 X20.0 Y79.5
+N83 G1 X0.0 Y81.0
+N84 G1 X20.0 Y82.5
+N85 G1 X0.0 Y84.0
+N86 M5
+N87 M3 S800
+N88 G1 X20.0 Y85.5
+N89 G1 X0.0 Y87.0
+N90 G1 X20.0 Y88.5
+N91 G1 X0.0 Y90.0
+N92 M3 S1000
+N93 G4 P0.05
+N94 G1 X20.0 Y91.5
+N95 G1 X0.0 Y93.0
+N96 G1 X20.0 Y94.5
+N97 G1 X0.0 Y96.0
+N98 M5
+N99 M3 S800
+N100 G1 X20.0 Y97.5
+N101 G1 X0.0 Y99.0
+N102 G1 X20.0 Y100.5
+N103 G1 X0.0 Y102.0
+N104 M3 S1000
+N105 G4 P0.05
+N106 G1 X20.0 Y103.5
+N107 G1 X0.0 Y105.0
+N108 G1 X20.0 Y106.5
+N109 G1 X0.0 Y108.0
+N110 M5
+N111 M3 S800
+N112 G1 X20.0 Y109.5
+N113 G1 X0.0 Y111.0
+N114 G1 X20.0 Y112.5
+N115 G1 X0.0 Y114.0
+N116 M3 S1000
+N117 G4 P0.05
+N118 G1 X20.0 Y115.5
+N119 G1 X0.0 Y117.0
+N120 G1 X20.0 Y118.5
+N121 G1 X0.0 Y120.0
+N122 M5
+N123 M3 S800
+N124 G1 X20.0 Y121.5
+N125 G1 X0.0 Y123.0
+N126 G1 X20.0 Y124.5
+N127 G1 X0.0 Y126.0
+N128 M3 S1000
+N129 G4 P0.05
+N130 G1 X20.0 Y127.5
+N131 G1 X0.0 Y129.0
+N132 G1 X20.0 Y130.5
+N133 G1 X0.0 Y132.0
+N134 M5
+N135 M3 S800
+N136 G1 X20.0 Y133.5
+N137 G1 X0.0 Y135.0
+N138 G1 X20.0 Y136.5
+N139 G1 X0.0 Y138.0
+N140 M3 S1000
+N141 G4 P0.05
+N142 G1 X20.0 Y139.5
+N143 G1 X0.0 Y141.0
+N144 G1 X20.0 Y142.5
+N145 G1 X0.0 Y144.0
+N146 M5
+N147 M3 S800
+N148 G1 X20.0 Y145.5
+N149 G1 X0.0 Y147.0
+N150 G1 X20.0 Y148.5
+N151 G1 X0.0 Y150.0
+N152 M3 S1000
+N153 G4 P0.05
+N154 G1 X20.0 Y151.5
+N155 G1 X0.0 Y153.0
+N156 G1 X20.0 Y154.5
+N157 G1 X0.0 Y156.0
+N158 M5
+N159 M3 S800
+N160 G1 X20.0 Y157.5
+N161 G1 X0.0 Y159.0
+N162 G1 X20.0 Y160.5
+N163 G1 X0.0 Y162.0
+N164 M3 S1000
+N165 G4 P0.05
+N166 G1 X20.0 Y163.5
+N167 G1 X0.0 Y165.0
+N168 G1 X20.0 Y166.5
+N169 G1 X0.0 Y168.0
+N170 M5
+N171 M3 S800
+N172 G1 X20.0 Y169.5
+N173 G1 X0.0 Y171.0
+N174 G1 X20.0 Y172.5
+N175 G1 X0.0 Y174.0
+N176 M3 S1000
+N177 G4 P0.05
+N178 G1 X20.0 Y175.5
+N179 G1 X0.0 Y177.0
+N180 G1 X20.0 Y178.5
+N181 G1 X0.0 Y180.0
+N182 M5
+N183 M3 S800
+N184 G1 X20.0 Y181.5
+N185 G1 X0.0 Y183.0
+N186 G1 X20.0 Y184.5
+N187 G1 X0.0 Y186.0
+N188 M3 S1000
+N189 G4 P0.05
+N190 G1 X20.0 Y187.5
+N191 G1 X0.0 Y189.0
+N192 G1 X20.0 Y190.5
+N193 G1 X0.0 Y192.0
+N194 M5
+N195 M3 S800
+N196 G1 X20.0 Y193.5
+N197 G1 X0.0 Y195.0
+N198 G1 X20.0 Y196.5
+N199 G1 X0.0 Y198.0
+N200 M3 S1000
+N201 G4 P0.05
+N202 G1 X20.0 Y199.5
+N203 G1 X0.0 Y201.0
+N204 G1 X20.0 Y202.5
+N205 G1 X0.0 Y204.0
+N206 M5
+N207 M3 S800
+N208 G1 X20.0 Y205.5
+N209 G1 X0.0 Y207.0
+N210 G1 X20.0 Y208.5
+N211 G1 X0.0 Y210.0
+N212 M3 S1000
+N213 G4 P0.05
+N214 G1 X20.0 Y211.5
+N215 G1 X0.0 Y213.0
+N216 G1 X20.0 Y214.5
+N217 G1 X0.0 Y216.0
+N218 M5
+N219 M3 S800
+N220 G1 X20.0 Y217.5
+N221 G1 X0.0 Y219.0
+N222 G1 X20.0 Y220.5
+N223 G1 X0.0 Y222.0
+N224 M3 S1000
+N225 G4 P0.05
+N226 G1 X20.0 Y223.5
+N227 G1 X0.0 Y225.0
+N228 G1 X20.0 Y226.5
+N229 G1 X0.0 Y228.0
+N230 M5
+N231 M3 S800
+N232 G1 X20.0 Y229.5
+N233 G1 X0.0 Y231.0
+N234 G1 X20.0 Y232.5
+N235 G1 X0.0 Y234.0
+N236 M3 S1000
+N237 G4 P0.05
+N238 G1 X20.0 Y235.5
+N239 G1 X0.0 Y237.0
+N240 G1 X20.0 Y238.5
+N241 G1 X0.0 Y240.0
+N242 M5
+N243 M3 S800
+N244 M5
+N245 G0 X0 Y0